@@ -12,7 +12,7 @@ DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000
 
 # Use pkg-config to handle OpenCV and GStreamer includes/libs
 CONFIG += link_pkgconfig
-PKGCONFIG += opencv4 gstreamer-1.0 gstreamer-video-1.0 gstreamer-app-1.0 glib-2.0 gstreamer-gl-1.0
+PKGCONFIG += opencv4 gstreamer-1.0 gstreamer-video-1.0 gstreamer-app-1.0 glib-2.0 gstreamer-gl-1.0 libcrypto
 
 # Added linker flags for libudev (required for hotplug support)
 LIBS += -Wl,--no-as-needed -ludev -Wl,--as-needed
@@ -24,18 +24,28 @@ LIBS     += -lgstreamer-1.0 -lgstvideo-1.0 -lgstapp-1.0 -lgstbase-1.0 -lgobject-
 QT       += dbus concurrent
 
 SOURCES += \
+    archive_cipher.cpp \
+    archive_compactor.cpp \
+    archive_io.cpp \
+    archive_migrator.cpp \
+    archive_sink_tap.cpp \
+    archive_transcoder.cpp \
+    archive_verifier.cpp \
     archivemanager.cpp \
     archivewidget.cpp \
     archiveworker.cpp \
     cameradetailswidget.cpp \
     cameramanager.cpp \
     camerastreams.cpp \
+    coverage_bitmap.cpp \
     db_reader.cpp \
     db_writer.cpp \
     fullscreenviewer.cpp \
     hik_time.cpp \
+    keyframe_index.cpp \
     layoutmanager.cpp \
     main.cpp \
+    mkv_probe.cpp \
     mainwindow.cpp \
     navbar.cpp \
     operationstatuswidget.cpp \
@@ -53,7 +63,11 @@ SOURCES += \
     playback_video_box.cpp \
     playback_video_player_gst.cpp \
     playbackwindow.cpp \
+    recording_stats.cpp \
+    sched_policy.cpp \
+    segment_hash.cpp \
     settingswindow.cpp \
+    storage_monitor.cpp \
     storagedetailswidget.cpp \
     streammanager.cpp \
     streamworker.cpp \
@@ -63,6 +77,13 @@ SOURCES += \
     videoplayerwindow.cpp
 
 HEADERS += \
+    archive_cipher.h \
+    archive_compactor.h \
+    archive_io.h \
+    archive_migrator.h \
+    archive_sink_tap.h \
+    archive_transcoder.h \
+    archive_verifier.h \
     archivemanager.h \
     archivewidget.h \
     archiveworker.h \
@@ -70,13 +91,17 @@ HEADERS += \
     cameramanager.h \
     camerastreams.h \
     clickablelabel.h \
+    coverage_bitmap.h \
+    db_events.h \
     db_reader.h \
     db_writer.h \
     fullscreenviewer.h \
     glcontainerwidget.h \
     hik_time.h \
+    keyframe_index.h \
     layoutmanager.h \
     mainwindow.h \
+    mkv_probe.h \
     navbar.h \
     operationstatuswidget.h \
     playback_controls.h \
@@ -93,7 +118,11 @@ HEADERS += \
     playback_video_box.h \
     playback_video_player_gst.h \
     playbackwindow.h \
+    recording_stats.h \
+    sched_policy.h \
+    segment_hash.h \
     settingswindow.h \
+    storage_monitor.h \
     storagedetailswidget.h \
     streammanager.h \
     streamworker.h \
@@ -0,0 +1,192 @@
+#include "archive_cipher.h"
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <QDebug>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <cstring>
+
+static const int kNonceBytes = 8;
+static const int kIvFileBytes = 8 + kNonceBytes;
+static const int kProbeBytes = 192;    // TS check looks at two 188-byte packets
+
+static QByteArray readKey() {
+    const QString path = ArchiveCipher::keyPath();
+    QFile f(path);
+    if (!f.exists()) return QByteArray();
+    if (!f.open(QIODevice::ReadOnly)) {
+        qWarning() << "[Cipher] cannot read" << path << ":" << f.errorString();
+        return QByteArray();
+    }
+    QByteArray key = f.read(128);
+    if (key.trimmed().size() == 64) key = QByteArray::fromHex(key.trimmed());
+    if (key.size() != 32) {
+        qWarning() << "[Cipher]" << path << "is not a 256-bit key; encryption off";
+        return QByteArray();
+    }
+    if (f.permissions() & (QFileDevice::ReadGroup | QFileDevice::ReadOther))
+        qWarning() << "[Cipher]" << path << "is readable by other users";
+    qInfo() << "[Cipher] archive encryption on (AES-256-CTR)";
+    return key;
+}
+
+static const QByteArray& key() {
+    static const QByteArray k = readKey();     // once per process, thread-safe
+    return k;
+}
+
+bool ArchiveCipher::enabled() { return !key().isEmpty(); }
+
+QString ArchiveCipher::keyPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation) + "/archive.key";
+}
+
+// ---- CipherStream ------------------------------------------------------------
+
+static QByteArray readNonce(const QString& path) {
+    QFile f(ArchiveCipher::noncePath(path));
+    if (!f.open(QIODevice::ReadOnly)) return QByteArray();
+    const QByteArray b = f.read(kIvFileBytes);
+    if (b.size() != kIvFileBytes || !b.startsWith("CVIV") ||
+        qFromLittleEndian<quint16>(reinterpret_cast<const uchar*>(b.constData()) + 4) != 1) {
+        qWarning() << "[Cipher] bad nonce sidecar" << f.fileName();
+        return QByteArray();
+    }
+    return b.mid(8);
+}
+
+static QByteArray writeNonce(const QString& path) {
+    QByteArray nonce(kNonceBytes, '\0');
+    if (RAND_bytes(reinterpret_cast<uchar*>(nonce.data()), kNonceBytes) != 1) {
+        qWarning() << "[Cipher] RAND_bytes failed";
+        return QByteArray();
+    }
+    QByteArray b("CVIV");
+    uchar hdr[4];
+    qToLittleEndian<quint16>(1, hdr);
+    qToLittleEndian<quint16>(0, hdr + 2);
+    b.append(reinterpret_cast<const char*>(hdr), 4).append(nonce);
+    QSaveFile f(ArchiveCipher::noncePath(path));      // fsynced on commit
+    if (!f.open(QIODevice::WriteOnly) || f.write(b) != b.size() || !f.commit()) {
+        qWarning() << "[Cipher] cannot write" << f.fileName() << ":" << f.errorString();
+        return QByteArray();
+    }
+    return nonce;
+}
+
+CipherStream::CipherStream(const QString& path, bool newFile) {
+    if (!ArchiveCipher::enabled()) return;
+    nonce_ = newFile ? writeNonce(path) : readNonce(path);
+    if (nonce_.isEmpty()) {
+        // a predictable nonce would repeat the keystream whenever a name does
+        if (newFile) {
+            qWarning() << "[Cipher] cannot write the nonce sidecar for" << path;
+            return;
+        }
+        // recorded before sidecars
+        nonce_ = QCryptographicHash::hash(QFileInfo(path).fileName().toUtf8(),
+                                          QCryptographicHash::Sha256).left(kNonceBytes);
+    }
+    ctx_ = EVP_CIPHER_CTX_new();
+}
+
+CipherStream::~CipherStream() {
+    if (ctx_) EVP_CIPHER_CTX_free(ctx_);
+}
+
+void CipherStream::apply(qint64 offset, uchar* data, qint64 size) {
+    if (!ctx_ || size <= 0) return;
+    if (offset != next_) {
+        uchar iv[16];
+        memcpy(iv, nonce_.constData(), kNonceBytes);
+        quint64 block = quint64(offset / 16);
+        for (int i = 15; i >= kNonceBytes; --i, block >>= 8) iv[i] = uchar(block & 0xff);
+        EVP_EncryptInit_ex(ctx_, EVP_aes_256_ctr(), nullptr,
+                           reinterpret_cast<const uchar*>(key().constData()), iv);
+        // advance into the block
+        uchar skip[16] = {};
+        int n = 0;
+        if (offset % 16) EVP_EncryptUpdate(ctx_, skip, &n, skip, int(offset % 16));
+    }
+    qint64 done = 0;
+    while (done < size) {
+        const int chunk = int(qMin<qint64>(size - done, 1 << 30));
+        int n = 0;
+        EVP_EncryptUpdate(ctx_, data + done, &n, data + done, chunk);
+        done += chunk;
+    }
+    next_ = offset + size;
+}
+
+// ---- detection -----------------------------------------------------------------
+
+static bool looksPlain(const uchar* p, int n) {
+    if (n >= 4 && p[0] == 0x1A && p[1] == 0x45 && p[2] == 0xDF && p[3] == 0xA3) return true;  // EBML
+    if (n >= 8) {
+        const QByteArray box(reinterpret_cast<const char*>(p + 4), 4);
+        if (box == "ftyp" || box == "styp" || box == "moov" || box == "moof" ||
+            box == "mdat" || box == "free")
+            return true;                                                 // ISO BMFF
+    }
+    if (n > 188 && p[0] == 0x47 && p[188] == 0x47) return true;          // MPEG-TS
+    return false;
+}
+
+bool ArchiveCipher::isEncrypted(const QString& path) {
+    if (!enabled()) return false;
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) return false;
+    QByteArray head = f.read(kProbeBytes);
+    if (head.isEmpty()) return false;
+    uchar* p = reinterpret_cast<uchar*>(head.data());
+    if (looksPlain(p, head.size())) return false;
+    CipherStream cs(path);
+    cs.apply(0, p, head.size());
+    return looksPlain(p, head.size());
+}
+
+// ---- decrypting reader -----------------------------------------------------
+
+namespace {
+class CipherFile final : public QIODevice {
+public:
+    explicit CipherFile(const QString& path) : file_(path), stream_(path) {}
+
+    bool open(OpenMode mode) override {
+        if ((mode & WriteOnly) || !file_.open(QIODevice::ReadOnly)) return false;
+        return QIODevice::open(mode | Unbuffered);
+    }
+    void close() override { file_.close(); QIODevice::close(); }
+    bool isSequential() const override { return false; }
+    qint64 size() const override { return file_.size(); }
+    bool seek(qint64 pos) override { return QIODevice::seek(pos) && file_.seek(pos); }
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override {
+        const qint64 at = file_.pos();
+        const qint64 n = file_.read(data, maxSize);
+        if (n > 0) stream_.apply(at, reinterpret_cast<uchar*>(data), n);
+        return n;
+    }
+    qint64 writeData(const char*, qint64) override { return -1; }
+
+private:
+    QFile        file_;
+    CipherStream stream_;
+};
+} // namespace
+
+QIODevice* ArchiveCipher::openForRead(const QString& path) {
+    QIODevice* dev = isEncrypted(path) ? static_cast<QIODevice*>(new CipherFile(path))
+                                       : static_cast<QIODevice*>(new QFile(path));
+    if (!dev->open(QIODevice::ReadOnly)) {
+        delete dev;
+        return nullptr;
+    }
+    return dev;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+
+class QIODevice;
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+
+// At-rest encryption of recorded segments: AES-256-CTR (libcrypto EVP, which
+// uses AES-NI / VAES when the CPU has them).
+//
+// On whenever the key file exists: 32 raw bytes (or 64 hex digits) at
+// <AppConfigLocation>/archive.key, kept on the recorder, never on the media.
+// CTR keeps the file layout byte for byte, so muxer rewrites, keyframe
+// offsets and SegmentHasher digests work unchanged (the digest covers the
+// ciphertext, i.e. what is on disk).
+//
+// Counter block = nonce (8 bytes) || big-endian block number (offset / 16).
+// The nonce is random per file (RAND_bytes) and kept next to it in
+// "<file>.iv" ("CVIV" | u16 version 1 | u16 0 | nonce), written before the
+// first byte of the segment. A name-derived nonce would repeat when a file
+// name comes back (clock stepped back, restart within the same second, loop
+// slot reuse). Files without a sidecar (recorded before sidecars) use
+// SHA-256(file name) as before; recording never does: if the sidecar cannot
+// be written the segment fails (ArchiveSinkTap). The sidecar must travel
+// with the file (the migrator moves it; transcoder/compactor leave
+// encrypted files alone).
+class ArchiveCipher final {
+public:
+    static bool enabled();                        // key loaded
+    static QString keyPath();
+    static QString noncePath(const QString& path) { return path + ".iv"; }
+
+    // Whether the file on disk is ciphertext: its head decrypts to a known
+    // container signature (MKV, MP4, MPEG-TS) and is not one already.
+    static bool isEncrypted(const QString& path);
+    // Read-only, seekable device with plaintext: a QFile for plain files,
+    // a decrypting wrapper otherwise. nullptr if the file cannot be opened.
+    static QIODevice* openForRead(const QString& path);
+};
+
+// Keystream for one file. Contiguous apply() calls continue the running
+// counter; a jump (muxer seeking back) re-derives it at the new offset.
+// newFile: draw a fresh nonce and write the sidecar (recording; invalid if
+// that fails); otherwise read it (playback, export, probing).
+class CipherStream final {
+public:
+    explicit CipherStream(const QString& path, bool newFile = false);
+    ~CipherStream();
+    CipherStream(const CipherStream&) = delete;
+    CipherStream& operator=(const CipherStream&) = delete;
+
+    bool isValid() const { return ctx_ != nullptr; }
+    // XOR in place; the same call encrypts and decrypts.
+    void apply(qint64 offset, uchar* data, qint64 size);
+
+private:
+    EVP_CIPHER_CTX* ctx_ = nullptr;
+    QByteArray      nonce_;
+    qint64          next_ = -1;    // offset the running counter is at
+};
@@ -0,0 +1,218 @@
+#include "archive_compactor.h"
+#include "archive_cipher.h"
+#include "archive_io.h"
+#include "db_writer.h"
+#include "keyframe_index.h"
+#include "sched_policy.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTemporaryFile>
+#include <QTextStream>
+#include <QTimer>
+#include <QVariant>
+#include <QDebug>
+
+static const int    kIdleMs      = 10 * 60 * 1000;
+static const qint64 kMaxGapNs    = 1000000000LL;           // concat drops gaps: keep them tiny
+static const qint64 kMaxPieceMs  = 30 * 60 * 1000;         // already long enough
+static const int    kMaxRows     = 4000;
+
+static QString hourKey(qint64 utcNs) {
+    return QDateTime::fromMSecsSinceEpoch(utcNs / 1000000).toString("yyyyMMddHH");
+}
+
+ArchiveCompactor::ArchiveCompactor(DbWriter* db, const QString& dbPath, const QString& spoolDir,
+                                   QObject* parent)
+    : QObject(parent), db_(db), dbPath_(dbPath), spoolDir_(spoolDir) {}
+
+ArchiveCompactor::~ArchiveCompactor() {
+    archiveio::closeReadOnly(&ro_);
+}
+
+void ArchiveCompactor::start() {
+    if (!archiveio::openReadOnly(&ro_, "camvigil_compact", dbPath_, "[Compact]")) return;
+    timer_ = new QTimer(this);
+    timer_->setSingleShot(true);
+    connect(timer_, &QTimer::timeout, this, &ArchiveCompactor::tick);
+    timer_->start(kIdleMs);
+}
+
+void ArchiveCompactor::tick() {
+    if (suspended_.load()) { timer_->start(kIdleMs); return; }
+    const QVector<Run> runs = findRuns();
+    int done = 0;
+    for (const Run& run : runs) {
+        if (stop_.load()) return;
+        if (compactRun(run)) ++done;
+        else failed_.insert(run.ids.first());
+    }
+    if (done) qInfo() << "[Compact] merged" << done << "runs";
+    // findRuns caps its scan; a full pass probably left more behind
+    timer_->start(done ? 0 : kIdleMs);
+}
+
+QVector<ArchiveCompactor::Run> ArchiveCompactor::findRuns() {
+    QVector<Run> runs;
+    // only hours that are over (local time), so a run never grows afterwards
+    const QDateTime now = QDateTime::currentDateTime();
+    const QDateTime hourStart(now.date(), QTime(now.time().hour(), 0));
+    const qint64 cutoffNs = hourStart.toMSecsSinceEpoch() * 1000000LL;
+
+    QSqlQuery q(ro_);
+    q.setForwardOnly(true);
+    q.prepare(R"SQL(
+      SELECT s.id, s.camera_id, s.file_path, s.start_utc_ns, s.end_utc_ns,
+             (SELECT x.file_path FROM segments x
+               WHERE x.main_segment_id = s.id AND x.status = 1
+               ORDER BY x.start_utc_ns LIMIT 1) AS sub_path
+      FROM segments s
+      WHERE s.status = 1
+        AND s.aged_at IS NULL
+        AND s.camera_id IS NOT NULL
+        AND COALESCE(s.variant,0) = 0
+        AND COALESCE(s.quality,0) = 0
+        AND s.health = 1
+        AND s.duration_ms > 0 AND s.duration_ms < :max_piece
+        AND s.end_utc_ns <= :cutoff
+        AND substr(s.file_path, 1, length(:spool)) <> :spool
+      ORDER BY s.camera_id, s.start_utc_ns
+      LIMIT :max_rows
+    )SQL");
+    q.bindValue(":max_piece", kMaxPieceMs);
+    q.bindValue(":cutoff", cutoffNs);
+    q.bindValue(":spool", spoolDir_ + "/");
+    q.bindValue(":max_rows", kMaxRows);
+    if (!q.exec()) {
+        qWarning() << "[Compact] query:" << q.lastError().text();
+        return runs;
+    }
+
+    Run cur;
+    int curCam = -1;
+    qint64 curEnd = 0;
+    QString curHour, curExt;
+    bool curSub = false;
+    auto flush = [&]() {
+        if (cur.ids.size() >= 2 && !failed_.contains(cur.ids.first())) runs.push_back(cur);
+        cur = Run();
+    };
+    while (q.next()) {
+        const qint64  id    = q.value(0).toLongLong();
+        const int     cam   = q.value(1).toInt();
+        const QString path  = q.value(2).toString();
+        const qint64  start = q.value(3).toLongLong();
+        const qint64  end   = q.value(4).toLongLong();
+        const QString sub   = q.value(5).toString();
+        const QFileInfo fi(path);
+        const QString ext   = fi.suffix();
+        if (fi.completeBaseName().endsWith("_h")) {   // merged earlier: runs stop here
+            flush();
+            continue;
+        }
+        const bool contiguous = !cur.ids.isEmpty() && cam == curCam && ext == curExt &&
+                                hourKey(start) == curHour && !sub.isEmpty() == curSub &&
+                                qAbs(start - curEnd) <= kMaxGapNs;
+        if (!contiguous) flush();
+        if (cur.ids.isEmpty()) {
+            curCam = cam; curExt = ext; curHour = hourKey(start); curSub = !sub.isEmpty();
+        }
+        cur.ids << id;
+        cur.paths << path;
+        if (curSub) cur.subPaths << sub;
+        curEnd = end;
+    }
+    flush();
+    return runs;
+}
+
+bool ArchiveCompactor::compactRun(const Run& run) {
+    if (ArchiveCipher::isEncrypted(run.paths.first())) return false;   // ffmpeg cannot read it
+    const QFileInfo fi(run.paths.first());
+    const QString merged = fi.dir().filePath(fi.completeBaseName() + "_h." + fi.suffix());
+    QString mergedSub;
+    QString err;
+    if (!concat(run.paths, merged, &err)) {
+        if (!stop_.load()) qWarning() << "[Compact]" << merged << ":" << err;
+        return false;
+    }
+    if (!run.subPaths.isEmpty()) {
+        const QFileInfo sfi(run.subPaths.first());
+        mergedSub = fi.dir().filePath(fi.completeBaseName() + "_h_sub." + sfi.suffix());
+        if (!concat(run.subPaths, mergedSub, &err)) {
+            if (!stop_.load()) qWarning() << "[Compact]" << mergedSub << ":" << err;
+            QFile::remove(merged);
+            return false;
+        }
+    }
+
+    QVariantList ids;
+    for (qint64 id : run.ids) ids << id;
+    qint64 newId = 0;
+    QMetaObject::invokeMethod(db_, "replaceSegments", Qt::BlockingQueuedConnection,
+                              Q_RETURN_ARG(qint64, newId),
+                              Q_ARG(QVariantList, ids), Q_ARG(QString, merged),
+                              Q_ARG(QString, mergedSub));
+    if (newId <= 0) {
+        QFile::remove(merged);
+        if (!mergedSub.isEmpty()) QFile::remove(mergedSub);
+        return false;
+    }
+
+    for (const QString& p : run.paths + run.subPaths) {
+        QFile::remove(p);
+        QFile::remove(KeyframeIndex::sidecarPath(p));
+    }
+    qInfo() << "[Compact]" << run.ids.size() << "segments ->" << merged;
+    emit compacted(merged, run.ids.size());
+    return true;
+}
+
+bool ArchiveCompactor::concat(const QStringList& inputs, const QString& out, QString* err) {
+    QTemporaryFile list(QDir::temp().filePath("camvigil_concat_XXXXXX.txt"));
+    if (!list.open()) { *err = "cannot create concat list"; return false; }
+    {
+        QTextStream ts(&list);
+        for (const QString& p : inputs)
+            ts << "file '" << QString(p).replace('\'', "'\\''") << "'\n";
+    }
+    list.flush();
+
+    const QString part = out + ".part";
+    QStringList args;
+    args << "-hide_banner" << "-nostdin" << "-y" << "-loglevel" << "error"
+         << "-f" << "concat" << "-safe" << "0"
+         << "-i" << list.fileName()
+         << "-map" << "0" << "-c" << "copy";
+    const QString fmt = archiveio::ffmpegFormat(QFileInfo(out).suffix());
+    if (fmt == "mp4") args << "-movflags" << "+frag_keyframe+empty_moov";
+    args << "-f" << fmt << part;
+
+    QProcess p;
+    p.setProcessChannelMode(QProcess::SeparateChannels);
+    p.start(ffmpegPath_, args);
+    if (!p.waitForStarted(5000)) { *err = "cannot start " + ffmpegPath_; return false; }
+    SchedPolicy::applyToProcess(p.processId(), SchedClass::Background);
+    while (!p.waitForFinished(1000)) {
+        if (p.state() == QProcess::NotRunning) break;
+        if (stop_.load()) {
+            p.kill();
+            p.waitForFinished();
+            QFile::remove(part);
+            *err = "stopped";
+            return false;
+        }
+    }
+    if (p.exitStatus() != QProcess::NormalExit || p.exitCode() != 0) {
+        *err = QString::fromUtf8(p.readAllStandardError()).trimmed().right(300);
+        if (err->isEmpty()) *err = QString("ffmpeg exit %1").arg(p.exitCode());
+        QFile::remove(part);
+        return false;
+    }
+
+    return archiveio::commitPart(part, out, err);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <QObject>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+
+class DbWriter;
+class QTimer;
+
+/**
+ * ArchiveCompactor
+ * ----------------
+ * Merges runs of short, closed segments of one camera into one file per
+ * local hour, without re-encoding (ffmpeg concat demuxer, -c copy). With
+ * 1-minute segments this turns 60 files and rows per camera-hour into one,
+ * so listings, listSegments and stitched playback have far less to do.
+ * Lives on its own idle-priority thread (owner does moveToThread, then
+ * invokes start()).
+ *
+ * A run is consecutive verified (health=1) full-quality main segments of a
+ * finished hour, same container, no gap over 1 s, all with or all without a
+ * substream copy (copies are merged alongside). Output goes to
+ * "<first>_h.<ext>" via .part + fsync + rename; DbWriter::replaceSegments
+ * swaps the rows in one transaction and only then are the pieces deleted.
+ * Spool files are left to the migrator.
+ */
+class ArchiveCompactor : public QObject {
+    Q_OBJECT
+public:
+    ArchiveCompactor(DbWriter* db, const QString& dbPath, const QString& spoolDir,
+                     QObject* parent = nullptr);
+    ~ArchiveCompactor();
+
+    void setFfmpegPath(const QString& path) { ffmpegPath_ = path; }   // before start()
+    // Any thread: abort the running ffmpeg so the owner's thread can quit.
+    void requestStop() { stop_.store(true); }
+    // Any thread: skip work while set (loop recording reuses files instead).
+    void setSuspended(bool on) { suspended_.store(on); }
+
+public slots:
+    void start();
+
+signals:
+    void compacted(QString mergedPath, int pieces);
+
+private slots:
+    void tick();
+
+private:
+    struct Run {
+        QVector<qint64> ids;
+        QStringList     paths;
+        QStringList     subPaths;   // empty, or one per member
+    };
+
+    QVector<Run> findRuns();
+    bool compactRun(const Run& run);
+    bool concat(const QStringList& inputs, const QString& out, QString* err);
+
+    DbWriter*    db_;
+    QString      dbPath_;
+    QString      spoolDir_;
+    QString      ffmpegPath_ = "ffmpeg";
+    QSqlDatabase ro_;
+    QSet<qint64> failed_;           // first id of runs that failed; skipped until restart
+    QTimer*      timer_ = nullptr;
+    std::atomic<bool> stop_{false};
+    std::atomic<bool> suspended_{false};
+};
@@ -0,0 +1,72 @@
+#include "archive_io.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QSqlError>
+#include <QDebug>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace archiveio {
+
+QString ffmpegFormat(const QString& ext) {
+    if (ext == "mp4") return "mp4";
+    if (ext == "ts")  return "mpegts";
+    return "matroska";
+}
+
+static bool syncPath(const QString& path, int flags) {
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC | flags);
+    if (fd < 0) return false;
+    const bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+bool syncFile(const QString& path) {
+    return syncPath(path, 0);
+}
+
+bool syncDir(const QString& dir) {
+    return syncPath(dir, O_DIRECTORY);
+}
+
+bool commitPart(const QString& part, const QString& out, QString* err) {
+    QFile f(part);
+    if (!f.open(QIODevice::ReadWrite) || ::fsync(f.handle()) != 0) {
+        *err = "fsync failed";
+        QFile::remove(part);
+        return false;
+    }
+    f.close();
+    QFile::remove(out);                 // stale result of an interrupted run
+    if (!QFile::rename(part, out)) {
+        *err = "rename failed";
+        QFile::remove(part);
+        return false;
+    }
+    if (!syncDir(QFileInfo(out).absolutePath()))
+        qWarning() << "[ArchiveIO] directory fsync failed for" << out;
+    return true;
+}
+
+bool openReadOnly(QSqlDatabase* db, const QString& connName, const QString& dbPath,
+                  const char* tag) {
+    *db = QSqlDatabase::addDatabase("QSQLITE", connName);
+    db->setDatabaseName(dbPath);
+    db->setConnectOptions("QSQLITE_OPEN_READONLY=1;QSQLITE_BUSY_TIMEOUT=5000");
+    if (!db->open()) {
+        qWarning() << tag << "open:" << db->lastError().text();
+        return false;
+    }
+    return true;
+}
+
+void closeReadOnly(QSqlDatabase* db) {
+    if (!db->isValid()) return;
+    const QString name = db->connectionName();
+    db->close();
+    *db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(name);
+}
+
+} // namespace archiveio
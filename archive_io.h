@@ -0,0 +1,27 @@
+#pragma once
+#include <QSqlDatabase>
+#include <QString>
+
+// Small file and DB helpers shared by the background archive jobs
+// (migrator, compactor, transcoder, verifier).
+namespace archiveio {
+
+// ffmpeg muxer name for a segment file extension.
+QString ffmpegFormat(const QString& ext);
+
+// Make a finished "<out>.part" durable under its final name: fsync the
+// data, rename over <out>, then fsync the directory so the rename itself
+// survives a power cut. On failure the .part is removed and *err is set.
+bool commitPart(const QString& part, const QString& out, QString* err);
+
+// fsync a file's data, or a directory so renames/creates in it are durable.
+bool syncFile(const QString& path);
+bool syncDir(const QString& dir);
+
+// Read-only connection to the archive DB for a job thread; the writes
+// still go through DbWriter. Logs "<tag> open: ..." on failure.
+bool openReadOnly(QSqlDatabase* db, const QString& connName, const QString& dbPath,
+                  const char* tag);
+void closeReadOnly(QSqlDatabase* db);
+
+} // namespace archiveio
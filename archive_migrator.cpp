@@ -0,0 +1,520 @@
+#include "archive_migrator.h"
+#include "archive_cipher.h"
+#include "archive_io.h"
+#include "db_writer.h"
+#include <QDate>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStorageInfo>
+#include <QTimer>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const qint64 kChunkBytes = 1024 * 1024;
+static const int    kReshardBatch = 200;        // renames between two new segments
+static const int    kSlotBatch    = 16;         // loop slots created between two new segments
+
+static bool isSegmentFile(const QString& name) {
+    return name.endsWith(".mkv") || name.endsWith(".mp4") || name.endsWith(".ts");
+}
+
+// Allocate blocks without changing the file size. Not every filesystem
+// can (exFAT can't); the pool then still saves the create/unlink.
+static bool reserveBlocks(int fd, qint64 bytes) {
+#ifdef FALLOC_FL_KEEP_SIZE
+    return ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, off_t(bytes)) == 0;
+#else
+    Q_UNUSED(fd); Q_UNUSED(bytes);
+    return false;
+#endif
+}
+
+// rmdir dir and its parents up to (not including) root while they are empty
+static void removeEmptyParents(const QString& root, const QString& dir) {
+    const QDir r(root);
+    QString rel = r.relativeFilePath(dir);
+    while (!rel.isEmpty() && rel != "." && !rel.startsWith("..") && r.rmdir(rel))
+        rel = QFileInfo(rel).path();
+}
+
+ArchiveMigrator::ArchiveMigrator(DbWriter* db, QObject* parent)
+    : QObject(parent), db_(db) {}
+
+QString ArchiveMigrator::shardedPath(const QString& root, const QString& fileName) {
+    static const QRegularExpression re(R"(^archive_cam(\d+)_(\d{4})(\d{2})(\d{2})_)");
+    const QRegularExpressionMatch m = re.match(fileName);
+    if (!m.hasMatch()) return QDir(root).filePath(fileName);
+    return QString("%1/cam%2/%3/%4/%5/%6").arg(root, m.captured(1), m.captured(2),
+                                               m.captured(3), m.captured(4), fileName);
+}
+
+void ArchiveMigrator::setTarget(const QString& archiveDir) {
+    if (archiveDir != target_) {
+        reshardTodo_.clear();
+        reshardScanned_ = false;
+        reshardNoRow_ = 0;
+    }
+    target_ = archiveDir;
+    qInfo() << "[Migrator] target:" << (target_.isEmpty() ? QString("<none>") : target_)
+            << "pending:" << queue_.size();
+    loadPool();
+    if (!target_.isEmpty()) schedule();
+}
+
+void ArchiveMigrator::setLoopPool(int slots, qint64 slotBytes) {
+    if (target_.isEmpty()) {
+        qWarning() << "[Migrator] loop recording needs removable media";
+        emit loopPoolChanged(false);
+        return;
+    }
+    if (slots <= 0 || slotBytes <= 0) {
+        for (const QString& p : freeSlots_) QFile::remove(p);
+        QFile::remove(poolDir() + "/pool.json");
+        QDir(target_).rmdir(".pool");
+        qInfo() << "[Migrator] loop recording off";
+    } else {
+        QDir().mkpath(poolDir());
+        QSaveFile f(poolDir() + "/pool.json");
+        QJsonObject o;
+        o["slots"]      = slots;
+        o["slot_bytes"] = double(slotBytes);
+        if (!f.open(QIODevice::WriteOnly) ||
+            f.write(QJsonDocument(o).toJson()) < 0 || !f.commit()) {
+            qWarning() << "[Migrator] cannot write" << f.fileName();
+        }
+    }
+    loadPool();
+    schedule();
+}
+
+QString ArchiveMigrator::poolDir() const {
+    return target_ + "/.pool";
+}
+
+void ArchiveMigrator::loadPool() {
+    poolSlots_ = 0;
+    slotBytes_ = 0;
+    poolUsed_  = 0;
+    freeSlots_.clear();
+    if (!target_.isEmpty()) {
+        QFile f(poolDir() + "/pool.json");
+        if (f.open(QIODevice::ReadOnly)) {
+            const QJsonObject o = QJsonDocument::fromJson(f.readAll()).object();
+            slotBytes_ = qint64(o.value("slot_bytes").toDouble());
+            poolSlots_ = slotBytes_ > 0 ? o.value("slots").toInt() : 0;
+        }
+    }
+    if (poolSlots_ > 0) {
+        const QFileInfoList free = QDir(poolDir()).entryInfoList({ "slot_*" }, QDir::Files, QDir::Name);
+        for (const QFileInfo& fi : free) freeSlots_ << fi.absoluteFilePath();
+        QMetaObject::invokeMethod(db_, "countSegmentsUnder", Qt::BlockingQueuedConnection,
+                                  Q_RETURN_ARG(int, poolUsed_), Q_ARG(QString, target_ + "/"));
+        qInfo() << "[Migrator] loop recording:" << poolSlots_ << "slots of"
+                << slotBytes_ / (1024 * 1024) << "MiB," << poolUsed_ << "used,"
+                << freeSlots_.size() << "free";
+    }
+    emit loopPoolChanged(poolSlots_ > 0);
+}
+
+static QString nextSlotPath(const QString& poolDir, int from) {
+    QString path;
+    do {
+        path = QString("%1/slot_%2").arg(poolDir).arg(from++, 6, 10, QChar('0'));
+    } while (QFile::exists(path));
+    return path;
+}
+
+// Up front, a batch at a time between new segments, as long as the media
+// has room for another slot.
+void ArchiveMigrator::growPool() {
+    if (poolSlots_ <= 0 || poolUsed_ + freeSlots_.size() >= poolSlots_) return;
+    if (!QDir().mkpath(poolDir())) return;
+    QStorageInfo si(target_);
+    int n = 0;
+    while (poolUsed_ + freeSlots_.size() < poolSlots_ && n < kSlotBatch) {
+        si.refresh();
+        if (!si.isValid() || si.bytesAvailable() < slotBytes_ + si.bytesTotal() / 50) break;
+        const QString path = nextSlotPath(poolDir(), freeSlots_.size());
+        QFile f(path);
+        if (!f.open(QIODevice::WriteOnly)) break;
+        if (!reserveBlocks(f.handle(), slotBytes_) && !reserveWarned_) {
+            reserveWarned_ = true;
+            qWarning() << "[Migrator] cannot preallocate on" << target_ << "; slots grow as used";
+        }
+        f.close();
+        freeSlots_ << path;
+        ++n;
+    }
+    if (n == kSlotBatch) schedule(100);
+    else if (n) qInfo() << "[Migrator] loop pool:" << poolUsed_ + freeSlots_.size() << "of" << poolSlots_ << "slots";
+}
+
+// A free slot, else the oldest segment on the target (its row goes away
+// here). "" when neither exists.
+QString ArchiveMigrator::takeSlot() {
+    if (!freeSlots_.isEmpty()) return freeSlots_.takeFirst();
+    for (int tries = 0; tries < 8; ++tries) {
+        QString oldest;
+        QMetaObject::invokeMethod(db_, "takeOldestSegmentUnder", Qt::BlockingQueuedConnection,
+                                  Q_RETURN_ARG(QString, oldest), Q_ARG(QString, target_ + "/"));
+        if (oldest.isEmpty()) return QString();
+        --poolUsed_;
+        QFile::remove(oldest + ".kfi");
+        QFile::remove(ArchiveCipher::noncePath(oldest));
+        if (!QFile::exists(oldest)) continue;             // row without a file
+        if (poolUsed_ >= poolSlots_) {                    // pool was made smaller
+            QFile::remove(oldest);
+            removeEmptyParents(target_, QFileInfo(oldest).absolutePath());
+            continue;
+        }
+        return oldest;
+    }
+    return QString();
+}
+
+void ArchiveMigrator::releaseSlot(const QString& path) {
+    QDir().mkpath(poolDir());
+    const QString slot = nextSlotPath(poolDir(), freeSlots_.size());
+    if (QFile::rename(path, slot)) freeSlots_ << slot;
+    else QFile::remove(path);
+}
+
+void ArchiveMigrator::setRateLimit(qint64 bytesPerSec) {
+    rateBps_ = qMax<qint64>(kChunkBytes, bytesPerSec);
+}
+
+void ArchiveMigrator::enqueue(const QString& spoolPath) {
+    if (queued_.contains(spoolPath)) return;
+    const qint64 bytes = QFileInfo(spoolPath).size() + QFileInfo(spoolPath + ".kfi").size();
+    queued_.insert(spoolPath, bytes);
+    spoolBytes_ += bytes;
+    queue_.enqueue(spoolPath);
+    enforceSpoolCap();
+    emit spoolUsage(spoolBytes_, spoolCap_);
+    schedule();
+}
+
+void ArchiveMigrator::dequeued(const QString& path) {
+    spoolBytes_ -= queued_.take(path);
+    emit spoolUsage(spoolBytes_, spoolCap_);
+}
+
+void ArchiveMigrator::setSpool(const QString& spoolDir, qint64 capBytes) {
+    if (capBytes <= 0) {
+        const QStorageInfo si(spoolDir);
+        capBytes = si.isValid() ? si.bytesTotal() / 4 : 0;
+    }
+    spoolCap_ = capBytes;
+    qInfo() << "[Migrator] spool cap" << spoolCap_ / (1024 * 1024) << "MiB for" << spoolDir;
+    enforceSpoolCap();
+    emit spoolUsage(spoolBytes_, spoolCap_);
+}
+
+// Oldest first; the newest file stays (it is what the media gets next).
+void ArchiveMigrator::enforceSpoolCap() {
+    int dropped = 0;
+    while (spoolCap_ > 0 && spoolBytes_ > spoolCap_ && queue_.size() > 1) {
+        const QString path = queue_.dequeue();
+        spoolBytes_ -= queued_.take(path);
+        bool ok = false;
+        QMetaObject::invokeMethod(db_, "deleteSegment", Qt::BlockingQueuedConnection,
+                                  Q_RETURN_ARG(bool, ok), Q_ARG(QString, path));
+        QFile::remove(path + ".kfi");
+        QFile::remove(ArchiveCipher::noncePath(path));
+        QFile::remove(path);
+        ++dropped;
+    }
+    if (dropped)
+        qWarning() << "[Migrator] spool over" << spoolCap_ / (1024 * 1024) << "MiB: dropped"
+                   << dropped << "oldest segments";
+}
+
+void ArchiveMigrator::enqueueExisting(const QString& spoolDir) {
+    const QFileInfoList files = QDir(spoolDir).entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+    for (const QFileInfo& fi : files) {
+        if (isSegmentFile(fi.fileName())) enqueue(fi.absoluteFilePath());
+    }
+}
+
+void ArchiveMigrator::schedule(int delayMs) {
+    if (!timer_) {
+        timer_ = new QTimer(this);
+        timer_->setSingleShot(true);
+        connect(timer_, &QTimer::timeout, this, &ArchiveMigrator::pump);
+    }
+    if (!timer_->isActive()) timer_->start(delayMs);
+}
+
+void ArchiveMigrator::pump() {
+    if (target_.isEmpty()) return;
+    if (queue_.isEmpty()) {
+        reshardBatch();                   // old flat layout, between new segments
+        growPool();
+        return;
+    }
+
+    const QString src = queue_.head();
+    // the row must be closed first: finalize may still address it by path.
+    // Its close is on the way (queued behind the file-ready); let others by.
+    int status = -1;
+    QMetaObject::invokeMethod(db_, "segmentStatus", Qt::BlockingQueuedConnection,
+                              Q_RETURN_ARG(int, status), Q_ARG(QString, src));
+    if (status == 0) {
+        queue_.enqueue(queue_.dequeue());
+        schedule(++deferred_ < queue_.size() ? 0 : 1000);  // all open: wait a bit
+        return;
+    }
+    deferred_ = 0;
+    QString err;
+    if (migrateOne(src, status, &err)) {
+        queue_.dequeue();
+        dequeued(src);
+    } else if (!QFileInfo::exists(src)) {
+        queue_.dequeue();                 // vanished (deleted by retention etc.)
+        dequeued(src);
+    } else {
+        qWarning() << "[Migrator]" << src << ":" << err;
+        emit failed(src, err);
+        schedule(5000);                   // media busy/full/gone: retry later
+        return;
+    }
+    if (!queue_.isEmpty()) schedule();
+}
+
+bool ArchiveMigrator::migrateOne(const QString& src, int status, QString* err) {
+    const QString dst  = shardedPath(target_, QFileInfo(src).fileName());
+    const QString dir  = QFileInfo(dst).absolutePath();
+    const qint64  size = QFileInfo(src).size();
+    if (!QDir().mkpath(dir)) { *err = "cannot create " + dir; return false; }
+
+    // loop recording: reuse a slot file instead of creating one
+    QString slot;
+    if (poolSlots_ > 0) {
+        QStorageInfo si(target_);
+        const bool room = si.isValid() && si.bytesAvailable() >= 2 * size + si.bytesTotal() / 50;
+        if (!freeSlots_.isEmpty() || poolUsed_ >= poolSlots_ || !room) slot = takeSlot();
+        if (slot.isEmpty() && !room) { *err = "archive full"; return false; }
+    } else if (!ensureRoom(size)) {
+        *err = "archive full";
+        return false;
+    }
+    const QString part = dst + ".part";
+    const auto discard = [&](const QString& path) {
+        if (slot.isEmpty()) QFile::remove(path);
+        else releaseSlot(path);           // back to the pool, blocks and all
+    };
+    if (!slot.isEmpty()) {
+        QFile::remove(part);
+        if (!QFile::rename(slot, part)) {
+            *err = "cannot reuse " + slot;
+            return false;
+        }
+        if (QFileInfo(slot).absolutePath() != poolDir())
+            removeEmptyParents(target_, QFileInfo(slot).absolutePath());
+    }
+
+    if (!copyThrottled(src, part, err, !slot.isEmpty())) { discard(part); return false; }
+    // An encrypted file is unreadable without its nonce: that sidecar lands
+    // before the segment gets its final name.
+    const QString iv = ArchiveCipher::noncePath(src);
+    QFile::remove(ArchiveCipher::noncePath(dst));
+    if (QFile::exists(iv) && (!QFile::copy(iv, ArchiveCipher::noncePath(dst))
+                              || !archiveio::syncFile(ArchiveCipher::noncePath(dst)))) {
+        discard(part);
+        *err = "nonce sidecar copy failed";
+        return false;
+    }
+    QFile::remove(dst);                   // stale copy from an interrupted run
+    if (!QFile::rename(part, dst)) {
+        discard(part);
+        *err = "rename failed";
+        return false;
+    }
+    // the row is repointed next; the directory entry must survive a power cut
+    if (!archiveio::syncDir(dir))
+        qWarning() << "[Migrator] directory fsync failed for" << dst;
+
+    bool ok = status < 0;                 // no row to repoint
+    if (status < 0) qWarning() << "[Migrator] no DB row for" << src << "- moving the file as is";
+    else QMetaObject::invokeMethod(db_, "relocateSegment", Qt::BlockingQueuedConnection,
+                                   Q_RETURN_ARG(bool, ok),
+                                   Q_ARG(QString, src), Q_ARG(QString, dst));
+    if (!ok) {
+        // Keep the spool copy authoritative; the archive copy is just a duplicate.
+        discard(dst);
+        QFile::remove(ArchiveCipher::noncePath(dst));
+        *err = "DB relocate failed";
+        return false;
+    }
+    if (poolSlots_ > 0) ++poolUsed_;
+
+    // Sidecars travel with the segment (best effort).
+    const QString kfi = src + ".kfi";
+    if (QFile::exists(kfi)) {
+        QFile::remove(dst + ".kfi");
+        if (!QFile::copy(kfi, dst + ".kfi")) qWarning() << "[Migrator] sidecar copy failed" << kfi;
+        QFile::remove(kfi);
+    }
+    QFile::remove(iv);
+    QFile::remove(src);
+    qInfo() << "[Migrator] moved" << src << "->" << dst << (slot.isEmpty() ? "" : "(reused slot)");
+    emit migrated(src, dst);
+    return true;
+}
+
+// Same filesystem: rename segment + keyframe sidecar, then repoint the row.
+// A file no row knows about (never indexed, or a foreign DB) moves as is.
+bool ArchiveMigrator::moveWithSidecar(const QString& src, const QString& dst) {
+    if (!QDir().mkpath(QFileInfo(dst).absolutePath())) return false;
+    int status = -1;
+    QMetaObject::invokeMethod(db_, "segmentStatus", Qt::BlockingQueuedConnection,
+                              Q_RETURN_ARG(int, status), Q_ARG(QString, src));
+    const QString iv = ArchiveCipher::noncePath(src);
+    const bool hasIv = QFile::exists(iv);
+    if (hasIv && !QFile::rename(iv, ArchiveCipher::noncePath(dst))) return false;
+    if (QFile::exists(dst) || !QFile::rename(src, dst)) {
+        if (hasIv) QFile::rename(ArchiveCipher::noncePath(dst), iv);
+        return false;
+    }
+    // both directories changed; make that durable before the row follows
+    if (!archiveio::syncDir(QFileInfo(dst).absolutePath())
+        || !archiveio::syncDir(QFileInfo(src).absolutePath()))
+        qWarning() << "[Migrator] directory fsync failed for" << dst;
+    bool ok = status < 0;
+    if (status < 0) ++reshardNoRow_;
+    else QMetaObject::invokeMethod(db_, "relocateSegment", Qt::BlockingQueuedConnection,
+                                   Q_RETURN_ARG(bool, ok),
+                                   Q_ARG(QString, src), Q_ARG(QString, dst));
+    if (!ok) {
+        QFile::rename(dst, src);
+        if (hasIv) QFile::rename(ArchiveCipher::noncePath(dst), iv);
+        return false;
+    }
+    const QString kfi = src + ".kfi";
+    if (QFile::exists(kfi)) QFile::rename(kfi, dst + ".kfi");
+    return true;
+}
+
+void ArchiveMigrator::reshardBatch() {
+    if (!reshardScanned_) {
+        reshardScanned_ = true;
+        QDirIterator it(target_, QDir::Files);        // top level only
+        while (it.hasNext()) {
+            it.next();
+            if (isSegmentFile(it.fileName())) reshardTodo_ << it.filePath();
+        }
+        if (!reshardTodo_.isEmpty())
+            qInfo() << "[Migrator] moving" << reshardTodo_.size() << "flat archive files into camN/YYYY/MM/DD";
+    }
+    int n = 0;
+    while (!reshardTodo_.isEmpty() && n < kReshardBatch) {
+        const QString src = reshardTodo_.takeLast();
+        const QString dst = shardedPath(target_, QFileInfo(src).fileName());
+        if (dst == src) continue;
+        if (!moveWithSidecar(src, dst)) qWarning() << "[Migrator] reshard failed for" << src;
+        ++n;
+    }
+    if (!reshardTodo_.isEmpty()) schedule();
+    else if (n) {
+        qInfo() << "[Migrator] archive layout migrated";
+        if (reshardNoRow_)
+            qWarning() << "[Migrator]" << reshardNoRow_ << "flat files had no DB row; moved as is";
+    }
+}
+
+bool ArchiveMigrator::ensureRoom(qint64 bytes) {
+    QStorageInfo si(target_);
+    const qint64 reserve = qMax<qint64>(2 * bytes, si.bytesTotal() / 50);
+    while (si.isValid() && si.bytesAvailable() < reserve) {
+        if (!pruneOldestDay()) return false;
+        si.refresh();
+    }
+    return true;
+}
+
+// Oldest day across all cameras goes in one step: rows first, then the
+// directories (one recursive delete per camera instead of a file per segment).
+bool ArchiveMigrator::pruneOldestDay() {
+    const QDir root(target_);
+    const auto sorted = [](const QString& path) {
+        return QDir(path).entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    };
+    QString oldest;                         // "yyyy/MM/dd"
+    const QStringList cams = root.entryList({ "cam*" }, QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString& cam : cams) {
+        const QString camDir = root.filePath(cam);
+        for (const QString& y : sorted(camDir)) {
+            QString found;
+            for (const QString& m : sorted(camDir + "/" + y)) {
+                const QStringList days = sorted(camDir + "/" + y + "/" + m);
+                if (!days.isEmpty()) { found = y + "/" + m + "/" + days.first(); break; }
+            }
+            if (found.isEmpty()) continue;
+            if (oldest.isEmpty() || found < oldest) oldest = found;
+            break;
+        }
+    }
+    const QDate day = QDate::fromString(oldest, "yyyy/MM/dd");
+    if (!day.isValid() || day >= QDate::currentDate()) {
+        qWarning() << "[Migrator] archive full and nothing older than today to remove";
+        return false;
+    }
+
+    int rows = 0;
+    bool removed = false;
+    for (const QString& cam : cams) {
+        const QString dayDir = root.filePath(cam + "/" + oldest);
+        if (!QFileInfo(dayDir).isDir()) continue;
+        int n = 0;
+        QMetaObject::invokeMethod(db_, "deleteSegmentsUnder", Qt::BlockingQueuedConnection,
+                                  Q_RETURN_ARG(int, n), Q_ARG(QString, dayDir + "/"));
+        rows += n;
+        removed |= QDir(dayDir).removeRecursively();
+        // drop month/year directories that became empty
+        root.rmdir(cam + "/" + oldest.left(7));
+        root.rmdir(cam + "/" + oldest.left(4));
+    }
+    qInfo() << "[Migrator] retention removed" << day.toString("yyyy-MM-dd") << "(" << rows << "segments)";
+    emit dayPruned(day.toString("yyyy-MM-dd"), rows);
+    return removed;                         // false: stuck on this day, don't spin
+}
+
+// inPlace: dst is a loop slot; overwrite it without giving its blocks back.
+bool ArchiveMigrator::copyThrottled(const QString& src, const QString& dst, QString* err, bool inPlace) {
+    QFile in(src), out(dst);
+    if (!in.open(QIODevice::ReadOnly))  { *err = in.errorString();  return false; }
+    const QIODevice::OpenMode mode = inPlace ? QIODevice::ReadWrite          // no O_TRUNC
+                                             : QIODevice::WriteOnly | QIODevice::Truncate;
+    if (!out.open(mode)) { *err = out.errorString(); return false; }
+
+    QElapsedTimer clock; clock.start();
+    qint64 copied = 0;
+    QByteArray buf;
+    while (!(buf = in.read(kChunkBytes)).isEmpty()) {
+        if (out.write(buf) != buf.size()) { *err = out.errorString(); return false; }
+        copied += buf.size();
+        // token-bucket style: sleep until we're back under the rate limit
+        const qint64 dueMs = copied * 1000 / rateBps_;
+        const qint64 aheadMs = dueMs - clock.elapsed();
+        if (aheadMs > 0) QThread::msleep(static_cast<unsigned long>(aheadMs));
+    }
+    if (in.error() != QFile::NoError) { *err = in.errorString(); return false; }
+    if (!out.flush()) { *err = out.errorString(); return false; }
+    if (inPlace) {
+        // shorter than what the slot held: cut the stale tail, then take
+        // the slot's size back (KEEP_SIZE, so readers see only the segment)
+        if (out.size() > copied && !out.resize(copied)) { *err = "truncate failed"; return false; }
+        if (slotBytes_ > copied) reserveBlocks(out.handle(), slotBytes_);
+    }
+    if (::fsync(out.handle()) != 0) { *err = "fsync failed"; return false; }
+    return true;
+}
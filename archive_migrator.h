@@ -0,0 +1,108 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QQueue>
+#include <QStringList>
+
+class DbWriter;
+class QTimer;
+
+/**
+ * ArchiveMigrator
+ * ---------------
+ * Moves finalized segments from the internal spool directory to the
+ * removable archive, one file at a time, throttled so recording I/O is not
+ * starved. Lives on its own thread (owner does moveToThread).
+ *
+ * Per file: copy to "<dest>.part" → fsync → rename → DbWriter::relocateSegment
+ * (single UPDATE, so readers see either the old or the new path) → unlink spool copy.
+ * If the target disappears mid-copy the file stays in the queue until a new
+ * target is set.
+ *
+ * Layout on the target: <archiveDir>/camN/YYYY/MM/DD/<file> (one flat
+ * directory of 100k+ entries is slow on FAT/exFAT). Files left flat by older
+ * builds are moved into place after setTarget, a batch at a time between
+ * new segments. Retention works on whole day directories: before a copy
+ * the oldest day (across all cameras) is removed until 2% of the media is
+ * free again.
+ *
+ * Loop recording (setLoopPool, remembered in <archiveDir>/.pool/pool.json):
+ * the media holds a fixed number of equally sized files, reserved with
+ * fallocate up front (<archiveDir>/.pool/slot_N until first used). Each new
+ * segment takes a free slot or, once all are used, the oldest segment's
+ * file: its row is dropped, the file renamed into place and overwritten, so
+ * there is no per-segment create/unlink and disk usage stays constant.
+ * Day retention is off in this mode.
+ *
+ * The spool is capped (setSpool): while the media is away, queued files
+ * beyond the cap are dropped oldest first (file, sidecar and row), and
+ * spoolUsage lets the owner degrade quality before that happens. A file is
+ * only moved once its row is closed; one without a row (lost with the last
+ * DB batch) is moved as is.
+ */
+class ArchiveMigrator : public QObject {
+    Q_OBJECT
+public:
+    explicit ArchiveMigrator(DbWriter* db, QObject* parent = nullptr);
+
+public slots:
+    void setTarget(const QString& archiveDir);     // empty = no removable media
+    void setRateLimit(qint64 bytesPerSec);
+    void enqueue(const QString& spoolPath);        // a closed segment
+    void enqueueExisting(const QString& spoolDir); // leftovers from previous runs
+    // Byte cap for queued spool files; 0 = a quarter of the spool filesystem.
+    void setSpool(const QString& spoolDir, qint64 capBytes);
+    // Loop recording on the current target: `slots` files of slotBytes each.
+    // 0 slots = off (free slots are deleted, recorded files stay).
+    void setLoopPool(int slots, qint64 slotBytes);
+
+public:
+    // "<root>/camN/YYYY/MM/DD/<fileName>"; root itself for unrecognized names.
+    static QString shardedPath(const QString& root, const QString& fileName);
+
+signals:
+    void migrated(QString fromPath, QString toPath);
+    void dayPruned(QString day, int segments);   // retention removed a day ("yyyy-MM-dd")
+    void failed(QString path, QString reason);
+    void loopPoolChanged(bool on);             // per target; also sent by setTarget
+    void spoolUsage(qint64 queuedBytes, qint64 capBytes);   // on every change
+
+private slots:
+    void pump();
+
+private:
+    bool migrateOne(const QString& src, int status, QString* err);  // status: segmentStatus()
+    bool copyThrottled(const QString& src, const QString& dst, QString* err, bool inPlace = false);
+    bool moveWithSidecar(const QString& src, const QString& dst);
+    void reshardBatch();
+    bool ensureRoom(qint64 bytes);
+    bool pruneOldestDay();
+    void schedule(int delayMs = 0);
+    void dequeued(const QString& path);
+    void enforceSpoolCap();
+    // loop pool
+    QString poolDir() const;
+    void loadPool();
+    void growPool();
+    QString takeSlot();              // free slot, else the oldest segment file; "" = none
+    void releaseSlot(const QString& path);
+
+    DbWriter*      db_;
+    QString        target_;
+    qint64         rateBps_ = 16LL * 1024 * 1024;   // keep well below USB write speed
+    QQueue<QString> queue_;
+    QHash<QString, qint64> queued_;  // path -> bytes (segment + sidecar)
+    qint64         spoolBytes_ = 0;  // sum of queued_
+    qint64         spoolCap_   = 0;  // 0 = no cap
+    QTimer*        timer_ = nullptr;
+    int            deferred_ = 0;   // open segments rotated to the back in a row
+    QStringList    reshardTodo_;    // flat files still to move into shards
+    bool           reshardScanned_ = false;
+    int            reshardNoRow_ = 0;   // flat files moved without a DB row to repoint
+    int            poolSlots_ = 0;  // 0 = loop recording off
+    qint64         slotBytes_ = 0;
+    int            poolUsed_  = 0;  // segment files on the target
+    QStringList    freeSlots_;
+    bool           reserveWarned_ = false;
+};
@@ -0,0 +1,138 @@
+#include "archive_sink_tap.h"
+#include "archive_cipher.h"
+#include "recording_stats.h"
+#include <QDebug>
+
+void ArchiveSinkTap::attach(GstElement* fileSink, RecordingStats* stats, DigestFn onDigest) {
+    GstPad* pad = gst_element_get_static_pad(fileSink, "sink");
+    if (!pad) {
+        qWarning() << "[SinkTap] sink has no static sink pad";
+        return;
+    }
+    auto* tap = new ArchiveSinkTap(fileSink, stats, std::move(onDigest));
+    gst_pad_add_probe(pad,
+                      GstPadProbeType(GST_PAD_PROBE_TYPE_BUFFER |
+                                      GST_PAD_PROBE_TYPE_BUFFER_LIST |
+                                      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+                      &ArchiveSinkTap::onProbe, tap, &ArchiveSinkTap::destroy);
+    gst_object_unref(pad);
+}
+
+void ArchiveSinkTap::destroy(gpointer user_data) {
+    delete static_cast<ArchiveSinkTap*>(user_data);
+}
+
+GstPadProbeReturn ArchiveSinkTap::onProbe(GstPad*, GstPadProbeInfo* info, gpointer user_data) {
+    auto* self = static_cast<ArchiveSinkTap*>(user_data);
+
+    // encrypting rewrites the payload: the sink must get our own copy
+    const bool encrypt = ArchiveCipher::enabled();
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+        GstBuffer* buf = GST_PAD_PROBE_INFO_BUFFER(info);
+        if (encrypt) GST_PAD_PROBE_INFO_DATA(info) = buf = gst_buffer_make_writable(buf);
+        if (!self->onBuffer(buf)) return GST_PAD_PROBE_DROP;
+    } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+        GstBufferList* list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+        if (encrypt) GST_PAD_PROBE_INFO_DATA(info) = list = gst_buffer_list_make_writable(list);
+        const guint n = gst_buffer_list_length(list);
+        bool keep = true;
+        for (guint i = 0; i < n && keep; ++i)
+            keep = self->onBuffer(encrypt ? gst_buffer_list_get_writable(list, i) : gst_buffer_list_get(list, i));
+        if (!keep) return GST_PAD_PROBE_DROP;
+    } else if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+        GstEvent* ev = GST_PAD_PROBE_INFO_EVENT(info);
+        switch (GST_EVENT_TYPE(ev)) {
+        case GST_EVENT_SEGMENT: {
+            // Muxers rewrite headers/sizes by sending a BYTES segment = seek.
+            const GstSegment* seg = nullptr;
+            gst_event_parse_segment(ev, &seg);
+            if (seg && seg->format == GST_FORMAT_BYTES) self->pos_ = qint64(seg->start);
+            break;
+        }
+        case GST_EVENT_EOS:
+            self->onEos();
+            break;
+        default:
+            break;
+        }
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+bool ArchiveSinkTap::onBuffer(GstBuffer* buf) {
+    if (ArchiveCipher::enabled() && !cipher_ && !failed_) {
+        cipher_.reset(new CipherStream(location(), true));
+        if (!cipher_->isValid()) fail("cannot write the nonce sidecar");
+    }
+    if (failed_) return false;
+    const qint64 size = qint64(gst_buffer_get_size(buf));
+    if (stats_)
+        stats_->onWritten(GST_BUFFER_PTS_IS_VALID(buf) ? qint64(GST_BUFFER_PTS(buf)) : -1, size);
+    // Only appends at the end of the file are new media; header rewrites
+    // (seek back + overwrite) carry no timestamps.
+    if (GST_BUFFER_PTS_IS_VALID(buf)) {
+        const qint64 pts = qint64(GST_BUFFER_PTS(buf));
+        if (firstPts_ < 0) firstPts_ = pts;
+        if (!GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT)) {
+            if (!index_.isOpen()) {
+                const QString path = location();
+                if (!path.isEmpty()) index_.open(KeyframeIndex::sidecarPath(path));
+            }
+            index_.append(pts - firstPts_, pos_);
+        }
+    }
+    if (cipher_ || onDigest_) {
+        // CTR is per byte offset, so header rewrites encrypt like appends;
+        // the digest is taken over what lands on disk
+        GstMapInfo map;
+        if (gst_buffer_map(buf, &map, cipher_ ? GST_MAP_READWRITE : GST_MAP_READ)) {
+            if (cipher_) cipher_->apply(pos_, map.data, qint64(map.size));
+            if (onDigest_) hasher_.write(pos_, reinterpret_cast<const char*>(map.data), qint64(map.size));
+            gst_buffer_unmap(buf, &map);
+        } else if (cipher_) {
+            fail(QString("cannot map buffer for encryption at %1").arg(pos_));
+            return false;
+        }
+    }
+    pos_ += size;
+    return true;
+}
+
+// Fails the segment the way a write error would: the worker sees an error
+// from its splitmuxsink (main: recording restarts; sub: branch dropped).
+void ArchiveSinkTap::fail(const QString& what) {
+    if (failed_) return;
+    failed_ = true;
+    const QString path = location();
+    qWarning() << "[SinkTap]" << what << "for" << path << "- segment dropped";
+    GError* err = g_error_new(GST_STREAM_ERROR, GST_STREAM_ERROR_ENCRYPT, "%s",
+                              qPrintable("Cannot encrypt segment: " + what));
+    gst_element_post_message(sink_, gst_message_new_error(GST_OBJECT(sink_), err,
+                                                          path.toUtf8().constData()));
+    g_error_free(err);
+}
+
+QString ArchiveSinkTap::location() const {
+    gchar* loc = nullptr;
+    g_object_get(sink_, "location", &loc, nullptr);
+    const QString out = QString::fromUtf8(loc ? loc : "");
+    g_free(loc);
+    return out;
+}
+
+void ArchiveSinkTap::onEos() {
+    const QString path = location();
+    cipher_.reset();     // a reused sink writes the next file under another name
+    failed_ = false;
+    if (index_.isOpen())
+        qDebug() << "[SinkTap] keyframe index:" << index_.count() << "entries for" << path;
+    index_.close();
+    firstPts_ = -1;      // the next file's entries are relative to its own start
+    if (path.isEmpty()) return;
+    if (onDigest_) {
+        int rehashed = 0;
+        const QByteArray digest = hasher_.finish(path, &rehashed);
+        if (digest.isEmpty()) qWarning() << "[SinkTap] no digest for" << path;
+        onDigest_(path, digest, rehashed);  // empty: the row is marked unhashed
+    }
+}
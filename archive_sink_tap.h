@@ -0,0 +1,61 @@
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <functional>
+#include <memory>
+#include <gst/gst.h>
+#include "archive_cipher.h"
+#include "keyframe_index.h"
+#include "segment_hash.h"
+
+class RecordingStats;
+
+/**
+ * ArchiveSinkTap
+ * --------------
+ * Observer installed on every file sink splitmuxsink creates (one per
+ * segment, see ArchiveWorker's "sink-added" handler). It sees exactly the
+ * bytes handed to the file, in file order:
+ * - tracks the write position (muxers seek back via BYTES segment events)
+ * - encrypts the bytes in place when ArchiveCipher is enabled; if it
+ *   cannot, the buffers are dropped and an error is posted from the sink
+ *   (plaintext never reaches the file)
+ * - appends each keyframe's PTS and byte offset to the segment's sidecar
+ *   as it goes (KeyframeIndexWriter), so a crash keeps it
+ * - hashes the file as it is written (SegmentHasher)
+ * - on EOS closes the sidecar and hands the digest to onDigest (called
+ *   on the streaming thread; empty when it could not be taken)
+ * - feeds bytes written / write latency into the camera's RecordingStats
+ *
+ * Lifetime is tied to the pad probe; nothing to free by the caller.
+ */
+class ArchiveSinkTap {
+public:
+    // rehashed: blocks re-read from disk because the muxer patched them
+    // after they were hashed (see SegmentHasher)
+    using DigestFn = std::function<void(const QString& path, const QByteArray& sha256, int rehashed)>;
+
+    static void attach(GstElement* fileSink, RecordingStats* stats = nullptr,
+                       DigestFn onDigest = nullptr);
+
+private:
+    ArchiveSinkTap(GstElement* fileSink, RecordingStats* stats, DigestFn onDigest)
+        : sink_(fileSink), stats_(stats), onDigest_(std::move(onDigest)) {}
+    static GstPadProbeReturn onProbe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static void destroy(gpointer user_data);
+
+    bool onBuffer(GstBuffer* buf);  // false: drop it (segment failed)
+    void onEos();
+    void fail(const QString& what);
+    QString location() const;
+
+    GstElement*   sink_;            // not owned; outlives the probe
+    RecordingStats* stats_;         // not owned; owned by the ArchiveWorker
+    DigestFn      onDigest_;
+    qint64        pos_ = 0;         // current write offset in the file
+    qint64        firstPts_ = -1;
+    KeyframeIndexWriter index_;
+    SegmentHasher hasher_;
+    std::unique_ptr<CipherStream> cipher_;   // per file, created on its first buffer
+    bool          failed_ = false;  // encryption impossible: nothing more reaches the file
+};
@@ -0,0 +1,229 @@
+#include "archive_transcoder.h"
+#include "archive_cipher.h"
+#include "archive_io.h"
+#include "db_writer.h"
+#include "keyframe_index.h"
+#include "sched_policy.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QTime>
+#include <QTimer>
+#include <QVariant>
+#include <QDebug>
+#include <signal.h>
+
+static const int kIdleMs    = 30 * 60 * 1000;   // nothing aged yet / outside window
+static const int kBusyMs    = 60 * 1000;        // box busy: look again soon
+static const int kNoToolMs  = 6 * 3600 * 1000;  // ffmpeg missing
+
+ArchiveTranscoder::ArchiveTranscoder(DbWriter* db, const QString& dbPath, const QString& spoolDir,
+                                     QObject* parent)
+    : QObject(parent), db_(db), dbPath_(dbPath), spoolDir_(spoolDir) {}
+
+ArchiveTranscoder::~ArchiveTranscoder() {
+    archiveio::closeReadOnly(&ro_);
+}
+
+void ArchiveTranscoder::start() {
+    if (!archiveio::openReadOnly(&ro_, "camvigil_transcode", dbPath_, "[Transcode]")) return;
+    qInfo() << "[Transcode] segments older than" << policy_.ageDays << "days ->"
+            << policy_.targetHeight << "p, window" << policy_.startHour << "-" << policy_.endHour << "h";
+    timer_ = new QTimer(this);
+    timer_->setSingleShot(true);
+    connect(timer_, &QTimer::timeout, this, &ArchiveTranscoder::tick);
+    timer_->start(5 * 60 * 1000);
+}
+
+void ArchiveTranscoder::tick() {
+    if (stop_.load()) return;
+    if (suspended_.load())  { timer_->start(kIdleMs); return; }
+    if (!inWindow())        { timer_->start(kIdleMs); return; }
+    if (loadTooHigh(0.0))   { timer_->start(kBusyMs); return; }
+
+    Job job;
+    if (!nextJob(&job))     { timer_->start(kIdleMs); return; }
+    noTool_ = false;
+    const bool ok = processJob(job);
+    if (stop_.load()) return;
+    if (noTool_)            { timer_->start(kNoToolMs); return; }
+    if (!ok) failed_.insert(job.id);
+    timer_->start(0);
+}
+
+bool ArchiveTranscoder::nextJob(Job* job) {
+    const qint64 cutoffNs =
+        QDateTime::currentDateTimeUtc().addDays(-policy_.ageDays).toMSecsSinceEpoch() * 1000000LL;
+    QSqlQuery q(ro_);
+    q.setForwardOnly(true);
+    q.prepare(R"SQL(
+      SELECT s.id, s.file_path,
+             (SELECT x.file_path FROM segments x
+               WHERE x.main_segment_id = s.id AND x.status = 1 AND COALESCE(x.health,0) IN (0,1)
+               ORDER BY x.start_utc_ns LIMIT 1) AS sub_path
+      FROM segments s
+      WHERE s.status = 1
+        AND s.aged_at IS NULL
+        AND COALESCE(s.variant,0) = 0
+        AND COALESCE(s.quality,0) = 0
+        AND COALESCE(s.health,0) < 3
+        AND s.end_utc_ns < :cutoff
+        AND substr(s.file_path, 1, length(:spool)) <> :spool
+      ORDER BY s.start_utc_ns
+      LIMIT 16
+    )SQL");
+    q.bindValue(":cutoff", cutoffNs);
+    q.bindValue(":spool", spoolDir_ + "/");
+    if (!q.exec()) {
+        qWarning() << "[Transcode] query:" << q.lastError().text();
+        return false;
+    }
+    while (q.next()) {
+        const qint64 id = q.value(0).toLongLong();
+        if (failed_.contains(id)) continue;
+        job->id      = id;
+        job->path    = q.value(1).toString();
+        job->subPath = q.value(2).toString();
+        return true;
+    }
+    return false;
+}
+
+bool ArchiveTranscoder::processJob(const Job& job) {
+    const qint64 oldSize = QFileInfo(job.path).size();
+    if (!QFile::exists(job.path)) return false;         // verifier will flag it
+    if (ArchiveCipher::isEncrypted(job.path)) {
+        // ffmpeg cannot read it, and the sub copy's nonce sidecar would have
+        // to follow the rename: keep the original
+        QMetaObject::invokeMethod(db_, "markAged", Qt::QueuedConnection, Q_ARG(qint64, job.id));
+        return true;
+    }
+
+    const QFileInfo fi(job.path);
+    const QString out = fi.dir().filePath(fi.completeBaseName() + "_lr." + fi.suffix());
+
+    // Cheapest path: the low-res copy already exists. Renamed so it lists
+    // like any other segment (sub copies are hidden from the archive list).
+    if (!job.subPath.isEmpty() && QFile::exists(job.subPath)) {
+        QFile::remove(out);
+        if (!QFile::rename(job.subPath, out)) return false;
+        if (!swapFile(job, out, 1, job.subPath)) {
+            QFile::rename(out, job.subPath);
+            return false;
+        }
+        QFile::remove(KeyframeIndex::sidecarPath(out));
+        QFile::rename(KeyframeIndex::sidecarPath(job.subPath), KeyframeIndex::sidecarPath(out));
+        emit segmentAged(job.path, out, oldSize - QFileInfo(out).size());
+        return true;
+    }
+
+    QString err;
+    if (!transcode(job.path, out, &err)) {
+        if (!stop_.load()) qWarning() << "[Transcode]" << job.path << ":" << err;
+        return false;
+    }
+    const qint64 newSize = QFileInfo(out).size();
+    if (newSize <= 0 || newSize >= oldSize * 9 / 10) {
+        // already small (static scene, low bitrate camera): keep the original
+        QFile::remove(out);
+        QMetaObject::invokeMethod(db_, "markAged", Qt::QueuedConnection, Q_ARG(qint64, job.id));
+        return true;
+    }
+    if (!swapFile(job, out, 3)) {
+        QFile::remove(out);
+        return false;
+    }
+    emit segmentAged(job.path, out, oldSize - newSize);
+    return true;
+}
+
+// New file is complete on disk; switch the row over, then drop the old file.
+bool ArchiveTranscoder::swapFile(const Job& job, const QString& newPath, int quality,
+                                 const QString& consumedSubPath) {
+    bool ok = false;
+    QMetaObject::invokeMethod(db_, "replaceSegmentFile", Qt::BlockingQueuedConnection,
+                              Q_RETURN_ARG(bool, ok),
+                              Q_ARG(qint64, job.id), Q_ARG(QString, job.path),
+                              Q_ARG(QString, newPath), Q_ARG(int, quality),
+                              Q_ARG(QString, consumedSubPath));
+    if (!ok) return false;
+    QFile::remove(job.path);
+    QFile::remove(KeyframeIndex::sidecarPath(job.path));   // offsets are for the old file
+    qInfo() << "[Transcode]" << job.path << "->" << newPath;
+    return true;
+}
+
+bool ArchiveTranscoder::transcode(const QString& in, const QString& out, QString* err) {
+    const QString part = out + ".part";
+    QStringList args;
+    args << "-hide_banner" << "-nostdin" << "-y" << "-loglevel" << "error"
+         << "-i" << in
+         << "-map" << "0:v:0" << "-an"
+         << "-vf" << QString("scale=-2:'min(%1,ih)'").arg(policy_.targetHeight)
+         << "-c:v" << "libx264" << "-preset" << "veryfast"
+         << "-crf" << QString::number(policy_.crf)
+         << "-threads" << "1";
+    const QString fmt = archiveio::ffmpegFormat(QFileInfo(out).suffix());
+    if (fmt == "mp4") args << "-movflags" << "+frag_keyframe+empty_moov";
+    args << "-f" << fmt << part;
+
+    QProcess p;
+    p.setProcessChannelMode(QProcess::SeparateChannels);
+    p.start(policy_.ffmpegPath, args);
+    if (!p.waitForStarted(5000)) {
+        *err = "cannot start " + policy_.ffmpegPath;
+        noTool_ = true;
+        return false;
+    }
+    const qint64 pid = p.processId();
+    SchedPolicy::applyToProcess(pid, SchedClass::Background);
+
+    bool paused = false;
+    while (!p.waitForFinished(1000)) {
+        if (p.state() == QProcess::NotRunning) break;
+        if (stop_.load()) {
+            if (paused) ::kill(pid_t(pid), SIGCONT);
+            p.kill();
+            p.waitForFinished();
+            QFile::remove(part);
+            *err = "stopped";
+            return false;
+        }
+        // ffmpeg itself adds ~1 to the load while running
+        const bool hold = !inWindow() || loadTooHigh(paused ? 0.0 : 1.0);
+        if (hold != paused) {
+            ::kill(pid_t(pid), hold ? SIGSTOP : SIGCONT);
+            paused = hold;
+        }
+    }
+    if (p.exitStatus() != QProcess::NormalExit || p.exitCode() != 0) {
+        *err = QString::fromUtf8(p.readAllStandardError()).trimmed().right(300);
+        if (err->isEmpty()) *err = QString("ffmpeg exit %1").arg(p.exitCode());
+        QFile::remove(part);
+        return false;
+    }
+
+    return archiveio::commitPart(part, out, err);
+}
+
+bool ArchiveTranscoder::inWindow() const {
+    const int h = QTime::currentTime().hour();
+    if (policy_.startHour == policy_.endHour) return true;   // all day
+    if (policy_.startHour < policy_.endHour)
+        return h >= policy_.startHour && h < policy_.endHour;
+    return h >= policy_.startHour || h < policy_.endHour;    // wraps midnight
+}
+
+bool ArchiveTranscoder::loadTooHigh(double ownLoad) const {
+    QFile f("/proc/loadavg");
+    if (!f.open(QIODevice::ReadOnly)) return false;
+    const double load1 = f.readLine().split(' ').value(0).toDouble();
+    const double limit = policy_.maxLoad > 0.0 ? policy_.maxLoad
+                                               : 0.75 * qMax(1, QThread::idealThreadCount());
+    return load1 - ownLoad > limit;
+}
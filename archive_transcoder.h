@@ -0,0 +1,82 @@
+#pragma once
+#include <QObject>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QString>
+#include <atomic>
+
+class DbWriter;
+class QTimer;
+
+/**
+ * ArchiveTranscoder
+ * -----------------
+ * Shrinks aged footage so the same media holds more days. Lives on its own
+ * idle-priority thread (owner does moveToThread, then invokes start()).
+ *
+ * One segment at a time, oldest first, only for finalized full-quality main
+ * segments older than ageDays that already left the spool:
+ * - with a substream copy the copy simply becomes the segment
+ * - otherwise ffmpeg re-encodes it to targetHeight / crf into "<name>_lr.<ext>"
+ * The new file is complete before DbWriter::replaceSegmentFile swaps the row
+ * (path, size, quality=3), and only then is the old file removed.
+ *
+ * ffmpeg runs single-threaded in SchedClass::Background (nice 19 / idle
+ * I/O class by default), only inside the [startHour, endHour) window, and
+ * is SIGSTOPped while the 1-minute load average is above maxLoad.
+ */
+class ArchiveTranscoder : public QObject {
+    Q_OBJECT
+public:
+    struct Policy {
+        int     ageDays      = 7;
+        int     targetHeight = 480;
+        int     crf          = 30;
+        int     startHour    = 1;       // local time window, may wrap midnight
+        int     endHour      = 6;
+        double  maxLoad      = 0.0;     // 0 = 0.75 per core
+        QString ffmpegPath   = "ffmpeg";
+    };
+
+    ArchiveTranscoder(DbWriter* db, const QString& dbPath, const QString& spoolDir,
+                      QObject* parent = nullptr);
+    ~ArchiveTranscoder();
+
+    // Call before start().
+    void setPolicy(const Policy& policy) { policy_ = policy; }
+    // Any thread: abort the running ffmpeg so the owner's thread can quit.
+    void requestStop() { stop_.store(true); }
+    // Any thread: skip work while set (loop recording reuses files instead).
+    void setSuspended(bool on) { suspended_.store(on); }
+
+public slots:
+    void start();
+
+signals:
+    void segmentAged(QString oldPath, QString newPath, qint64 bytesSaved);
+
+private slots:
+    void tick();
+
+private:
+    struct Job { qint64 id = 0; QString path; QString subPath; };
+
+    bool nextJob(Job* job);
+    bool processJob(const Job& job);
+    bool transcode(const QString& in, const QString& out, QString* err);
+    bool swapFile(const Job& job, const QString& newPath, int quality,
+                  const QString& consumedSubPath = QString());
+    bool inWindow() const;
+    bool loadTooHigh(double ownLoad) const;
+
+    DbWriter*    db_;
+    QString      dbPath_;
+    QString      spoolDir_;
+    QSqlDatabase ro_;
+    Policy       policy_;
+    QSet<qint64> failed_;           // skipped until restart
+    bool         noTool_ = false;   // ffmpeg could not be started
+    QTimer*      timer_ = nullptr;
+    std::atomic<bool> stop_{false};
+    std::atomic<bool> suspended_{false};
+};
@@ -0,0 +1,183 @@
+#include "archive_verifier.h"
+#include "archive_cipher.h"
+#include "archive_io.h"
+#include "db_writer.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QFuture>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QTimer>
+#include <QVariant>
+#include <QVector>
+#include <QtConcurrent>
+#include <QDebug>
+#include <memory>
+
+static const int kBatch       = 32;
+static const int kIdleMs      = 10 * 60 * 1000;   // nothing to do: look again later
+static const int kPoolThreads = 2;
+
+using mkvprobe::VerifyReport;
+
+ArchiveVerifier::ArchiveVerifier(DbWriter* db, const QString& dbPath, QObject* parent)
+    : QObject(parent), db_(db), dbPath_(dbPath) {
+    pool_.setMaxThreadCount(kPoolThreads);
+}
+
+ArchiveVerifier::~ArchiveVerifier() {
+    pool_.waitForDone();
+    archiveio::closeReadOnly(&ro_);
+}
+
+void ArchiveVerifier::setRateLimit(qint64 bytesPerSec) {
+    budget_.setRate(bytesPerSec);
+}
+
+void ArchiveVerifier::start() {
+    if (!archiveio::openReadOnly(&ro_, "camvigil_verify", dbPath_, "[Verify]")) return;
+    timer_ = new QTimer(this);
+    timer_->setSingleShot(true);
+    connect(timer_, &QTimer::timeout, this, &ArchiveVerifier::runBatch);
+    timer_->start(60 * 1000);   // let startup recovery and recording settle first
+}
+
+void ArchiveVerifier::runBatch() {
+    struct Job { qint64 id; QString path; };
+    QVector<Job> jobs;
+    {
+        // newest first: recent footage is what gets pulled after an incident
+        QSqlQuery q(ro_);
+        q.setForwardOnly(true);
+        q.prepare("SELECT id, file_path FROM segments"
+                  " WHERE status=1 AND COALESCE(health,0)=0"
+                  " ORDER BY id DESC LIMIT ?;");
+        q.addBindValue(kBatch);
+        if (!q.exec()) {
+            qWarning() << "[Verify] query:" << q.lastError().text();
+            timer_->start(kIdleMs);
+            return;
+        }
+        while (q.next()) jobs.push_back({ q.value(0).toLongLong(), q.value(1).toString() });
+    }
+
+    QVector<QFuture<VerifyReport>> results;
+    results.reserve(jobs.size());
+    for (const Job& j : jobs)
+        results.push_back(QtConcurrent::run(&pool_, &ArchiveVerifier::check, j.path, &budget_));
+
+    int bad = 0;
+    for (int i = 0; i < jobs.size(); ++i) {
+        const VerifyReport r = results[i].result();
+        if (r.health != VerifyReport::Ok) {
+            ++bad;
+            qWarning() << "[Verify]" << jobs[i].path << "health" << r.health << r.detail;
+        }
+        QMetaObject::invokeMethod(db_, "setSegmentHealth", Qt::QueuedConnection,
+                                  Q_ARG(qint64, jobs[i].id), Q_ARG(QString, jobs[i].path),
+                                  Q_ARG(int, r.health), Q_ARG(QString, r.detail));
+        emit segmentChecked(jobs[i].path, r.health, r.detail);
+    }
+    if (!jobs.isEmpty())
+        qInfo() << "[Verify] checked" << jobs.size() << "segments," << bad << "with problems";
+
+    // full batch → probably more backlog; the budget already paces us
+    timer_->start(jobs.size() == kBatch ? 0 : kIdleMs);
+}
+
+// Runs on a pool thread.
+VerifyReport ArchiveVerifier::check(const QString& path, IoBudget* budget) {
+    QThread::currentThread()->setPriority(QThread::IdlePriority);
+    const auto throttle = [budget](qint64 bytes){ budget->consume(bytes); };
+    VerifyReport r;
+
+    if (path.endsWith(".mkv")) {
+        mkvprobe::verify(path, &r, throttle);
+        return r;
+    }
+
+    if (!QFile::exists(path)) { r.health = VerifyReport::Missing; r.detail = "file missing"; return r; }
+    std::unique_ptr<QIODevice> dev(ArchiveCipher::openForRead(path));
+    if (!dev) { r.health = VerifyReport::Corrupt; r.detail = "cannot open"; return r; }
+    QIODevice& f = *dev;
+    const qint64 size = f.size();
+
+    if (path.endsWith(".ts")) {
+        // every 188-byte packet starts with the 0x47 sync byte
+        static const qint64 kPacket = 188, kChunk = kPacket * 2048;
+        qint64 pos = 0;
+        while (pos < size) {
+            const QByteArray chunk = f.read(kChunk);
+            throttle(chunk.size());
+            if (chunk.isEmpty()) break;
+            for (int i = 0; i + kPacket <= chunk.size(); i += kPacket) {
+                if (uchar(chunk[i]) != 0x47) {
+                    r.health = VerifyReport::Corrupt;
+                    r.detail = QString("lost sync at %1").arg(pos + i);
+                    return r;
+                }
+            }
+            pos += chunk.size();
+        }
+        r.health = (size % kPacket) ? VerifyReport::Damaged : VerifyReport::Ok;
+        if (size % kPacket) r.detail = "truncated packet at end";
+        return r;
+    }
+
+    // fragmented MP4: top-level boxes (ftyp, moov, moof/mdat...) must tile the file
+    qint64 pos = 0;
+    bool sawMoov = false;
+    while (pos + 8 <= size) {
+        f.seek(pos);
+        const QByteArray h = f.read(16);
+        throttle(h.size());
+        const uchar* p = reinterpret_cast<const uchar*>(h.constData());
+        qint64 boxSize = (qint64(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        const QByteArray type = h.mid(4, 4);
+        if (boxSize == 1 && h.size() >= 16) {
+            boxSize = 0;
+            for (int i = 8; i < 16; ++i) boxSize = (boxSize << 8) | p[i];
+        } else if (boxSize == 0) {
+            boxSize = size - pos;                   // "to end of file"
+        }
+        if (boxSize < 8) {
+            r.health = VerifyReport::Corrupt;
+            r.detail = QString("bad box size at %1").arg(pos);
+            return r;
+        }
+        if (type == "moov") sawMoov = true;
+        if (type == "moof") ++r.clusters;
+        if (pos + boxSize > size) {
+            r.health = VerifyReport::Damaged;
+            r.detail = "truncated (last fragment incomplete)";
+            return r;
+        }
+        pos += boxSize;
+    }
+    if (!sawMoov) { r.health = VerifyReport::Corrupt; r.detail = "no moov box"; return r; }
+    r.health = (pos == size) ? VerifyReport::Ok : VerifyReport::Damaged;
+    if (pos != size) r.detail = "trailing bytes";
+    return r;
+}
+
+void ArchiveVerifier::IoBudget::setRate(qint64 bytesPerSec) {
+    QMutexLocker lk(&mutex_);
+    rateBps_ = qMax<qint64>(64 * 1024, bytesPerSec);
+}
+
+void ArchiveVerifier::IoBudget::consume(qint64 bytes) {
+    qint64 aheadMs = 0;
+    {
+        QMutexLocker lk(&mutex_);
+        if (!clock_.isValid()) clock_.start();
+        consumed_ += bytes;
+        aheadMs = consumed_ * 1000 / rateBps_ - clock_.elapsed();
+        if (aheadMs < -1000) {          // been idle: don't bank credit for a burst
+            clock_.restart();
+            consumed_ = bytes;
+            aheadMs = 0;
+        }
+    }
+    if (aheadMs > 0) QThread::msleep(static_cast<unsigned long>(aheadMs));
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <QObject>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QSqlDatabase>
+#include <QString>
+#include <QThreadPool>
+#include "mkv_probe.h"
+
+class DbWriter;
+class QTimer;
+
+/**
+ * ArchiveVerifier
+ * ---------------
+ * Background integrity check of finalized segments. Lives on its own
+ * idle-priority thread (owner does moveToThread, then invokes start()).
+ *
+ * Picks unchecked rows (status=1, health=0) in batches through its own
+ * read-only connection, verifies files on a small private thread pool and
+ * reports each result through DbWriter::setSegmentHealth. All reads share
+ * one byte budget (default 8 MB/s) so recording and migration keep the disk.
+ *
+ * health: 1 ok, 2 damaged but playable (truncated / timestamp gap),
+ *         3 corrupt, 4 file missing.
+ */
+class ArchiveVerifier : public QObject {
+    Q_OBJECT
+public:
+    ArchiveVerifier(DbWriter* db, const QString& dbPath, QObject* parent = nullptr);
+    ~ArchiveVerifier();
+
+public slots:
+    void start();
+    void setRateLimit(qint64 bytesPerSec);
+
+signals:
+    void segmentChecked(QString path, int health, QString detail);
+
+private slots:
+    void runBatch();
+
+private:
+    // Token bucket shared by the pool threads.
+    class IoBudget {
+    public:
+        void setRate(qint64 bytesPerSec);
+        void consume(qint64 bytes);
+    private:
+        QMutex        mutex_;
+        QElapsedTimer clock_;
+        qint64        rateBps_ = 8LL * 1024 * 1024;
+        qint64        consumed_ = 0;
+    };
+
+    static mkvprobe::VerifyReport check(const QString& path, IoBudget* budget);
+
+    DbWriter*    db_;
+    QString      dbPath_;
+    QSqlDatabase ro_;
+    QThreadPool  pool_;
+    IoBudget     budget_;
+    QTimer*      timer_ = nullptr;
+};
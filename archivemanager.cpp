@@ -3,268 +3,388 @@
 #include <QDateTime>
 #include <QFile>
 #include <QDebug>
-#include <QStorageInfo>
 #include <QFileInfo>
-#include <QRegExp>
-#include <libudev.h>
-
-#include <QDBusArgument>
-#include <QDBusConnection>
-#include <QDBusInterface>
-#include <QDBusMessage>
-#include <QVariant>
-#include <QVariantList>
-#include <QDBusMetaType>   // For qDBusRegisterMetaType<...>()
-
 #include "db_writer.h"
+#include "archive_compactor.h"
+#include "archive_migrator.h"
+#include "archive_transcoder.h"
+#include "archive_verifier.h"
 #include <QUuid>
+#include <QStandardPaths>
+#include <QSaveFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPointer>
+#include <algorithm>
 
 
 
 ArchiveManager::ArchiveManager(QObject *parent)
     : QObject(parent),
-      defaultDuration(300),  // 5-minute default
-      m_udev(nullptr),
-      m_udevMonitor(nullptr),
-      m_socketNotifier(nullptr)
+      defaultDuration(300)  // 5-minute default
 {
-    m_udev = udev_new();
-    if (!m_udev) {
-        qWarning() << "[ArchiveManager] Cannot create udev";
-    } else {
-        m_udevMonitor = udev_monitor_new_from_netlink(m_udev, "udev");
-        if (!m_udevMonitor) {
-            qWarning() << "[ArchiveManager] Cannot create udev monitor";
-            udev_unref(m_udev);
-            m_udev = nullptr;
-        } else {
-            udev_monitor_filter_add_match_subsystem_devtype(m_udevMonitor, "block", nullptr);
-            udev_monitor_enable_receiving(m_udevMonitor);
-            int fd = udev_monitor_get_fd(m_udevMonitor);
-            m_socketNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
-            connect(m_socketNotifier, &QSocketNotifier::activated,
-                    this, &ArchiveManager::handleUdevEvent);
-            qDebug() << "[ArchiveManager] Udev monitor setup complete.";
-        }
-    }
+    // Recording always lands here first; ArchiveMigrator moves closed segments out.
+    spoolDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)
+               + "/CamVigilSpool";
+    QDir().mkpath(spoolDir);
+
+    // Removable media detection (udev + automount D-Bus) runs off the GUI thread.
+    monitorThread = new QThread(this);
+    storageMonitor = new StorageMonitor();
+    storageMonitor->moveToThread(monitorThread);
+    connect(monitorThread, &QThread::finished, storageMonitor, &QObject::deleteLater);
+    connect(storageMonitor, &StorageMonitor::mediaChanged, this,
+            [this](const StorageState& st){ setArchiveTarget(st.mountRoot); });
+    connect(storageMonitor, &StorageMonitor::capacityChanged,
+            this, &ArchiveManager::storageChanged);
+    monitorThread->start();
+    QMetaObject::invokeMethod(storageMonitor, "setSpoolDir", Qt::QueuedConnection, Q_ARG(QString, spoolDir));
+    QMetaObject::invokeMethod(storageMonitor, "start", Qt::BlockingQueuedConnection);
+    const QString externalPath = findExternalStoragePath();
+    if (!externalPath.isEmpty()) archiveDir = externalPath + "/CamVigilArchives";
+
     connect(&cleanupTimer, &QTimer::timeout, this, &ArchiveManager::cleanupArchive);
     cleanupTimer.start(60 * 60 * 1000);  // every hour
+    connect(&telemetryTimer, &QTimer::timeout, this, &ArchiveManager::sampleTelemetry);
+    connect(&watchdogTimer, &QTimer::timeout, this, &ArchiveManager::checkWorkers);
+    connect(&degradeTimer, &QTimer::timeout, this, &ArchiveManager::updateDegradation);
     qDebug() << "[ArchiveManager] Initialized.";
-
-    qDBusRegisterMetaType<QVariantList>();
-    qDBusRegisterMetaType<QList<QVariantList>>();
-
-    QDBusInterface automountIface(
-        "com.idonial.automount",         // service name
-        "/com/idonial/automount",        // object path
-        "com.idonial.automount",         // interface name
-        QDBusConnection::systemBus(),
-        this
-    );
-
-    // Connecting to “Mounted(QString, QString)”
-    bool okMount = QDBusConnection::systemBus().connect(
-        "com.idonial.automount",
-        "/com/idonial/automount",
-        "com.idonial.automount",
-        "Mounted",
-        this,
-        SLOT(onUsbMounted(QString,QString))
-    );
-    qDebug() << "[ArchiveManager] automount-core Mounted subscription successful?" << okMount;
-
-    // Connecting to “Unmounted(QString, QString)”
-    bool okUnmount = QDBusConnection::systemBus().connect(
-        "com.idonial.automount",
-        "/com/idonial/automount",
-        "com.idonial.automount",
-        "Unmounted",
-        this,
-        SLOT(onUsbUnmounted(QString,QString))
-    );
-    qDebug() << "[ArchiveManager] automount-core Unmounted subscription successful?" << okUnmount;
 }
 ArchiveManager::~ArchiveManager()
 {
     stopRecording();
-    if (m_socketNotifier) {
-        m_socketNotifier->setEnabled(false);
-        delete m_socketNotifier;
+    if (monitorThread) {
+        monitorThread->quit();
+        monitorThread->wait();
+        monitorThread = nullptr;
     }
-    if (m_udevMonitor) {
-        udev_monitor_unref(m_udevMonitor);
+    // stop background jobs before the DB they write to
+    if (compactorThread) {
+        compactor->requestStop();
+        compactorThread->quit();
+        compactorThread->wait();
+        compactorThread = nullptr;
     }
-    if (m_udev) {
-        udev_unref(m_udev);
+    if (transcoderThread) {
+        transcoder->requestStop();      // kills a running ffmpeg
+        transcoderThread->quit();
+        transcoderThread->wait();
+        transcoderThread = nullptr;
+    }
+    if (verifierThread) {
+        verifierThread->quit();
+        verifierThread->wait();
+        verifierThread = nullptr;
+    }
+    if (migratorThread) {
+        migratorThread->quit();
+        migratorThread->wait();
+        migratorThread = nullptr;
     }
     // stop DB thread
-        if (dbThread) {
-            dbThread->quit();
-            dbThread->wait();
-            dbThread = nullptr;
-        }
+    if (dbThread) {
+        dbThread->quit();
+        dbThread->wait();
+        dbThread = nullptr;
+    }
     qDebug() << "[ArchiveManager] Destroyed.";
 }
 
-void ArchiveManager::handleUdevEvent()
+QString ArchiveManager::findExternalStoragePath()
 {
-    m_socketNotifier->setEnabled(false);
-    struct udev_device *dev = udev_monitor_receive_device(m_udevMonitor);
-    if (dev) {
-        const char *action = udev_device_get_action(dev);
-        const char *devnode = udev_device_get_devnode(dev);
-        const char *subsystem = udev_device_get_subsystem(dev);
-        qDebug() << "[ArchiveManager] Udev event:"
-                 << (action ? action : "unknown")
-                 << (devnode ? devnode : "unknown")
-                 << (subsystem ? subsystem : "unknown");
-
-        QString externalPath = findExternalStoragePath();
-        if (!externalPath.isEmpty()) {
-            if (workers.empty()) {
-                qDebug() << "[ArchiveManager] External storage detected, starting recording.";
-                archiveDir = externalPath + "/CamVigilArchives";
-                QDir dir(archiveDir);
-                if (!dir.exists()) {
-                    dir.mkpath(".");
-                }
-                startRecording(cameraProfiles);
-            }
-        } else {
-            if (!workers.empty()) {
-                qDebug() << "[ArchiveManager] External storage removed, stopping recording.";
-                stopRecording();
-            }
-        }
-        udev_device_unref(dev);
-    }
-    m_socketNotifier->setEnabled(true);
+    return storageMonitor ? storageMonitor->state().mountRoot : QString();
+}
+
+StorageState ArchiveManager::storageState() const
+{
+    return storageMonitor ? storageMonitor->state() : StorageState();
 }
 
-static bool isKernelRemovable(const QStorageInfo &storage)
+void ArchiveManager::startRecording(const std::vector<CamHWProfile> &camProfiles)
 {
-    QString devicePath = QString::fromUtf8(storage.device());
-    QString devFileName = QFileInfo(devicePath).fileName();
-    devFileName.remove(QRegExp("\\d+$"));
-    QString sysRemovablePath = QString("/sys/block/%1/removable").arg(devFileName);
-    QFile removableFile(sysRemovablePath);
-    if (!removableFile.open(QIODevice::ReadOnly)) {
-        return false;
+    cameraProfiles = camProfiles;
+    if (!workers.empty()) return;
+    ensureDb();
+    if (archiveDir.isEmpty()) {
+        qDebug() << "[ArchiveManager] No external storage yet; recording to spool" << spoolDir;
+    }
+    // ensure cameras
+    for (const auto& p : camProfiles) {
+        QMetaObject::invokeMethod(db, "ensureCamera", Qt::QueuedConnection,
+            Q_ARG(QString, QString::fromStdString(p.url)),
+            Q_ARG(QString, QString::fromStdString(p.suburl)),
+            Q_ARG(QString, QString::fromStdString(p.displayName)));
     }
-    QByteArray content = removableFile.readAll().trimmed();
-    return (content == "1");
+    // session
+    sessionId = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    QMetaObject::invokeMethod(db, "beginSession", Qt::QueuedConnection,
+        Q_ARG(QString, sessionId), Q_ARG(QString, spoolDir), Q_ARG(int, defaultDuration));
+
+    masterStart = QDateTime::currentDateTime();
+    qDebug() << "[ArchiveManager] Master start time:" << masterStart.toString("yyyyMMdd_HHmmss");
+    workers.assign(camProfiles.size(), nullptr);
+    watch.assign(camProfiles.size(), CameraWatch());
+    prevSnapshots.assign(camProfiles.size(), RecordingStats::Snapshot());
+    updateDegradation();    // start already degraded if the disk is full
+    for (size_t i = 0; i < camProfiles.size(); ++i) {
+        const int phase = splitPhaseSec(i, camProfiles.size(), defaultDuration);
+        watch[i].splitAnchorMs = masterStart.toMSecsSinceEpoch() + (defaultDuration + phase) * 1000LL;
+        spawnWorker(i, phase);
+    }
+    telemetryClock.start();
+    telemetryTimer.start(1000);
+    watchdogTimer.start(kWatchdogTickMs);
+    degradeTimer.start(kDegradeTickMs);
 }
 
-QString ArchiveManager::findExternalStoragePath()
+void ArchiveManager::spawnWorker(size_t i, int phaseSec)
 {
-    QList<QStorageInfo> storages = QStorageInfo::mountedVolumes();
-    for (const QStorageInfo &storage : storages) {
-        if (storage.isValid() && storage.isReady() && !storage.isReadOnly()) {
-            QString rootPath = storage.rootPath();
-            if ((rootPath.startsWith("/media") || rootPath.startsWith("/run/media"))
-                && isKernelRemovable(storage))
-            {
-                return rootPath;
-            }
+    const auto &profile = cameraProfiles[i];
+    const bool useSub = watch[i].quality >= 1 && !profile.suburl.empty();
+    // The low-res copy is a full-quality extra; dropped as soon as we degrade.
+    const bool alsoSub = profile.recordSub && watch[i].quality == 0;
+    ArchiveWorker* worker = new ArchiveWorker(
+        useSub ? profile.suburl : profile.url,
+        static_cast<int>(i),
+        spoolDir,
+        defaultDuration,
+        masterStart,
+        profile.container,
+        phaseSec,
+        alsoSub ? profile.suburl : std::string()
+    );
+    // emitted on the worker thread; the DB call is queued from there
+    connect(worker, &ArchiveWorker::recordingError,
+            [db = db, url = QString::fromStdString(profile.url)](const std::string &err){
+        qDebug() << "[ArchiveManager] ArchiveWorker error:" << QString::fromStdString(err);
+        QMetaObject::invokeMethod(db, "logEvent", Qt::QueuedConnection,
+                                  Q_ARG(int, int(EventKind::StreamError)), Q_ARG(QString, url),
+                                  Q_ARG(qint64, 0), Q_ARG(QString, QString("archiveworker")),
+                                  Q_ARG(QString, QString::fromStdString(err)));
+    });
+    // segment → DB
+    // ----------------------
+    connect(worker, &ArchiveWorker::segmentOpened, this,
+                    [this](int camIdx, const QString& path, qint64 startNs,
+                           qint64 startPtsNs, const QString& timeSource, int quality){
+                        const QString camUrl = QString::fromStdString(cameraProfiles[camIdx].url);
+                        QMetaObject::invokeMethod(db, "addSegmentOpened", Qt::QueuedConnection,
+                            Q_ARG(QString, sessionId), Q_ARG(QString, camUrl),
+                            Q_ARG(QString, path), Q_ARG(qint64, startNs),
+                            Q_ARG(qint64, startPtsNs), Q_ARG(QString, timeSource),
+                            Q_ARG(int, quality));
+                    });
+    connect(worker, &ArchiveWorker::subSegmentOpened, this,
+                    [this](int camIdx, const QString& path, qint64 startNs, qint64 startPtsNs,
+                           const QString& timeSource, const QString& mainPath){
+                        const QString camUrl = QString::fromStdString(cameraProfiles[camIdx].url);
+                        QMetaObject::invokeMethod(db, "addSubSegmentOpened", Qt::QueuedConnection,
+                            Q_ARG(QString, sessionId), Q_ARG(QString, camUrl),
+                            Q_ARG(QString, path), Q_ARG(qint64, startNs),
+                            Q_ARG(qint64, startPtsNs), Q_ARG(QString, timeSource),
+                            Q_ARG(QString, mainPath));
+                    });
+    // ----------------------
+    connect(worker, &ArchiveWorker::segmentClosed, this,
+                    [this](int camIdx, const QString& path, qint64 endNs, qint64 durMs){
+                        Q_UNUSED(camIdx);
+                        QMetaObject::invokeMethod(db, "finalizeSegmentByPath", Qt::QueuedConnection,
+                            Q_ARG(QString, path), Q_ARG(qint64, endNs), Q_ARG(qint64, durMs));
+                    });
+    connect(worker, &ArchiveWorker::segmentHashed, this,
+                    [this](int camIdx, const QString& path, const QByteArray& sha256){
+                        Q_UNUSED(camIdx);
+                        QMetaObject::invokeMethod(db, "setSegmentHash", Qt::QueuedConnection,
+                            Q_ARG(QString, path), Q_ARG(QByteArray, sha256));
+                    });
+    // ----------------------
+    connect(worker, &ArchiveWorker::segmentFileReady, migrator, &ArchiveMigrator::enqueue);
+    connect(worker, &ArchiveWorker::segmentFinalized, this, &ArchiveManager::segmentWritten);
+    worker->setQuality(watch[i].quality);
+    workers[i] = worker;
+    prevSnapshots[i] = RecordingStats::Snapshot();
+    watch[i].startedAt.start();
+    watch[i].restartDue = false;
+    worker->start();
+    qDebug() << "[ArchiveManager] Started ArchiveWorker for cam" << i;
+}
+
+// Every few seconds: a worker whose thread exited (GStreamer error) or that
+// hasn't pushed a byte into splitmuxsink for kStallMs is torn down and
+// respawned after an exponential backoff. Other cameras are not touched.
+void ArchiveManager::checkWorkers()
+{
+    const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    for (size_t i = 0; i < workers.size(); ++i) {
+        CameraWatch& w = watch[i];
+        ArchiveWorker* worker = workers[i];
+
+        if (!worker) {
+            if (w.restartDue && w.backoff.hasExpired(w.backoffMs)) spawnWorker(i, restartPhaseSec(i));
+            continue;
         }
+
+        const qint64 lastData = worker->lastDataMs();
+        const qint64 idleMs = lastData > 0 ? nowMs - lastData : w.startedAt.elapsed();
+        QString reason;
+        if (worker->isFinished())   reason = "pipeline stopped";
+        else if (idleMs > kStallMs) reason = QString("no data for %1 s").arg(idleMs / 1000);
+
+        if (reason.isEmpty()) {
+            // healthy for a while → forget earlier failures
+            if (w.backoffMs > kBackoffMinMs && w.startedAt.elapsed() > kBackoffResetMs)
+                w.backoffMs = kBackoffMinMs;
+            continue;
+        }
+
+        ++w.restarts;
+        qWarning() << "[ArchiveManager] Watchdog: cam" << i << reason
+                   << "- restart #" << w.restarts << "in" << w.backoffMs << "ms";
+        QMetaObject::invokeMethod(db, "logEvent", Qt::QueuedConnection,
+                                  Q_ARG(int, int(EventKind::StreamRestart)),
+                                  Q_ARG(QString, QString::fromStdString(cameraProfiles[i].url)),
+                                  Q_ARG(qint64, 0), Q_ARG(QString, QString("watchdog cam%1").arg(i)),
+                                  Q_ARG(QString, QString("%1 - restart #%2").arg(reason).arg(w.restarts)));
+        retireWorker(worker);
+        workers[i] = nullptr;
+        w.restartDue = true;
+        w.backoff.start();
+        w.backoffMs = qMin(w.backoffMs * 2, kBackoffMaxMs);
     }
-    return "";
 }
 
-void ArchiveManager::startRecording(const std::vector<CamHWProfile> &camProfiles)
+// Free-space stage, lowest of spool and archive:
+//   0 > 5 %, 1 ≤ 5 %, 2 ≤ 2.5 %, 3 ≤ 1 %   (stepping back down needs +1 %)
+// Each camera records at level clamp(stage - priority, 0, 2):
+//   0 main stream, 1 substream, 2 keyframes only.
+// Cameras without a substream go straight from 0 to keyframes only.
+void ArchiveManager::updateDegradation()
 {
-    cameraProfiles = camProfiles;
-    QString externalPath = findExternalStoragePath();
-    if (externalPath.isEmpty()) {
-        qDebug() << "[ArchiveManager] No external storage detected. Recording not started.";
-        return;
-    }
-    archiveDir = externalPath + "/CamVigilArchives";
-    QDir dir(archiveDir);
-    if (!dir.exists()) {
-        dir.mkpath(".");
+    static const double kStageFreePct[] = { 100.0, 5.0, 2.5, 1.0 };
+
+    double freePct = 100.0;
+    const StorageState st = storageState();     // cached by StorageMonitor
+    if (st.spoolBytesTotal > 0)
+        freePct = 100.0 * st.spoolBytesAvailable / st.spoolBytesTotal;
+    if (st.isPresent() && st.bytesTotal > 0 && !loopRecording_)   // loop mode reuses slots
+        freePct = qMin(freePct, 100.0 * st.bytesAvailable / st.bytesTotal);
+    // spool cap: the migrator drops the oldest queued files at 0%
+    if (spoolCapBytes_ > 0)
+        freePct = qMin(freePct, 100.0 * qMax<qint64>(0, spoolCapBytes_ - spoolQueuedBytes_) / spoolCapBytes_);
+
+    int stage = 0;
+    for (int s = 3; s >= 1; --s) {
+        if (freePct <= kStageFreePct[s]) { stage = s; break; }
     }
-    // ---- DB bring-up ----
-        if (!dbThread) {
-            dbThread = new QThread(this);
-            db = new DbWriter();
-            db->moveToThread(dbThread);
-            connect(dbThread, &QThread::finished, db, &QObject::deleteLater);
-            dbThread->start();
-            QMetaObject::invokeMethod(db, "openAt", Qt::BlockingQueuedConnection,
-                                      Q_ARG(QString, archiveDir + "/camvigil.sqlite"));
-        }
-        // ensure cameras
-        for (const auto& p : camProfiles) {
-            QMetaObject::invokeMethod(db, "ensureCamera", Qt::QueuedConnection,
-                Q_ARG(QString, QString::fromStdString(p.url)),
-                Q_ARG(QString, QString::fromStdString(p.suburl)),
-                Q_ARG(QString, QString::fromStdString(p.displayName)));
+    // hysteresis: only step down once there is real headroom again
+    while (stage < degradeStage && freePct <= kStageFreePct[degradeStage] + 1.0)
+        stage = degradeStage;
+    if (stage != degradeStage)
+        qWarning() << "[ArchiveManager] Free space" << freePct << "% → degrade stage" << stage;
+    degradeStage = stage;
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+        const auto& profile = cameraProfiles[i];
+        int level = qBound(0, degradeStage - profile.priority, 2);
+        if (level == 1 && profile.suburl.empty()) level = 0;
+
+        CameraWatch& w = watch[i];
+        if (level == w.quality) continue;
+        const bool urlChanges = !profile.suburl.empty() && ((level >= 1) != (w.quality >= 1));
+        qDebug() << "[ArchiveManager] cam" << i << "quality" << w.quality << "->" << level;
+        w.quality = level;
+        if (!workers[i]) continue;              // applied on (re)spawn
+        if (urlChanges) {
+            retireWorker(workers[i]);
+            workers[i] = nullptr;
+            spawnWorker(i, restartPhaseSec(i));
+        } else {
+            workers[i]->setQuality(level);
         }
-        // session
-        sessionId = QUuid::createUuid().toString(QUuid::WithoutBraces);
-        QMetaObject::invokeMethod(db, "beginSession", Qt::QueuedConnection,
-            Q_ARG(QString, sessionId), Q_ARG(QString, archiveDir), Q_ARG(int, defaultDuration));
-        // ----------------------
+    }
+}
 
-    QDateTime masterStart = QDateTime::currentDateTime();
-    qDebug() << "[ArchiveManager] Master start time:" << masterStart.toString("yyyyMMdd_HHmmss");
-    for (size_t i = 0; i < camProfiles.size(); ++i) {
-        const auto &profile = camProfiles[i];
-        ArchiveWorker* worker = new ArchiveWorker(
-            profile.url,
-            static_cast<int>(i),
-            archiveDir,
-            defaultDuration,
-            masterStart
-        );
-        connect(worker, &ArchiveWorker::recordingError, [](const std::string &err){
-            qDebug() << "[ArchiveManager] ArchiveWorker error:" << QString::fromStdString(err);
-        });
-        // segment → DB
-        // ----------------------
-        connect(worker, &ArchiveWorker::segmentOpened, this,
-                        [this, camProfiles](int camIdx, const QString& path, qint64 startNs){
-                            const QString camUrl = QString::fromStdString(camProfiles[camIdx].url);
-                            QMetaObject::invokeMethod(db, "addSegmentOpened", Qt::QueuedConnection,
-                                Q_ARG(QString, sessionId), Q_ARG(QString, camUrl),
-                                Q_ARG(QString, path), Q_ARG(qint64, startNs));
-                        });
-        // ----------------------
-        connect(worker, &ArchiveWorker::segmentClosed, this,
-                        [this, camProfiles](int camIdx, const QString& path, qint64 endNs, qint64 durMs){
-                            Q_UNUSED(camIdx);
-                            QMetaObject::invokeMethod(db, "finalizeSegmentByPath", Qt::QueuedConnection,
-                                Q_ARG(QString, path), Q_ARG(qint64, endNs), Q_ARG(qint64, durMs));
-                        });
-        // ----------------------
-        connect(worker, &ArchiveWorker::segmentFinalized, this, &ArchiveManager::segmentWritten);
-        workers.push_back(worker);
-        worker->start();
-        qDebug() << "[ArchiveManager] Started ArchiveWorker for cam" << i;
+// Stop without blocking the GUI thread; rtspsrc teardown of a dead camera
+// can take seconds. The worker closes its open segment on the way out.
+void ArchiveManager::retireWorker(ArchiveWorker* worker)
+{
+    retiringWorkers.push_back(worker);
+    QPointer<ArchiveWorker> guard(worker);
+    connect(worker, &QThread::finished, this, [this, guard]{
+        if (!guard) return;
+        retiringWorkers.erase(std::remove(retiringWorkers.begin(), retiringWorkers.end(),
+                                          guard.data()), retiringWorkers.end());
+        guard->deleteLater();
+    });
+    worker->stop();
+    if (worker->isFinished()) {   // already exited; finished() won't fire again
+        retiringWorkers.pop_back();
+        worker->deleteLater();
     }
 }
 
 void ArchiveManager::stopRecording()
 {
+    telemetryTimer.stop();
+    watchdogTimer.stop();
+    degradeTimer.stop();
+    telemetry_ = RecordingTelemetry();
     for (auto worker : workers) {
+        if (!worker) continue;
         worker->stop();
         worker->wait();
         delete worker;
     }
     workers.clear();
+    for (auto worker : retiringWorkers) {
+        disconnect(worker, nullptr, this, nullptr);
+        worker->wait();
+        delete worker;
+    }
+    retiringWorkers.clear();
     qDebug() << "[ArchiveManager] All ArchiveWorkers stopped.";
 }
 
 void ArchiveManager::updateSegmentDuration(int seconds)
 {
     qDebug() << "[ArchiveManager] Initiating segment duration update to" << seconds << "seconds.";
-    for (auto *worker : workers) {
-        QMetaObject::invokeMethod(worker, "updateSegmentDuration", Qt::QueuedConnection,
-                                  Q_ARG(int, seconds));
+    defaultDuration = seconds;
+    // Cut one camera at a time instead of finalizing every file in the same
+    // second, and subtract the delay from the phase so the new boundaries are
+    // still evenly spread.
+    const size_t n = workers.size();
+    for (size_t i = 0; i < n; ++i) {
+        const int delayMs = static_cast<int>(i) * kSplitSpacingMs;
+        const int phase = qMax(0, splitPhaseSec(i, n, seconds) - delayMs / 1000);
+        if (i < watch.size())
+            watch[i].splitAnchorMs = QDateTime::currentMSecsSinceEpoch() + delayMs + (seconds + phase) * 1000LL;
+        ArchiveWorker* worker = workers[i];
+        if (!worker) continue;   // waiting for a watchdog restart; picks up defaultDuration
+        QTimer::singleShot(delayMs, worker, [worker, seconds, phase]{
+            QMetaObject::invokeMethod(worker, "updateSegmentDuration", Qt::QueuedConnection,
+                                      Q_ARG(int, seconds), Q_ARG(int, phase));
+        });
     }
 }
 
+// Camera i of n splits at i/n of the period.
+int ArchiveManager::splitPhaseSec(size_t camIndex, size_t camCount, int periodSec)
+{
+    if (camCount < 2) return 0;
+    return static_cast<int>(camIndex * static_cast<size_t>(periodSec) / camCount);
+}
+
+// A respawned worker keeps its camera's stagger: its first segment runs
+// over until the next split on that camera's schedule.
+int ArchiveManager::restartPhaseSec(size_t camIndex) const
+{
+    const qint64 anchorMs = camIndex < watch.size() ? watch[camIndex].splitAnchorMs : 0;
+    if (anchorMs <= 0 || defaultDuration <= 0) return 0;
+    const qint64 toAnchorSec = (anchorMs - QDateTime::currentMSecsSinceEpoch()) / 1000;
+    return static_cast<int>(((toAnchorSec % defaultDuration) + defaultDuration) % defaultDuration);
+}
+
 void ArchiveManager::cleanupArchive()
 {
     if (archiveDir.isEmpty()) {
@@ -279,26 +399,206 @@ void ArchiveManager::cleanupArchive()
     qDebug() << "[ArchiveManager] Cleanup complete.";
 }
 
-void ArchiveManager::onUsbMounted(const QString &device, const QString &path)
+void ArchiveManager::ensureDb()
 {
-    qDebug() << "[ArchiveManager] USB mounted:" << device << "→" << path;
-    // Creates “CamVigilArchives” subfolder under that mount
-    archiveDir = path + "/CamVigilArchives";
-    QDir dir(archiveDir);
-    if (!dir.exists()) dir.mkpath(".");
+    if (dbThread) return;
+    dbThread = new QThread(this);
+    db = new DbWriter();
+    db->moveToThread(dbThread);
+    connect(dbThread, &QThread::finished, db, &QObject::deleteLater);
+    qRegisterMetaType<ArchiveSummary>("ArchiveSummary");
+    connect(db, &DbWriter::archiveSummary, this, [this](const ArchiveSummary& cams){
+        archiveSummary_ = cams;
+        emit archiveSummaryChanged();
+    });
+    dbThread->start();
+    QMetaObject::invokeMethod(db, "openAt", Qt::BlockingQueuedConnection,
+                              Q_ARG(QString, spoolDir + "/camvigil.sqlite"));
+    // finalize rows left open by a previous crash before new ones are added
+    QMetaObject::invokeMethod(db, "recoverOpenSegments", Qt::QueuedConnection);
+    refreshArchiveSummary();
+
+    migratorThread = new QThread(this);
+    migrator = new ArchiveMigrator(db);
+    migrator->moveToThread(migratorThread);
+    connect(migratorThread, &QThread::finished, migrator, &QObject::deleteLater);
+    migratorThread->start(QThread::LowPriority);
+    connect(migrator, &ArchiveMigrator::loopPoolChanged, this, &ArchiveManager::applyLoopRecording);
+    connect(migrator, &ArchiveMigrator::spoolUsage, this, [this](qint64 queued, qint64 cap){
+        spoolQueuedBytes_ = queued;
+        spoolCapBytes_ = cap;
+    });
+    QMetaObject::invokeMethod(migrator, "setSpool", Qt::QueuedConnection,
+                              Q_ARG(QString, spoolDir), Q_ARG(qint64, qint64(0)));
+    // blocking: the scan must finish before workers create new spool files
+    QMetaObject::invokeMethod(migrator, "enqueueExisting", Qt::BlockingQueuedConnection,
+                              Q_ARG(QString, spoolDir));
+    setArchiveTarget(findExternalStoragePath());
+
+    verifierThread = new QThread(this);
+    verifier = new ArchiveVerifier(db, spoolDir + "/camvigil.sqlite");
+    verifier->moveToThread(verifierThread);
+    connect(verifierThread, &QThread::finished, verifier, &QObject::deleteLater);
+    verifierThread->start(QThread::IdlePriority);
+    QMetaObject::invokeMethod(verifier, "start", Qt::QueuedConnection);
+
+    transcoderThread = new QThread(this);
+    transcoder = new ArchiveTranscoder(db, spoolDir + "/camvigil.sqlite", spoolDir);
+    transcoder->moveToThread(transcoderThread);
+    connect(transcoderThread, &QThread::finished, transcoder, &QObject::deleteLater);
+    transcoderThread->start(QThread::IdlePriority);
+    transcoder->setSuspended(loopRecording_);
+    QMetaObject::invokeMethod(transcoder, "start", Qt::QueuedConnection);
+
+    compactorThread = new QThread(this);
+    compactor = new ArchiveCompactor(db, spoolDir + "/camvigil.sqlite", spoolDir);
+    compactor->moveToThread(compactorThread);
+    connect(compactorThread, &QThread::finished, compactor, &QObject::deleteLater);
+    compactorThread->start(QThread::IdlePriority);
+    compactor->setSuspended(loopRecording_);
+    QMetaObject::invokeMethod(compactor, "start", Qt::QueuedConnection);
+}
 
-    // Start recording if not already started
-    if (workers.empty()) {
-        startRecording(cameraProfiles);
-        qDebug() << "[ArchiveManager] Recording started in" << archiveDir;
+void ArchiveManager::setArchiveTarget(const QString& mountRoot)
+{
+    // directory is created by the migrator on first copy (keeps I/O off this thread)
+    const QString target = mountRoot.isEmpty() ? QString() : mountRoot + "/CamVigilArchives";
+    const QString previous = archiveDir;
+    if (target != archiveDir)
+        qDebug() << "[ArchiveManager] Archive target:" << (target.isEmpty() ? QString("<none>") : target);
+    archiveDir = target;
+    if (!migrator) return;
+    if (target != previous) {
+        const bool mounted = !target.isEmpty();
+        QMetaObject::invokeMethod(db, "logEvent", Qt::QueuedConnection,
+                                  Q_ARG(int, int(mounted ? EventKind::StorageMounted
+                                                         : EventKind::StorageUnmounted)),
+                                  Q_ARG(QString, QString()), Q_ARG(qint64, 0),
+                                  Q_ARG(QString, QString("storage")),
+                                  Q_ARG(QString, mounted ? target : previous));
+    }
+    if (!target.isEmpty()) {
+        // rows recorded straight to the stick by older builds
+        QMetaObject::invokeMethod(db, "importArchiveDb", Qt::QueuedConnection,
+                                  Q_ARG(QString, target));
     }
+    QMetaObject::invokeMethod(migrator, "setTarget", Qt::QueuedConnection,
+                              Q_ARG(QString, target));
 }
 
-void ArchiveManager::onUsbUnmounted(const QString &device, const QString &path)
+void ArchiveManager::setLoopRecording(bool on)
 {
-    qDebug() << "[ArchiveManager] USB unmounted:" << device << "→" << path;
-    if (!workers.empty()) {
-        stopRecording();
-        qDebug() << "[ArchiveManager] Recording stopped.";
+    if (!migrator || archiveDir.isEmpty()) {
+        qWarning() << "[ArchiveManager] Loop recording needs removable media while recording";
+        emit storageChanged();   // let the UI fall back to the real state
+        return;
     }
+    int slots = 0;
+    qint64 slotBytes = 0;
+    if (on) {
+        // a slot holds one segment of the busiest camera, plus a quarter
+        double peak = 0;
+        for (const CameraTelemetry& c : telemetry_.cameras) peak = qMax(peak, c.bytesPerSec);
+        if (peak <= 0) peak = 1024.0 * 1024.0;
+        const qint64 mib = 1024 * 1024;
+        slotBytes = (qint64(peak * defaultDuration * 5 / 4) + mib - 1) / mib * mib;
+        const StorageState st = storageState();
+        slots = st.bytesTotal > 0 ? int(st.bytesTotal * 9 / 10 / slotBytes) : 0;
+        if (slots < 2) {
+            qWarning() << "[ArchiveManager] Medium too small for loop recording";
+            emit storageChanged();
+            return;
+        }
+    }
+    QMetaObject::invokeMethod(migrator, "setLoopPool", Qt::QueuedConnection,
+                              Q_ARG(int, slots), Q_ARG(qint64, slotBytes));
+}
+
+// Files are reused in place, so neither rewriting nor merging them applies,
+// and the medium's free space no longer says anything about headroom.
+void ArchiveManager::applyLoopRecording(bool on)
+{
+    if (transcoder) transcoder->setSuspended(on);
+    if (compactor)  compactor->setSuspended(on);
+    if (on == loopRecording_) return;
+    loopRecording_ = on;
+    qInfo() << "[ArchiveManager] Loop recording" << (on ? "on" : "off");
+    emit storageChanged();
+}
+
+void ArchiveManager::sampleTelemetry()
+{
+    const double dt = telemetryClock.restart() / 1000.0;
+    if (dt <= 0 || workers.size() != prevSnapshots.size()) return;
+
+    RecordingTelemetry t;
+    qint64 written = 0;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        CameraTelemetry c;
+        c.camIndex = static_cast<int>(i);
+        c.restarts = watch[i].restarts;
+        c.quality  = watch[i].quality;
+        if (workers[i]) {   // null while waiting for a watchdog restart
+            const RecordingStats::Snapshot s = workers[i]->recordingStats()->snapshot();
+            const RecordingStats::Snapshot& p = prevSnapshots[i];
+            c.bytesPerSec  = (s.bytesIn - p.bytesIn) / dt;
+            c.framesPerSec = (s.framesIn - p.framesIn) / dt;
+            c.p50Ms = s.p50Ms; c.p95Ms = s.p95Ms; c.p99Ms = s.p99Ms;
+            written += s.bytesWritten - p.bytesWritten;
+            prevSnapshots[i] = s;
+        }
+        t.cameras.push_back(c);
+    }
+
+    // Smooth the aggregate so the projection doesn't jump with every I-frame.
+    const double rate = written / dt;
+    t.totalBytesPerSec = telemetry_.totalBytesPerSec > 0
+                         ? 0.8 * telemetry_.totalBytesPerSec + 0.2 * rate
+                         : rate;
+
+    // removable and spool capacity both come from the monitor's cache
+    const StorageState st = storageState();
+    t.bytesFree = st.isPresent() ? st.bytesAvailable : st.spoolBytesAvailable;
+    if (t.bytesFree >= 0 && t.totalBytesPerSec > 0 && !(st.isPresent() && loopRecording_))
+        t.hoursUntilFull = t.bytesFree / t.totalBytesPerSec / 3600.0;
+    telemetry_ = t;
+    emit telemetryUpdated();
+
+    if (++telemetryTicks % 5 == 0) writeTelemetryFile();
+    if (telemetryTicks % 60 == 0) refreshArchiveSummary();
+}
+
+void ArchiveManager::refreshArchiveSummary()
+{
+    if (db) QMetaObject::invokeMethod(db, "summarizeArchive", Qt::QueuedConnection);
+}
+
+// <spool>/recording_stats.json, for scripts and remote monitoring.
+void ArchiveManager::writeTelemetryFile() const
+{
+    QJsonArray cams;
+    for (const CameraTelemetry& c : telemetry_.cameras) {
+        QJsonObject o;
+        o["camera"]         = c.camIndex;
+        o["bytes_per_sec"]  = c.bytesPerSec;
+        o["frames_per_sec"] = c.framesPerSec;
+        o["latency_p50_ms"] = c.p50Ms;
+        o["latency_p95_ms"] = c.p95Ms;
+        o["latency_p99_ms"] = c.p99Ms;
+        o["restarts"]       = c.restarts;
+        o["quality"]        = c.quality;
+        cams.append(o);
+    }
+    QJsonObject root;
+    root["timestamp_utc_ms"]      = QDateTime::currentMSecsSinceEpoch();
+    root["archive_dir"]           = archiveDir;
+    root["total_bytes_per_sec"]   = telemetry_.totalBytesPerSec;
+    root["bytes_free"]            = telemetry_.bytesFree;
+    root["hours_until_full"]      = telemetry_.hoursUntilFull;
+    root["cameras"]               = cams;
+
+    QSaveFile f(spoolDir + "/recording_stats.json");
+    if (!f.open(QIODevice::WriteOnly)) return;
+    f.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
+    f.commit();
 }
@@ -2,25 +2,47 @@
 #define ARCHIVEMANAGER_H
 
 #include <QObject>
-#include <QDBusConnection>
-#include <QDBusInterface>
 #include <QTimer>
-#include <QSocketNotifier>
+#include <QElapsedTimer>
+#include <QVector>
 #include <vector>
 #include <string>
 #include "archiveworker.h"
 #include "camerastreams.h" // for CamHWProfile
-#include <libudev.h>
+#include "db_writer.h"       // for ArchiveSummary
+#include "storage_monitor.h"
 
 
 class DbWriter;
+class ArchiveCompactor;
+class ArchiveMigrator;
+class ArchiveTranscoder;
+class ArchiveVerifier;
+
+// One-second view of what the recorders are doing (see ArchiveManager::telemetry()).
+struct CameraTelemetry {
+    int    camIndex = 0;
+    double bytesPerSec = 0;      // into the muxer
+    double framesPerSec = 0;
+    qint64 p50Ms = -1, p95Ms = -1, p99Ms = -1;   // muxer-in → file write latency
+    int    restarts = 0;         // watchdog restarts since recording started
+    int    quality = 0;          // 0 full, 1 substream, 2 keyframes only
+};
+struct RecordingTelemetry {
+    QVector<CameraTelemetry> cameras;
+    double totalBytesPerSec = 0; // written to disk, smoothed
+    qint64 bytesFree = -1;       // on the archive (or spool if no media)
+    double hoursUntilFull = -1;  // -1 = unknown / not recording
+};
 class ArchiveManager : public QObject {
     Q_OBJECT
 public:
     explicit ArchiveManager(QObject* parent = nullptr);
     ~ArchiveManager();
 
-    QString archiveRoot() const { return archiveDir; }  // exposing archive root so we can find the db
+    // Directory holding camvigil.sqlite. Always the internal spool, so the DB
+    // (and recording) survive removable media being swapped.
+    QString archiveRoot() const { return spoolDir; }
 
     // Start recording for each camera profile.
     void startRecording(const std::vector<CamHWProfile>& cameraProfiles);
@@ -29,10 +51,25 @@ public:
     // Update the segment duration (in seconds) for future recordings.
     void updateSegmentDuration(int seconds);
 
-    // Return the current archive directory.
+    // Return the current archive directory (removable media; empty if none).
     QString getArchiveDir() const { return archiveDir; }
-    // Check and return the external storage path.
+    // Internal directory segments are recorded into before migration.
+    QString getSpoolDir() const { return spoolDir; }
+    // Latest telemetry sample; refreshed every second while recording.
+    const RecordingTelemetry& telemetry() const { return telemetry_; }
+    // Mount root of the removable medium (cached by StorageMonitor; no I/O).
     QString findExternalStoragePath();
+    StorageState storageState() const;
+    // Loop recording on the removable medium: a fixed pool of preallocated
+    // segment files, the oldest reused for each new one (see ArchiveMigrator).
+    // Slot size from the current bitrate and segment duration.
+    void setLoopRecording(bool on);
+    bool loopRecording() const { return loopRecording_; }
+    // Recorded days/bytes per camera (day_summary), as of the last refresh.
+    // Refreshed every minute while recording, or on request (asynchronous,
+    // archiveSummaryChanged follows).
+    const ArchiveSummary& archiveSummary() const { return archiveSummary_; }
+    void refreshArchiveSummary();
 
 public slots:
     void cleanupArchive();
@@ -40,30 +77,84 @@ public slots:
 signals:
     // Emitted when a segment is finalized.
     void segmentWritten();
+    void telemetryUpdated();
+    // Removable media capacity/presence changed (from StorageMonitor's cache).
+    void storageChanged();
+    void archiveSummaryChanged();
 
 private slots:
-    void handleUdevEvent();
-    void onUsbMounted(const QString &device, const QString &path);
-    void onUsbUnmounted(const QString &device, const QString &path);
+    void sampleTelemetry();
+    void checkWorkers();
+    void updateDegradation();
+    void applyLoopRecording(bool on);
 
 private:
     QTimer cleanupTimer;
-    std::vector<ArchiveWorker*> workers;
+    std::vector<ArchiveWorker*> workers;          // by camera index; null while awaiting restart
+    std::vector<ArchiveWorker*> retiringWorkers;  // stopped, thread still winding down
+    QDateTime masterStart;
     QString archiveDir;
+    QString spoolDir;
     int defaultDuration;  // in seconds
 
-    // Udev integration members.
-    struct udev* m_udev;
-    struct udev_monitor* m_udevMonitor;
-    QSocketNotifier* m_socketNotifier;
+    QThread* monitorThread = nullptr;
+    StorageMonitor* storageMonitor = nullptr;
 
     // Cache camera profiles for restarting recording when storage is inserted.
     std::vector<CamHWProfile> cameraProfiles;
 
-    void setupUdevMonitor();
+    static int splitPhaseSec(size_t camIndex, size_t camCount, int periodSec);
+    int restartPhaseSec(size_t camIndex) const;
+    static const int kSplitSpacingMs = 1500;   // between split-now calls on a duration change
+    void ensureDb();
+    void spawnWorker(size_t camIndex, int phaseSec);
+    void retireWorker(ArchiveWorker* worker);
+
+    // Watchdog (see checkWorkers)
+    struct CameraWatch {
+        QElapsedTimer startedAt;
+        QElapsedTimer backoff;
+        qint64 backoffMs = 2000;
+        bool restartDue = false;
+        int restarts = 0;
+        int quality = 0;         // 0 full, 1 substream, 2 keyframes only
+        qint64 splitAnchorMs = 0; // epoch ms of one of this camera's staggered splits
+    };
+    std::vector<CameraWatch> watch;
+    QTimer watchdogTimer;
+    static const int    kWatchdogTickMs = 2000;
+    static const qint64 kStallMs        = 15000;
+    static const qint64 kBackoffMinMs   = 2000;
+    static const qint64 kBackoffMaxMs   = 60000;
+    static const qint64 kBackoffResetMs = 5 * 60 * 1000;
+
+    // Degraded recording near full disk (see updateDegradation)
+    QTimer degradeTimer;
+    int degradeStage = 0;
+    static const int kDegradeTickMs = 10000;
+    void setArchiveTarget(const QString& mountRoot);
     QThread* dbThread = nullptr;
     DbWriter* db = nullptr;
+    QThread* migratorThread = nullptr;
+    ArchiveMigrator* migrator = nullptr;
+    QThread* verifierThread = nullptr;
+    ArchiveVerifier* verifier = nullptr;
+    QThread* compactorThread = nullptr;
+    ArchiveCompactor* compactor = nullptr;
+    QThread* transcoderThread = nullptr;
+    ArchiveTranscoder* transcoder = nullptr;
+    bool loopRecording_ = false;   // as last reported by the migrator
+    qint64 spoolQueuedBytes_ = 0;  // ArchiveMigrator::spoolUsage
+    qint64 spoolCapBytes_ = 0;
     QString sessionId;
+
+    QTimer telemetryTimer;
+    QElapsedTimer telemetryClock;
+    std::vector<RecordingStats::Snapshot> prevSnapshots;
+    int telemetryTicks = 0;
+    RecordingTelemetry telemetry_;
+    ArchiveSummary archiveSummary_;
+    void writeTelemetryFile() const;
 };
 
 #endif // ARCHIVEMANAGER_H
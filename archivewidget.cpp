@@ -5,6 +5,9 @@
 #include <QLabel>
 #include <QDebug>
 #include <QDir>
+#include <QDirIterator>
+#include <algorithm>
+#include <QFile>
 #include <QFileInfoList>
 #include <QRegularExpression>
 #include <QScrollBar>
@@ -204,7 +207,7 @@ void ArchiveWidget::refreshBackupDates() {
 QString ArchiveWidget::formatFileName(const QString &rawFileName,
                                       const QString &absolutePath)
 {
-    QRegularExpression re(R"(archive_cam(\d+)_(\d{8})_(\d{6})\.mkv)");
+    QRegularExpression re(R"(archive_cam(\d+)_(\d{8})_(\d{6})(_h)?(_lr)?\.(mkv|mp4|ts))");
     QRegularExpressionMatch match = re.match(rawFileName);
     if (!match.hasMatch()) {
         return rawFileName;
@@ -238,7 +241,7 @@ QString ArchiveWidget::formatFileName(const QString &rawFileName,
 }
 
 QString ArchiveWidget::formatFileName(const QString &rawFileName, double durationSeconds) {
-    QRegularExpression re(R"(archive_cam(\d+)_(\d{8})_(\d{6})\.mkv)");
+    QRegularExpression re(R"(archive_cam(\d+)_(\d{8})_(\d{6})(_h)?(_lr)?\.(mkv|mp4|ts))");
     QRegularExpressionMatch match = re.match(rawFileName);
     if (!match.hasMatch()) {
         return rawFileName;
@@ -322,7 +325,10 @@ void ArchiveWidget::showThumbnail(QListWidgetItem *item) {
 }
 
 void ArchiveWidget::generateThumbnail(const QString &videoPath) {
-    cv::VideoCapture cap(videoPath.toStdString());
+    // Same picture from the substream copy, if recorded, at a fraction of the decode cost
+    const QFileInfo fi(videoPath);
+    const QString subPath = fi.dir().filePath(fi.completeBaseName() + "_sub." + fi.suffix());
+    cv::VideoCapture cap((QFile::exists(subPath) ? subPath : videoPath).toStdString());
     if (!cap.isOpened()) {
         thumbnailLabel->setText("Failed to open video.");
         return;
@@ -353,10 +359,19 @@ void ArchiveWidget::openVideoPlayer(QListWidgetItem *item) {
 }
 QList<VideoMetadata> ArchiveWidget::extractVideoMetadata(const QString& archiveDirPath) {
     QList<VideoMetadata> list;
-    QDir dir(archiveDirPath);
-    QFileInfoList fileList = dir.entryInfoList(QStringList() << "*.mkv", QDir::Files, QDir::Time);
+    // camN/YYYY/MM/DD/ shards (plus anything still flat from older builds)
+    QFileInfoList fileList;
+    QDirIterator it(archiveDirPath, QStringList() << "*.mkv" << "*.mp4" << "*.ts",
+                    QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        fileList << it.fileInfo();
+    }
+    std::sort(fileList.begin(), fileList.end(), [](const QFileInfo& a, const QFileInfo& b) {
+        return a.lastModified() > b.lastModified();
+    });
 
-    QRegularExpression regex("archive_cam(\\d+)_(\\d{8})_(\\d{6})\\.mkv");
+    QRegularExpression regex("archive_cam(\\d+)_(\\d{8})_(\\d{6})(_h)?(_lr)?\\.(mkv|mp4|ts)");
 
     for (const QFileInfo &fileInfo : fileList) {
         const QString fileName = fileInfo.fileName();
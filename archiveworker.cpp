@@ -4,12 +4,17 @@
 #include <QThread>
 #include <QMutexLocker>
 #include <gst/gst.h>
+#include "archive_sink_tap.h"
+#include "sched_policy.h"
 
 ArchiveWorker::ArchiveWorker(const std::string& url,
                              int camIndex,
                              const QString& archDir,
                              int defaultDur,
-                             const QDateTime& mStart)
+                             const QDateTime& mStart,
+                             const std::string& cont,
+                             int phaseSec,
+                             const std::string& sub)
     : cameraUrl(url),
       cameraIndex(camIndex),
       archiveDir(archDir),
@@ -17,11 +22,16 @@ ArchiveWorker::ArchiveWorker(const std::string& url,
       segmentDurationSec(defaultDur),
       pendingDurationUpdate(false),
       nextSegmentDuration(defaultDur),
+      nextSplitPhase(0),
+      splitPhaseSec(phaseSec),
       masterStart(mStart),
+      container(cont),
+      subUrl(sub),
       pipeline(nullptr)
 {
     qDebug() << "[ArchiveWorker] Created for cam" << cameraIndex
-             << "with masterStart:" << masterStart.toString("yyyyMMdd_HHmmss");
+             << "with masterStart:" << masterStart.toString("yyyyMMdd_HHmmss")
+             << (subUrl.empty() ? "" : "(+ substream)");
 }
 
 QString ArchiveWorker::generateSegmentPrefix() const {
@@ -29,9 +39,18 @@ QString ArchiveWorker::generateSegmentPrefix() const {
     return QString("archive_cam%1_%2").arg(cameraIndex).arg(timestamp);
 }
 
+QString ArchiveWorker::fileExtension() const {
+    if (container == "mp4") return "mp4";
+    if (container == "ts")  return "ts";
+    return "mkv";
+}
+
 void ArchiveWorker::createPipeline() {
     gst_init(nullptr, nullptr);
-    qint64 maxSizeTimeNs = static_cast<qint64>(segmentDurationSec.load()) * 1000000000LL;
+    // First fragment carries this camera's phase offset; later ones are
+    // one period long, so boundaries stay spread across cameras.
+    qint64 maxSizeTimeNs = static_cast<qint64>(segmentDurationSec.load() + splitPhaseSec.load())
+                           * 1000000000LL;
 
     // 1) Create pipeline and elements
     pipeline = gst_pipeline_new(nullptr);
@@ -50,14 +69,42 @@ void ArchiveWorker::createPipeline() {
                  "location", cameraUrl.c_str(),
                  "latency", 300,
                  nullptr);
+    // NTP wall-clock from RTCP SR on every buffer (GStreamer >= 1.22)
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(src), "add-reference-timestamp-meta"))
+        g_object_set(src, "add-reference-timestamp-meta", TRUE, nullptr);
+    else
+        qDebug() << "[ArchiveWorker] rtspsrc without reference timestamps; using local clock for cam"
+                 << cameraIndex;
+    {
+        QMutexLocker lk(&clockMutex);
+        clockAnchor = ClockAnchor();    // PTS restart from 0 with every pipeline
+    }
+
+    // Container: MKV (default) loses its index when cut short; fragmented MP4
+    // and MPEG-TS stay readable up to the last fragment/packet without repair.
+    const char* muxerFactory = "matroskamux";
+    GstStructure* muxerProps = nullptr;
+    if (container == "mp4") {
+        muxerFactory = "mp4mux";
+        muxerProps = gst_structure_new("properties",
+                                       "fragment-duration", G_TYPE_UINT, 1000u, // ms
+                                       nullptr);
+    } else if (container == "ts") {
+        muxerFactory = "mpegtsmux";
+        g_object_set(parse, "config-interval", -1, nullptr); // SPS/PPS with every IDR
+    }
 
     g_object_set(split,
                  "name",            "split",
                  "send-keyframe-requests", TRUE,
                  "max-size-time",     maxSizeTimeNs,
                  "async-finalize",    TRUE,
-                 "muxer-factory",    "matroskamux",
+                 "muxer-factory",    muxerFactory,
                  nullptr);
+    if (muxerProps) {
+        g_object_set(split, "muxer-properties", muxerProps, nullptr);
+        gst_structure_free(muxerProps);
+    }
 
     // 3) Add to pipeline
     gst_bin_add_many(GST_BIN(pipeline), src, depay, parse, split, nullptr);
@@ -71,16 +118,28 @@ void ArchiveWorker::createPipeline() {
         return;
     }
 
+    // Track the camera's PTS → wall-clock mapping
+    if (GstPad* depaySrc = gst_element_get_static_pad(depay, "src")) {
+        gst_pad_add_probe(depaySrc, GST_PAD_PROBE_TYPE_BUFFER,
+                          &ArchiveWorker::onClockProbe, this, nullptr);
+        gst_object_unref(depaySrc);
+    }
+
+    // Count what enters the muxer (throughput / latency telemetry)
+    if (GstPad* parseSrc = gst_element_get_static_pad(parse, "src")) {
+        gst_pad_add_probe(parseSrc, GST_PAD_PROBE_TYPE_BUFFER,
+                          &ArchiveWorker::onIngressProbe, this, nullptr);
+        gst_object_unref(parseSrc);
+    }
+
     // 5) Handle dynamic pad from rtspsrc → depay
-    g_signal_connect(src, "pad-added",
-                     G_CALLBACK(+[](GstElement* src, GstPad* pad, gpointer user_data){
-        GstElement* depay = static_cast<GstElement*>(user_data);
-        GstPad* sinkpad = gst_element_get_static_pad(depay, "sink");
-        if (gst_pad_is_linked(sinkpad) == FALSE) {
-            gst_pad_link(pad, sinkpad);
-        }
-        gst_object_unref(sinkpad);
-    }), depay);
+    g_signal_connect(src, "pad-added", G_CALLBACK(ArchiveWorker::onPadAdded), depay);
+
+    // Optional low-resolution copy next to the main recording
+    if (!subUrl.empty() && !createSubBranch(muxerFactory)) {
+        qWarning() << "[ArchiveWorker] Substream branch unavailable for cam" << cameraIndex
+                   << "; recording main stream only";
+    }
 
     // 6) Bus watch
     GstBus* bus = gst_element_get_bus(pipeline);
@@ -88,6 +147,7 @@ void ArchiveWorker::createPipeline() {
     g_signal_connect(bus, "message",
                      G_CALLBACK(ArchiveWorker::onBusMessage), this);
     gst_object_unref(bus);
+    SchedPolicy::applyToStreamingThreads(pipeline, SchedClass::Recording);
 
     // 7) Connect the format-location-full signal on our splitmuxsink
     g_signal_connect(split,
@@ -97,10 +157,113 @@ void ArchiveWorker::createPipeline() {
     qDebug() << "[ArchiveWorker] Connected format-location-full on splitmuxsink for cam"
              << cameraIndex;
 
+    // 8) Tap every per-segment file sink (keyframe index sidecar, write stats)
+    g_signal_connect(split, "sink-added",
+                     G_CALLBACK(ArchiveWorker::onSinkAdded), this);
+
     qDebug() << "[ArchiveWorker] Pipeline created successfully for cam"
              << cameraIndex;
 }
 
+// Second rtspsrc → depay → parse → splitmuxsink on the substream. It has no
+// time limit of its own: the main branch splits it (splitSub) whenever a main
+// segment starts, so every sub file pairs with one main file.
+bool ArchiveWorker::createSubBranch(const char* muxerFactory) {
+    GstElement* src   = gst_element_factory_make("rtspsrc",      "sub_source");
+    GstElement* depay = gst_element_factory_make("rtph264depay", "sub_depay");
+    GstElement* parse = gst_element_factory_make("h264parse",    "sub_parse");
+    GstElement* split = gst_element_factory_make("splitmuxsink", "split_sub");
+    if (!src || !depay || !parse || !split) {
+        for (GstElement* e : { src, depay, parse, split })
+            if (e) gst_object_unref(e);
+        return false;
+    }
+
+    g_object_set(src,
+                 "location", subUrl.c_str(),
+                 "latency", 300,
+                 nullptr);
+    if (container == "ts")
+        g_object_set(parse, "config-interval", -1, nullptr);
+    g_object_set(split,
+                 "max-size-time",  static_cast<guint64>(0),
+                 "async-finalize", TRUE,
+                 "muxer-factory",  muxerFactory,
+                 nullptr);
+    if (container == "mp4") {
+        GstStructure* props = gst_structure_new("properties",
+                                                "fragment-duration", G_TYPE_UINT, 1000u,
+                                                nullptr);
+        g_object_set(split, "muxer-properties", props, nullptr);
+        gst_structure_free(props);
+    }
+
+    gst_bin_add_many(GST_BIN(pipeline), src, depay, parse, split, nullptr);
+    if (!gst_element_link_many(depay, parse, split, nullptr)) {
+        gst_bin_remove_many(GST_BIN(pipeline), src, depay, parse, split, nullptr);
+        return false;
+    }
+    subBranch_[0] = src;
+    subBranch_[1] = depay;
+    subBranch_[2] = parse;
+    subBranch_[3] = split;
+    g_signal_connect(src, "pad-added", G_CALLBACK(ArchiveWorker::onPadAdded), depay);
+    g_signal_connect(split, "format-location-full",
+                     G_CALLBACK(ArchiveWorker::formatLocationSubCallback), this);
+    g_signal_connect(split, "sink-added",
+                     G_CALLBACK(ArchiveWorker::onSinkAdded), this);
+    return true;
+}
+
+void ArchiveWorker::onPadAdded(GstElement* src, GstPad* pad, gpointer user_data) {
+    Q_UNUSED(src);
+    GstElement* depay = static_cast<GstElement*>(user_data);
+    GstPad* sinkpad = gst_element_get_static_pad(depay, "sink");
+    if (gst_pad_is_linked(sinkpad) == FALSE) {
+        gst_pad_link(pad, sinkpad);
+    }
+    gst_object_unref(sinkpad);
+}
+
+// obj, or one of its ancestors (rtspsrc's udpsrc, splitmuxsink's muxer/sink),
+// is an element of the substream branch.
+bool ArchiveWorker::isSubBranch(GstObject* obj) const {
+    GstObject* o = obj ? GST_OBJECT(gst_object_ref(obj)) : nullptr;
+    while (o) {
+        for (GstElement* e : subBranch_) {
+            if (e && o == GST_OBJECT_CAST(e)) {
+                gst_object_unref(o);
+                return true;
+            }
+        }
+        GstObject* parent = gst_object_get_parent(o);
+        gst_object_unref(o);
+        o = parent;
+    }
+    return false;
+}
+
+// Take a failed substream branch out of the pipeline so it neither holds up
+// the EOS on stop() nor keeps erroring. True if the main branch is still
+// playing (or on its way there) afterwards.
+bool ArchiveWorker::dropSubBranch() {
+    if (!pipeline) return false;
+    if (!subDropped_) {
+        subDropped_ = true;
+        for (GstElement* e : subBranch_) {
+            if (!e) continue;
+            gst_object_ref(e);          // late messages from it stay attributable
+            gst_element_set_locked_state(e, TRUE);
+            gst_element_set_state(e, GST_STATE_NULL);
+            gst_bin_remove(GST_BIN(pipeline), e);
+        }
+        closeOpenSegment(true);
+    }
+    GstState cur = GST_STATE_NULL, pending = GST_STATE_VOID_PENDING;
+    gst_element_get_state(pipeline, &cur, &pending, 0);
+    return cur == GST_STATE_PLAYING || pending == GST_STATE_PLAYING;
+}
+
 
 
 void ArchiveWorker::cleanupPipeline() {
@@ -109,9 +272,15 @@ void ArchiveWorker::cleanupPipeline() {
         gst_object_unref(pipeline);
         pipeline = nullptr;
     }
+    for (GstElement*& e : subBranch_) {
+        if (e && subDropped_) gst_object_unref(e);
+        e = nullptr;
+    }
+    subDropped_ = false;
 }
 
 void ArchiveWorker::run() {
+    SchedPolicy::applyToCurrentThread(SchedClass::Recording);
     createPipeline();
     if (!pipeline) {
         qDebug() << "[ArchiveWorker] Pipeline creation failed for cam" << cameraIndex << ". Exiting.";
@@ -126,8 +295,9 @@ void ArchiveWorker::run() {
         return;
     }
 
+    // running starts true in the ctor; re-arming it here would swallow a
+    // stop() that arrived while the pipeline was still starting up.
     qDebug() << "[ArchiveWorker] Pipeline running for cam" << cameraIndex;
-    running.store(true);
 
     GMainLoop *loop = g_main_loop_new(nullptr, FALSE);
     while (running.load()) {
@@ -137,9 +307,30 @@ void ArchiveWorker::run() {
     }
     g_main_loop_unref(loop);
     cleanupPipeline();
+    closeOpenSegment();
     qDebug() << "[ArchiveWorker] Pipeline stopped for cam" << cameraIndex;
 }
 
+// Pipeline torn down without a processed EOS (error, stall, fast stop): the
+// file holds whatever reached the disk. Close its DB row at the last data
+// time so the gap is visible and the segment still gets migrated.
+void ArchiveWorker::closeOpenSegment(bool subOnly) {
+    QMutexLocker lk(&curMutex);
+    const qint64 lastMs = lastDataMs_.load();
+    auto close = [&](QString& path, QDateTime& startUtc) {
+        if (path.isEmpty() || !startUtc.isValid()) return;
+        const qint64 startMs = startUtc.toMSecsSinceEpoch();
+        const qint64 endMs = qMax(lastMs, startMs);
+        qDebug() << "[ArchiveWorker] Closing open segment for cam" << cameraIndex << ":" << path;
+        emit segmentClosed(cameraIndex, path, endMs * 1000000LL, endMs - startMs);
+        emit segmentFileReady(cameraIndex, path);
+        path.clear();
+        startUtc = QDateTime();
+    };
+    if (!subOnly) close(currentFilePath, currentStartTimeUtc);
+    close(currentSubPath, currentSubStartUtc);
+}
+
 void ArchiveWorker::stop() {
     running.store(false);
     if (pipeline) {
@@ -148,9 +339,11 @@ void ArchiveWorker::stop() {
     qDebug() << "[ArchiveWorker] Stop called for cam" << cameraIndex;
 }
 
-void ArchiveWorker::updateSegmentDuration(int seconds) {
-    qDebug() << "[ArchiveWorker] Segment duration update scheduled for cam" << cameraIndex << "to" << seconds << "seconds.";
+void ArchiveWorker::updateSegmentDuration(int seconds, int phaseSec) {
+    qDebug() << "[ArchiveWorker] Segment duration update scheduled for cam" << cameraIndex << "to" << seconds
+             << "seconds, phase" << phaseSec << "s.";
     nextSegmentDuration = seconds;
+    nextSplitPhase = phaseSec;
     pendingDurationUpdate.store(true);
     if (pipeline) {
         GstElement* sink = gst_bin_get_by_name(GST_BIN(pipeline), "split");
@@ -164,26 +357,26 @@ void ArchiveWorker::updateSegmentDuration(int seconds) {
     }
 }
 
+void ArchiveWorker::setQuality(int level) {
+    if (pendingQuality.exchange(level) == level) return;
+    qDebug() << "[ArchiveWorker] Quality for cam" << cameraIndex << "->" << level;
+    if (pipeline) {
+        // start a segment with the new quality so the DB label stays true
+        GstElement* sink = gst_bin_get_by_name(GST_BIN(pipeline), "split");
+        if (sink) {
+            g_signal_emit_by_name(sink, "split-now", NULL);
+            gst_object_unref(sink);
+        }
+    }
+}
+
 gchar* ArchiveWorker::formatLocationFullCallback(GstElement* splitmux, guint fragment_id, GstSample* sample, gpointer user_data) {
     Q_UNUSED(splitmux);
-    Q_UNUSED(fragment_id);
     ArchiveWorker* worker = static_cast<ArchiveWorker*>(user_data);
 
-    QDateTime segmentStartTime;
-    if (sample) {
-        GstBuffer* buffer = gst_sample_get_buffer(sample);
-        if (buffer && GST_BUFFER_PTS_IS_VALID(buffer)) {
-            GstClockTime pts = GST_BUFFER_PTS(buffer);
-            qint64 ptsMs = pts / 1000000;
-            segmentStartTime = worker->masterStart.addMSecs(ptsMs);
-            qDebug() << "[ArchiveWorker] PTS for cam" << worker->cameraIndex << ":" << pts << "ns (" << ptsMs << "ms)";
-        }
-    }
-
-    if (!segmentStartTime.isValid()) {
-        segmentStartTime = QDateTime::currentDateTime();
-        qDebug() << "[ArchiveWorker] No valid PTS for cam" << worker->cameraIndex << ", using system time";
-    }
+    qint64 startPtsNs = -1;
+    QString timeSource;
+    const QDateTime segmentStartTime = worker->segmentStartFor(sample, &startPtsNs, &timeSource);
 
     if (worker->lastSegmentTimestamp.isValid()) {
         qint64 diff = worker->lastSegmentTimestamp.msecsTo(segmentStartTime);
@@ -193,10 +386,11 @@ gchar* ArchiveWorker::formatLocationFullCallback(GstElement* splitmux, guint fra
     worker->lastSegmentTimestamp = segmentStartTime;
 
     QString timestamp = segmentStartTime.toString("yyyyMMdd_HHmmss");
-    QString filename = QString("%1/archive_cam%2_%3.mkv")
+    QString filename = QString("%1/archive_cam%2_%3.%4")
                            .arg(worker->archiveDir)
                            .arg(worker->cameraIndex)
-                           .arg(timestamp);
+                           .arg(timestamp)
+                           .arg(worker->fileExtension());
     qDebug() << "[ArchiveWorker] New segment:" << filename;
 
     // --- DB notifications: close previous, open new ---
@@ -215,17 +409,24 @@ gchar* ArchiveWorker::formatLocationFullCallback(GstElement* splitmux, guint fra
            // open new
            worker->currentFilePath = filename;
            worker->currentStartTimeUtc = segmentStartTime.toUTC();
+           // substream follows at its next keyframe
+           if (!worker->currentSubPath.isEmpty()) worker->splitSub();
        }
-       emit worker->segmentOpened(worker->cameraIndex, filename, startNs);
+       worker->quality.store(worker->pendingQuality.load());
+       emit worker->segmentOpened(worker->cameraIndex, filename, startNs, startPtsNs, timeSource,
+                                  worker->quality.load());
        // ---------------------------------------------------
+    if (fragment_id > 0) worker->splitAtUs.store(g_get_monotonic_time());
 
     // Apply pending duration update if flagged
     if (worker->pendingDurationUpdate.load()) {
-        qint64 maxSizeTimeNs = static_cast<qint64>(worker->nextSegmentDuration) * 1000000000LL;
+        qint64 maxSizeTimeNs =
+            static_cast<qint64>(worker->nextSegmentDuration + worker->nextSplitPhase) * 1000000000LL;
         GstElement* sink = gst_bin_get_by_name(GST_BIN(worker->pipeline), "split");
         if (sink) {
             g_object_set(sink, "max-size-time", maxSizeTimeNs, NULL);
             worker->segmentDurationSec.store(worker->nextSegmentDuration);
+            worker->splitPhaseSec.store(worker->nextSplitPhase);
             worker->pendingDurationUpdate.store(false);
             qDebug() << "[ArchiveWorker] Updated segment duration to" << worker->segmentDurationSec.load()
                      << "seconds for cam" << worker->cameraIndex;
@@ -233,6 +434,15 @@ gchar* ArchiveWorker::formatLocationFullCallback(GstElement* splitmux, guint fra
         } else {
             qDebug() << "[ArchiveWorker] Failed to update segment duration: splitmuxsink not found for cam" << worker->cameraIndex;
         }
+    } else if (fragment_id > 0 && worker->splitPhaseSec.load() > 0) {
+        // phase-shifted fragment is done; back to the plain period
+        qint64 maxSizeTimeNs = static_cast<qint64>(worker->segmentDurationSec.load()) * 1000000000LL;
+        GstElement* sink = gst_bin_get_by_name(GST_BIN(worker->pipeline), "split");
+        if (sink) {
+            g_object_set(sink, "max-size-time", maxSizeTimeNs, NULL);
+            worker->splitPhaseSec.store(0);
+            gst_object_unref(sink);
+        }
     }
 
     {
@@ -243,6 +453,134 @@ gchar* ArchiveWorker::formatLocationFullCallback(GstElement* splitmux, guint fra
 }
 
 
+gchar* ArchiveWorker::formatLocationSubCallback(GstElement* splitmux, guint fragment_id, GstSample* sample, gpointer user_data) {
+    Q_UNUSED(splitmux);
+    Q_UNUSED(fragment_id);
+    ArchiveWorker* worker = static_cast<ArchiveWorker*>(user_data);
+
+    qint64 startPtsNs = -1;
+    QString timeSource;
+    const QDateTime startTime = worker->segmentStartFor(sample, &startPtsNs, &timeSource);
+    const qint64 startNs = startTime.toUTC().toMSecsSinceEpoch() * 1000000LL;
+
+    QString mainPath, filename;
+    {
+        QMutexLocker lk(&worker->curMutex);
+        mainPath = worker->currentFilePath;
+        // Named after its main segment so the pair sorts together on disk;
+        // own start time only if the substream got going first.
+        const QString base = mainPath.isEmpty()
+            ? QString("%1/archive_cam%2_%3").arg(worker->archiveDir).arg(worker->cameraIndex)
+                                            .arg(startTime.toString("yyyyMMdd_HHmmss"))
+            : mainPath.left(mainPath.lastIndexOf('.'));
+        filename = base + "_sub." + worker->fileExtension();
+        if (!worker->currentSubPath.isEmpty() && worker->currentSubStartUtc.isValid()) {
+            const qint64 durMs = worker->currentSubStartUtc.msecsTo(startTime);
+            emit worker->segmentClosed(worker->cameraIndex, worker->currentSubPath,
+                                       worker->currentSubStartUtc.toMSecsSinceEpoch()*1000000LL
+                                           + durMs*1000000LL,
+                                       durMs);
+        }
+        worker->currentSubPath = filename;
+        worker->currentSubStartUtc = startTime.toUTC();
+    }
+    qDebug() << "[ArchiveWorker] New substream segment:" << filename << "for" << mainPath;
+    emit worker->subSegmentOpened(worker->cameraIndex, filename, startNs, startPtsNs, timeSource, mainPath);
+    return g_strdup(filename.toUtf8().constData());
+}
+
+// Both branches share the pipeline clock, so the main stream's PTS → wall
+// anchor applies to substream PTS as well.
+QDateTime ArchiveWorker::segmentStartFor(GstSample* sample, qint64* startPtsNs, QString* timeSource) {
+    QDateTime start;
+    *startPtsNs = -1;
+    *timeSource = "system";
+    if (sample) {
+        GstBuffer* buffer = gst_sample_get_buffer(sample);
+        if (buffer && GST_BUFFER_PTS_IS_VALID(buffer)) {
+            *startPtsNs = qint64(GST_BUFFER_PTS(buffer));
+            qint64 wallNs = 0;
+            if (wallClockFor(*startPtsNs, &wallNs, timeSource))
+                start = QDateTime::fromMSecsSinceEpoch(wallNs / 1000000);
+            qDebug() << "[ArchiveWorker] PTS for cam" << cameraIndex << ":" << *startPtsNs
+                     << "ns, wall" << start.toString("HH:mm:ss.zzz") << "(" << *timeSource << ")";
+        }
+    }
+    if (!start.isValid()) {
+        start = QDateTime::currentDateTime();
+        *timeSource = "system";
+        qDebug() << "[ArchiveWorker] No valid PTS for cam" << cameraIndex << ", using system time";
+    }
+    return start;
+}
+
+void ArchiveWorker::splitSub() {
+    if (!pipeline) return;
+    if (GstElement* sink = gst_bin_get_by_name(GST_BIN(pipeline), "split_sub")) {
+        g_signal_emit_by_name(sink, "split-now", NULL);
+        gst_object_unref(sink);
+    }
+}
+
+void ArchiveWorker::onSinkAdded(GstElement* splitmux, GstElement* sink, gpointer user_data) {
+    ArchiveWorker* worker = static_cast<ArchiveWorker*>(user_data);
+    // write stats describe the main recording only
+    const bool sub = worker->isSubBranch(GST_OBJECT(splitmux));
+    ArchiveSinkTap::attach(sink, sub ? nullptr : &worker->stats,
+                           [worker](const QString& path, const QByteArray& sha256, int rehashed) {
+                               if (rehashed > 0 && !worker->rehashWarned_.exchange(true))
+                                   qWarning() << "[ArchiveWorker] muxer patched" << rehashed
+                                              << "blocks behind the hash window for cam"
+                                              << worker->cameraIndex << "; re-read from disk, window now"
+                                              << SegmentHasher::window() / (1024 * 1024) << "MiB";
+                               emit worker->segmentHashed(worker->cameraIndex, path, sha256);
+                           });
+}
+
+GstPadProbeReturn ArchiveWorker::onClockProbe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    Q_UNUSED(pad);
+    static GstCaps* ntpCaps = gst_caps_from_string("timestamp/x-ntp");
+    static const qint64 kNtpToUnixNs = 2208988800LL * 1000000000LL;  // 1900 → 1970
+
+    ArchiveWorker* worker = static_cast<ArchiveWorker*>(user_data);
+    GstBuffer* buf = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (!GST_BUFFER_PTS_IS_VALID(buf)) return GST_PAD_PROBE_OK;
+    const qint64 pts = qint64(GST_BUFFER_PTS(buf));
+
+    GstReferenceTimestampMeta* meta = gst_buffer_get_reference_timestamp_meta(buf, ntpCaps);
+    QMutexLocker lk(&worker->clockMutex);
+    if (meta && GST_CLOCK_TIME_IS_VALID(meta->timestamp)) {
+        if (!worker->clockAnchor.ntp)
+            qDebug() << "[ArchiveWorker] NTP clock locked for cam" << worker->cameraIndex;
+        worker->clockAnchor = { pts, qint64(meta->timestamp) - kNtpToUnixNs, true };
+    } else if (worker->clockAnchor.ptsNs < 0) {
+        worker->clockAnchor = { pts, QDateTime::currentMSecsSinceEpoch() * 1000000LL, false };
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+bool ArchiveWorker::wallClockFor(qint64 ptsNs, qint64* wallNs, QString* source) {
+    QMutexLocker lk(&clockMutex);
+    if (clockAnchor.ptsNs < 0) return false;
+    *wallNs = clockAnchor.wallNs + (ptsNs - clockAnchor.ptsNs);
+    *source = clockAnchor.ntp ? "ntp" : "local";
+    return true;
+}
+
+GstPadProbeReturn ArchiveWorker::onIngressProbe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    Q_UNUSED(pad);
+    ArchiveWorker* worker = static_cast<ArchiveWorker*>(user_data);
+    GstBuffer* buf = GST_PAD_PROBE_INFO_BUFFER(info);
+    worker->lastDataMs_.store(QDateTime::currentMSecsSinceEpoch(), std::memory_order_relaxed);
+    // Degraded mode: keyframes only (each is independently decodable)
+    if (worker->quality.load(std::memory_order_relaxed) >= 2 &&
+        GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT))
+        return GST_PAD_PROBE_DROP;
+    worker->stats.onIngress(GST_BUFFER_PTS_IS_VALID(buf) ? qint64(GST_BUFFER_PTS(buf)) : -1,
+                            qint64(gst_buffer_get_size(buf)));
+    return GST_PAD_PROBE_OK;
+}
+
 void ArchiveWorker::onBusMessage(GstBus* bus, GstMessage* message, gpointer user_data) {
     Q_UNUSED(bus);
     ArchiveWorker* worker = static_cast<ArchiveWorker*>(user_data);
@@ -251,6 +589,18 @@ void ArchiveWorker::onBusMessage(GstBus* bus, GstMessage* message, gpointer user
         GError* err = nullptr;
         gchar* debug_info = nullptr;
         gst_message_parse_error(message, &err, &debug_info);
+        if (worker->isSubBranch(GST_MESSAGE_SRC(message))) {
+            // A dead substream must not take the main recording down with it.
+            if (worker->dropSubBranch()) {
+                qWarning() << "[ArchiveWorker] Substream error for cam" << worker->cameraIndex
+                           << ":" << err->message << "- main recording continues";
+                g_error_free(err);
+                g_free(debug_info);
+                break;
+            }
+            qWarning() << "[ArchiveWorker] Substream error for cam" << worker->cameraIndex
+                       << "and the main branch is not playing";
+        }
         qDebug() << "[ArchiveWorker] GST ERROR for cam" << worker->cameraIndex << ":" << err->message;
         emit worker->recordingError(err->message);
         g_error_free(err);
@@ -271,6 +621,14 @@ void ArchiveWorker::onBusMessage(GstBus* bus, GstMessage* message, gpointer user
                         worker->currentFilePath.clear();
                         worker->currentStartTimeUtc = QDateTime();
                     }
+                    if (!worker->currentSubPath.isEmpty() && worker->currentSubStartUtc.isValid()) {
+                        const QDateTime nowUtc = QDateTime::currentDateTimeUtc();
+                        emit worker->segmentClosed(worker->cameraIndex, worker->currentSubPath,
+                                                   nowUtc.toMSecsSinceEpoch()*1000000LL,
+                                                   worker->currentSubStartUtc.msecsTo(nowUtc));
+                        worker->currentSubPath.clear();
+                        worker->currentSubStartUtc = QDateTime();
+                    }
                 }
         qDebug() << "[ArchiveWorker] GST EOS received for cam" << worker->cameraIndex;
         emit worker->segmentFinalized();
@@ -284,6 +642,20 @@ void ArchiveWorker::onBusMessage(GstBus* bus, GstMessage* message, gpointer user
         g_free(debug_info);
         break;
     }
+    case GST_MESSAGE_ELEMENT: {
+        const GstStructure* st = gst_message_get_structure(message);
+        if (!st || !gst_structure_has_name(st, "splitmuxsink-fragment-closed")) break;
+        const qint64 splitAt = worker->splitAtUs.load();
+        if (splitAt > 0 && !worker->isSubBranch(GST_MESSAGE_SRC(message))) {
+            qDebug() << "[ArchiveWorker] Fragment finalized for cam" << worker->cameraIndex
+                     << "(" << QString::fromStdString(worker->container) << ") in"
+                     << (g_get_monotonic_time() - splitAt) / 1000 << "ms";
+        }
+        // file is complete on disk now (async-finalize done) → safe to move
+        if (const gchar* loc = gst_structure_get_string(st, "location"))
+            emit worker->segmentFileReady(worker->cameraIndex, QString::fromUtf8(loc));
+        break;
+    }
     case GST_MESSAGE_STATE_CHANGED: {
         GstState old_state, new_state, pending;
         gst_message_parse_state_changed(message, &old_state, &new_state, &pending);
@@ -4,12 +4,14 @@
 #include <QObject>
 #include <QThread>
 #include <QString>
+#include <QByteArray>
 #include <atomic>
 #include <QDateTime>
 #include <QMutex>
 #include <QWaitCondition>
 #include <string>
 #include <gst/gst.h>
+#include "recording_stats.h"
 
 class ArchiveWorker : public QThread {
     Q_OBJECT
@@ -18,18 +20,39 @@ public:
                   int cameraIndex,
                   const QString& archiveDir,
                   int defaultDurationSec,
-                  const QDateTime& masterStart);
+                  const QDateTime& masterStart,
+                  const std::string& container = "mkv",
+                  int splitPhaseSec = 0,
+                  const std::string& subUrl = std::string());
     void run() override;
     void stop();
+    // Live counters; safe to read from any thread.
+    RecordingStats* recordingStats() { return &stats; }
+    // Wall time (ms since epoch) of the last buffer into splitmuxsink; 0 = none yet.
+    qint64 lastDataMs() const { return lastDataMs_.load(std::memory_order_relaxed); }
 
 public slots:
-    void updateSegmentDuration(int seconds);
+    // phaseSec lengthens the first segment after the switch so cameras keep
+    // their boundaries spread across the period (see ArchiveManager).
+    void updateSegmentDuration(int seconds, int phaseSec = 0);
+    // Recording quality label/mode: 0 full, 1 substream, 2 keyframes only.
+    // The URL is fixed per worker (substream = new worker); level 2 drops
+    // delta frames before the muxer and takes effect at the next segment.
+    void setQuality(int level);
 
 signals:
     void recordingError(const std::string& error);
     void segmentFinalized();
-    void segmentOpened(int camIndex, QString filePath, qint64 startUtcNs);     //meta data to store in db
+    void segmentOpened(int camIndex, QString filePath, qint64 startUtcNs,
+                       qint64 startPtsNs, QString timeSource, int quality);     //meta data to store in db
     void segmentClosed(int camIndex, QString filePath, qint64 endUtcNs, qint64 durationMs);//meta data to store in db
+    void segmentFileReady(int camIndex, QString filePath);  // muxer finished writing the file
+    // Substream copy (subUrl set): follows the main segment boundaries;
+    // mainFilePath is the main segment it belongs to ("" if none open yet).
+    void subSegmentOpened(int camIndex, QString filePath, qint64 startUtcNs,
+                          qint64 startPtsNs, QString timeSource, QString mainFilePath);
+    // Muxer done with the file: SegmentHasher digest of its bytes (main and sub).
+    void segmentHashed(int camIndex, QString filePath, QByteArray sha256);
 
 private:
     std::string cameraUrl;
@@ -39,8 +62,16 @@ private:
     std::atomic<int> segmentDurationSec;
     std::atomic<bool> pendingDurationUpdate;
     int nextSegmentDuration;
+    int nextSplitPhase;
+    std::atomic<int> splitPhaseSec;     // extra length of the current fragment; 0 = none
     QDateTime masterStart;
+    std::string container;          // "mkv" | "mp4" (fragmented) | "ts"
+    std::string subUrl;             // record the substream too; "" = main only
     GstElement *pipeline;
+    // sub_source … split_sub while the substream branch is in the pipeline
+    // (owned by it); bus messages are attributed by walking up to one of these
+    GstElement* subBranch_[4] = {};
+    bool subDropped_ = false;       // branch taken out after an error; we hold the refs
 
     QMutex updateMutex;
     QWaitCondition updateCondition;
@@ -48,14 +79,43 @@ private:
     QDateTime lastSegmentTimestamp;
 
     void createPipeline();
+    bool createSubBranch(const char* muxerFactory);
     void cleanupPipeline();
+    void splitSub();
     QString generateSegmentPrefix() const;
+    QString fileExtension() const;
 
     static gchar* formatLocationFullCallback(GstElement* splitmux, guint fragment_id, GstSample* sample, gpointer user_data);
+    static gchar* formatLocationSubCallback(GstElement* splitmux, guint fragment_id, GstSample* sample, gpointer user_data);
+    static void onPadAdded(GstElement* src, GstPad* pad, gpointer user_data);
+    bool isSubBranch(GstObject* obj) const;
+    bool dropSubBranch();
+    QDateTime segmentStartFor(GstSample* sample, qint64* startPtsNs, QString* timeSource);
     static void onBusMessage(GstBus* bus, GstMessage* message, gpointer user_data);
+    static void onSinkAdded(GstElement* splitmux, GstElement* sink, gpointer user_data);
+    static GstPadProbeReturn onIngressProbe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static GstPadProbeReturn onClockProbe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    bool wallClockFor(qint64 ptsNs, qint64* wallNs, QString* source);
+    RecordingStats stats;
+    std::atomic<qint64> lastDataMs_{0};
+    std::atomic<bool> rehashWarned_{false};   // hash window overrun reported once
+    std::atomic<int> pendingQuality{0};
+    std::atomic<int> quality{0};    // of the current segment
+    void closeOpenSegment(bool subOnly = false);
     QString currentFilePath;
     QDateTime currentStartTimeUtc;
-    QMutex curMutex;
+    QString currentSubPath;
+    QDateTime currentSubStartUtc;
+    QMutex curMutex;                // guards current* (main and sub)
+    // split → previous fragment closed (finalize cost); g_get_monotonic_time()
+    // of the last split, set on the streaming thread, read on the bus thread
+    std::atomic<qint64> splitAtUs{0};
+
+    // PTS → UTC mapping of this camera's stream. NTP from RTCP sender reports
+    // once they arrive; until then the local clock at the first buffer.
+    struct ClockAnchor { qint64 ptsNs = -1; qint64 wallNs = 0; bool ntp = false; };
+    QMutex clockMutex;
+    ClockAnchor clockAnchor;
 };
 
 #endif // ARCHIVEWORKER_H
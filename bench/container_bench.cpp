@@ -0,0 +1,297 @@
+// Container benchmark: the same H.264 stream through splitmuxsink as mkv,
+// fragmented mp4 and mpeg-ts, muxed the way ArchiveWorker does it, written
+// to the medium under test (point it at the USB drive). Reports per format
+//   - write overhead: container bytes over H.264 payload, wall time to mux
+//     and fsync everything
+//   - finalize time: split → splitmuxsink-fragment-closed (async-finalize)
+//   - seek latency: flushing key-unit seek → ASYNC_DONE in a paused playbin
+//
+//   container_bench <dir> [segments=10] [seconds=10]
+//
+// The stream is encoded once into memory first, so encoder cost does not
+// land in the write numbers. The page cache is not dropped between write
+// and seek; run as root with `echo 3 > /proc/sys/vm/drop_caches` in between
+// for cold-cache seeks.
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QTextStream>
+#include <QUrl>
+#include <QVector>
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const int kFps = 25;
+const int kGop = 50;                    // 2 s, a typical camera I-frame interval
+
+struct Encoded {
+    GstCaps* caps = nullptr;
+    QVector<GstBuffer*> buffers;
+    qint64 bytes = 0;
+};
+
+struct Result {
+    QString container;
+    qint64 fileBytes = 0;
+    qint64 writeMs = 0;
+    QVector<qint64> finalizeUs;
+    QVector<qint64> seekUs;
+    QStringList files;
+    QString error;
+};
+
+// split times (format-location, fragment > 0) waiting for their fragment-closed
+struct SplitClock {
+    QMutex mutex;
+    std::deque<qint64> openedUs;
+};
+
+QTextStream& out() {
+    static QTextStream s(stdout);
+    return s;
+}
+
+GstElement* launch(const QString& desc, QString* err) {
+    GError* e = nullptr;
+    GstElement* p = gst_parse_launch(desc.toUtf8().constData(), &e);
+    if (e) {
+        *err = QString::fromUtf8(e->message);
+        g_error_free(e);
+        if (p) gst_object_unref(p);
+        return nullptr;
+    }
+    return p;
+}
+
+// ERROR/EOS/ASYNC_DONE (or ELEMENT, handled by onElement) on the bus
+GstMessageType waitFor(GstElement* pipeline, GstMessageType types, QString* err,
+                       const std::function<void(GstMessage*)>& onElement = {}) {
+    GstBus* bus = gst_element_get_bus(pipeline);
+    GstMessageType got = GST_MESSAGE_UNKNOWN;
+    const int mask = types | GST_MESSAGE_ERROR | (onElement ? GST_MESSAGE_ELEMENT : 0);
+    while (got == GST_MESSAGE_UNKNOWN) {
+        GstMessage* m = gst_bus_timed_pop_filtered(bus, 60 * GST_SECOND, GstMessageType(mask));
+        if (!m) { *err = "timed out"; got = GST_MESSAGE_ERROR; break; }
+        switch (GST_MESSAGE_TYPE(m)) {
+        case GST_MESSAGE_ERROR: {
+            GError* e = nullptr;
+            gst_message_parse_error(m, &e, nullptr);
+            *err = QString::fromUtf8(e->message);
+            g_error_free(e);
+            got = GST_MESSAGE_ERROR;
+            break;
+        }
+        case GST_MESSAGE_ELEMENT:
+            if (onElement) onElement(m);
+            if (types & GST_MESSAGE_ELEMENT) got = GST_MESSAGE_ELEMENT;
+            break;
+        default:
+            got = GST_MESSAGE_TYPE(m);
+        }
+        gst_message_unref(m);
+    }
+    gst_object_unref(bus);
+    return got;
+}
+
+bool encode(int frames, Encoded* enc, QString* err) {
+    GstElement* p = launch(QString(
+        "videotestsrc num-buffers=%1 pattern=ball ! "
+        "video/x-raw,width=1920,height=1080,framerate=%2/1 ! "
+        "x264enc tune=zerolatency speed-preset=ultrafast bitrate=4096 key-int-max=%3 ! "
+        "h264parse ! video/x-h264,stream-format=byte-stream,alignment=au ! "
+        "appsink name=out sync=false max-buffers=0")
+        .arg(frames).arg(kFps).arg(kGop), err);
+    if (!p) return false;
+    GstElement* sink = gst_bin_get_by_name(GST_BIN(p), "out");
+    gst_element_set_state(p, GST_STATE_PLAYING);
+    while (GstSample* s = gst_app_sink_pull_sample(GST_APP_SINK(sink))) {
+        if (!enc->caps) enc->caps = gst_caps_ref(gst_sample_get_caps(s));
+        GstBuffer* b = gst_buffer_ref(gst_sample_get_buffer(s));
+        enc->bytes += qint64(gst_buffer_get_size(b));
+        enc->buffers.push_back(b);
+        gst_sample_unref(s);
+    }
+    const bool ok = waitFor(p, GST_MESSAGE_EOS, err) == GST_MESSAGE_EOS;
+    gst_element_set_state(p, GST_STATE_NULL);
+    gst_object_unref(sink);
+    gst_object_unref(p);
+    return ok && !enc->buffers.isEmpty();
+}
+
+gchar* onFormatLocation(GstElement* split, guint fragmentId, gpointer user_data) {
+    Q_UNUSED(split);
+    if (fragmentId > 0) {
+        auto* clock = static_cast<SplitClock*>(user_data);
+        QMutexLocker lk(&clock->mutex);
+        clock->openedUs.push_back(g_get_monotonic_time());
+    }
+    return nullptr;                     // default: the location pattern
+}
+
+// Same splitmuxsink settings as ArchiveWorker::createPipeline().
+void writeRun(const Encoded& enc, const QString& dir, int seconds, Result* r) {
+    const QString ext = r->container;
+    const char* muxer = ext == "mp4" ? "mp4mux" : ext == "ts" ? "mpegtsmux" : "matroskamux";
+    GstElement* p = launch(QString(
+        "appsrc name=in format=time is-live=false ! h264parse name=parse ! "
+        "splitmuxsink name=split"), &r->error);
+    if (!p) return;
+    GstElement* src   = gst_bin_get_by_name(GST_BIN(p), "in");
+    GstElement* parse = gst_bin_get_by_name(GST_BIN(p), "parse");
+    GstElement* split = gst_bin_get_by_name(GST_BIN(p), "split");
+    g_object_set(src, "caps", enc.caps, nullptr);
+    if (ext == "ts")
+        g_object_set(parse, "config-interval", -1, nullptr);
+    const QString pattern = QDir(dir).filePath(QString("container_bench_%05d.%1").arg(ext));
+    g_object_set(split,
+                 "location",       pattern.toUtf8().constData(),
+                 "max-size-time",  static_cast<guint64>(seconds) * GST_SECOND,
+                 "async-finalize", TRUE,
+                 "muxer-factory",  muxer,
+                 nullptr);
+    if (ext == "mp4") {
+        GstStructure* props = gst_structure_new("properties",
+                                                "fragment-duration", G_TYPE_UINT, 1000u,
+                                                nullptr);
+        g_object_set(split, "muxer-properties", props, nullptr);
+        gst_structure_free(props);
+    }
+    SplitClock clock;
+    g_signal_connect(split, "format-location", G_CALLBACK(onFormatLocation), &clock);
+
+    QElapsedTimer wall;
+    wall.start();
+    gst_element_set_state(p, GST_STATE_PLAYING);
+    for (GstBuffer* b : enc.buffers)
+        gst_app_src_push_buffer(GST_APP_SRC(src), gst_buffer_ref(b));
+    gst_app_src_end_of_stream(GST_APP_SRC(src));
+
+    const auto onElement = [&](GstMessage* m) {
+        const GstStructure* st = gst_message_get_structure(m);
+        if (!st || !gst_structure_has_name(st, "splitmuxsink-fragment-closed")) return;
+        if (const gchar* loc = gst_structure_get_string(st, "location"))
+            r->files << QString::fromUtf8(loc);
+        QMutexLocker lk(&clock.mutex);
+        // the last fragment closes on EOS, without a split to time it from
+        if (clock.openedUs.empty()) return;
+        r->finalizeUs << g_get_monotonic_time() - clock.openedUs.front();
+        clock.openedUs.pop_front();
+    };
+    if (waitFor(p, GST_MESSAGE_EOS, &r->error, onElement) == GST_MESSAGE_EOS) {
+        // on USB the page cache hides the real cost; count it reaching the medium
+        for (const QString& f : r->files) {
+            const int fd = ::open(QFile::encodeName(f).constData(), O_RDONLY);
+            if (fd >= 0) { ::fsync(fd); ::close(fd); }
+            r->fileBytes += QFileInfo(f).size();
+        }
+        r->writeMs = wall.elapsed();
+    }
+    gst_element_set_state(p, GST_STATE_NULL);
+    gst_object_unref(split);
+    gst_object_unref(parse);
+    gst_object_unref(src);
+    gst_object_unref(p);
+}
+
+// Key-unit seeks to a quarter, half and three quarters of each file, the way
+// the playback player jumps on the timeline.
+void seekRun(Result* r) {
+    for (const QString& f : r->files) {
+        QString err;
+        GstElement* p = launch(QString("playbin uri=%1 video-sink=fakesink audio-sink=fakesink")
+                                   .arg(QUrl::fromLocalFile(f).toString()), &err);
+        if (!p) { r->error = err; return; }
+        gst_element_set_state(p, GST_STATE_PAUSED);
+        gint64 dur = -1;
+        if (waitFor(p, GST_MESSAGE_ASYNC_DONE, &err) == GST_MESSAGE_ASYNC_DONE
+            && gst_element_query_duration(p, GST_FORMAT_TIME, &dur) && dur > 0) {
+            for (int q = 1; q <= 3; ++q) {
+                const qint64 t0 = g_get_monotonic_time();
+                if (!gst_element_seek_simple(p, GST_FORMAT_TIME,
+                                             GstSeekFlags(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT),
+                                             dur * q / 4))
+                    break;
+                if (waitFor(p, GST_MESSAGE_ASYNC_DONE, &err) != GST_MESSAGE_ASYNC_DONE) break;
+                r->seekUs << g_get_monotonic_time() - t0;
+            }
+        }
+        if (!err.isEmpty() && r->error.isEmpty()) r->error = err;
+        gst_element_set_state(p, GST_STATE_NULL);
+        gst_object_unref(p);
+    }
+}
+
+QString avgMax(const QVector<qint64>& us) {
+    if (us.isEmpty()) return "-";
+    qint64 sum = 0;
+    for (qint64 v : us) sum += v;
+    return QString("%1 / %2").arg(sum / us.size() / 1000.0, 0, 'f', 1)
+                             .arg(*std::max_element(us.begin(), us.end()) / 1000.0, 0, 'f', 1);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    gst_init(&argc, &argv);
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    if (args.size() < 2) {
+        out() << "usage: container_bench <dir> [segments=10] [seconds=10]\n";
+        return 2;
+    }
+    const QString dir = args.at(1);
+    const int segments = args.size() > 2 ? qMax(2, args.at(2).toInt()) : 10;
+    const int seconds  = args.size() > 3 ? qMax(2, args.at(3).toInt()) : 10;
+    if (!QDir().mkpath(dir)) {
+        out() << "cannot create " << dir << "\n";
+        return 1;
+    }
+
+    Encoded enc;
+    QString err;
+    out() << "encoding " << segments * seconds << " s of 1080p25 H.264 ...\n";
+    out().flush();
+    if (!encode(segments * seconds * kFps, &enc, &err)) {
+        out() << "encode failed: " << err << "\n";
+        return 1;
+    }
+
+    out() << QString("%1 %2 %3 %4 %5 %6\n")
+                 .arg("container", -9).arg("overhead %", 10).arg("write ms", 9)
+                 .arg("finalize ms avg/max", 20).arg("seek ms avg/max", 16).arg("files", 6);
+    int rc = 0;
+    for (const QString& c : { QString("mkv"), QString("mp4"), QString("ts") }) {
+        Result r;
+        r.container = c;
+        writeRun(enc, dir, seconds, &r);
+        if (r.error.isEmpty()) seekRun(&r);
+        const double overhead = enc.bytes > 0 ? 100.0 * (r.fileBytes - enc.bytes) / enc.bytes : 0;
+        out() << QString("%1 %2 %3 %4 %5 %6\n")
+                     .arg(c, -9).arg(overhead, 10, 'f', 2).arg(r.writeMs, 9)
+                     .arg(avgMax(r.finalizeUs), 20).arg(avgMax(r.seekUs), 16).arg(r.files.size(), 6);
+        if (!r.error.isEmpty()) {
+            out() << "  " << c << ": " << r.error << "\n";
+            rc = 1;
+        }
+        out().flush();
+        for (const QString& f : r.files) QFile::remove(f);
+    }
+
+    for (GstBuffer* b : enc.buffers) gst_buffer_unref(b);
+    if (enc.caps) gst_caps_unref(enc.caps);
+    return rc;
+}
@@ -0,0 +1,13 @@
+# Write / finalize / seek benchmark for the archive containers (mkv, mp4, ts).
+# Standalone; build with `qmake && make` here and point it at the USB medium.
+QT       = core
+CONFIG  += c++17 console
+CONFIG  -= app_bundle
+
+DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000
+
+CONFIG    += link_pkgconfig
+PKGCONFIG += gstreamer-1.0 gstreamer-app-1.0 glib-2.0
+
+TARGET   = container_bench
+SOURCES += container_bench.cpp
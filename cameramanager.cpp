@@ -42,6 +42,9 @@ void CameraManager::saveCameraNames() {
         camObj["url"] = QString::fromStdString(profile.url);
         camObj["suburl"] = QString::fromStdString(profile.suburl); // Save the suburl as well.
         camObj["name"] = QString::fromStdString(profile.displayName);
+        camObj["container"] = QString::fromStdString(profile.container);
+        camObj["priority"] = profile.priority;
+        camObj["record_sub"] = profile.recordSub;
         camerasArray.append(camObj);
     }
     json["cameras"] = camerasArray;
@@ -76,10 +76,17 @@ void CameraStreams::loadFromJson() {
         std::string name = camObj["name"].toString().toStdString();
         if (existingUrls.find(url) == existingUrls.end()) {
             cameraUrls.emplace_back(url, suburl, name);
+            // Optional: archive container per camera (defaults to mkv)
+            const QString container = camObj["container"].toString().toLower();
+            if (container == "mp4" || container == "ts")
+                cameraUrls.back().container = container.toStdString();
+            cameraUrls.back().priority = qBound(0, camObj["priority"].toInt(0), 2);
+            cameraUrls.back().recordSub = camObj["record_sub"].toBool(false) && !suburl.empty();
             existingUrls.insert(url);
             qDebug() << "Loaded Camera:" << QString::fromStdString(name)
                      << "->" << QString::fromStdString(url)
-                     << "Substream:" << QString::fromStdString(suburl);
+                     << "Substream:" << QString::fromStdString(suburl)
+                     << "Container:" << QString::fromStdString(cameraUrls.back().container);
         }
     }
 }
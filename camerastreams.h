@@ -17,6 +17,9 @@ public:
     std::string url;       // Main URL for archiving (high quality)
     std::string suburl;    // Sub URL for streaming (low quality)
     std::string displayName;
+    std::string container = "mkv";  // archive container: "mkv", "mp4" (fragmented) or "ts"
+    int priority = 0;               // 0 normal, 1 important, 2 critical: degrades later when disk is full
+    bool recordSub = false;         // also archive suburl (low-res copy for scrubbing)
 
 
     CamHWProfile(const std::string& rtspUrl, const std::string& subUrl, const std::string& name = "")
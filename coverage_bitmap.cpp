@@ -0,0 +1,66 @@
+#include "coverage_bitmap.h"
+#include <QDateTime>
+
+static const int kBytes = CoverageBitmap::kSeconds / 8;
+
+CoverageBitmap CoverageBitmap::unpack(const QByteArray& packed) {
+    CoverageBitmap b;
+    if (packed.isEmpty()) return b;
+    b.bits_ = qUncompress(packed);
+    if (b.bits_.size() != kBytes) b.bits_.clear();
+    return b;
+}
+
+QByteArray CoverageBitmap::pack() const {
+    return bits_.isEmpty() ? QByteArray() : qCompress(bits_, 9);
+}
+
+void CoverageBitmap::setRange(qint64 fromSec, qint64 toSec) {
+    fromSec = qMax<qint64>(0, fromSec);
+    toSec   = qMin<qint64>(kSeconds, toSec);
+    if (fromSec >= toSec) return;
+    if (bits_.isEmpty()) bits_.fill('\0', kBytes);
+    uchar* p = reinterpret_cast<uchar*>(bits_.data());
+    qint64 i = fromSec;
+    for (; i < toSec && (i & 7); ++i) p[i >> 3] |= uchar(1u << (i & 7));
+    for (; i + 8 <= toSec; i += 8) p[i >> 3] = 0xff;
+    for (; i < toSec; ++i) p[i >> 3] |= uchar(1u << (i & 7));
+}
+
+bool CoverageBitmap::test(qint64 sec) const {
+    if (bits_.isEmpty() || sec < 0 || sec >= kSeconds) return false;
+    return uchar(bits_.at(int(sec >> 3))) & (1u << (sec & 7));
+}
+
+int CoverageBitmap::count() const {
+    int n = 0;
+    for (char c : bits_) n += qPopulationCount(quint8(c));
+    return n;
+}
+
+QVector<QPair<int, int>> CoverageBitmap::runs() const {
+    QVector<QPair<int, int>> out;
+    if (bits_.isEmpty()) return out;
+    const uchar* p = reinterpret_cast<const uchar*>(bits_.constData());
+    int start = -1;
+    for (int byte = 0; byte < kBytes; ++byte) {
+        const uchar v = p[byte];
+        if ((v == 0x00 && start < 0) || (v == 0xff && start >= 0)) continue;   // no edge here
+        for (int bit = 0; bit < 8; ++bit) {
+            const bool on = v & (1u << bit);
+            const int sec = byte * 8 + bit;
+            if (on && start < 0) start = sec;
+            else if (!on && start >= 0) { out.push_back({ start, sec }); start = -1; }
+        }
+    }
+    if (start >= 0) out.push_back({ start, kSeconds });
+    return out;
+}
+
+qint64 CoverageBitmap::dayStartNs(const QDate& day) {
+    return QDateTime(day, QTime(0, 0), Qt::LocalTime).toMSecsSinceEpoch() * 1000000LL;
+}
+
+QDate CoverageBitmap::localDay(qint64 utcNs) {
+    return QDateTime::fromMSecsSinceEpoch(utcNs / 1000000LL).date();
+}
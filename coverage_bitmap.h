@@ -0,0 +1,35 @@
+#pragma once
+#include <QByteArray>
+#include <QDate>
+#include <QPair>
+#include <QVector>
+#include <QtGlobal>
+
+// Footage of one camera on one local day at 1 s resolution: bit i is the
+// second starting i seconds after local midnight (LSB first in each byte).
+// Sized for 25 h so a DST fall-back day fits. Stored qCompress'ed in
+// day_coverage (DbWriter); a recorded day packs to a few hundred bytes.
+class CoverageBitmap final {
+public:
+    static constexpr int kSeconds = 25 * 3600;
+
+    CoverageBitmap() = default;
+    // From the stored form; empty or unreadable = no footage.
+    static CoverageBitmap unpack(const QByteArray& packed);
+    QByteArray pack() const;
+
+    // Marks [fromSec, toSec), clamped to the day.
+    void setRange(qint64 fromSec, qint64 toSec);
+    bool test(qint64 sec) const;
+    bool isEmpty() const { return bits_.isEmpty(); }
+    int  count() const;
+    // Covered stretches as [start, end) seconds, in order.
+    QVector<QPair<int, int>> runs() const;
+
+    // Local midnight of a date / the local date of an instant.
+    static qint64 dayStartNs(const QDate& day);
+    static QDate  localDay(qint64 utcNs);
+
+private:
+    QByteArray bits_;   // empty until the first setRange
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+// events.kind (schema v5). Stored as integers: append, never renumber.
+enum class EventKind {
+    Error            = 0,   // DbWriter::markError, no finer kind
+    StreamError      = 1,   // ArchiveWorker pipeline error
+    StreamRestart    = 2,   // ArchiveManager watchdog respawned a worker
+    StorageMounted   = 3,   // archive target appeared (removable media)
+    StorageUnmounted = 4,
+    Retention        = 5,   // footage deleted: day pruned or loop slot reused
+    Motion           = 6,   // motion trigger (no detector feeds this yet)
+};
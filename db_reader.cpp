@@ -1,8 +1,10 @@
 #include "db_reader.h"
+#include "coverage_bitmap.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QVariant>
 #include <QFileInfo>
+#include <QRegularExpression>
 #include <QDateTime>
 #include <QtDebug>
 
@@ -49,45 +51,149 @@ void DbReader::openAt(const QString& dbPath) {
     );
     const bool ok = db_.open();
     qInfo() << "[DB] RO open:" << QFileInfo(db_.databaseName()).absoluteFilePath();
+#ifndef QT_NO_DEBUG
+    if (ok) checkQueryPlans();
+#endif
     emit opened(ok, ok ? QString() : db_.lastError().text());
 }
 
+// Longest span a segment can have (1 h recordings, hourly merges; a day
+// leaves margin). Gives listSegments a lower bound on start_utc_ns, so the
+// day window is a bounded range of idx_segments_span.
+static const qint64 kMaxSegmentSpanNs = 24LL * 3600 * 1000000000LL;
+
+// The listing queries, shared by the slots and checkQueryPlans().
+
+// one day_summary probe per camera (schema v3)
+static const char* const kCamerasSql = R"SQL(
+    SELECT c.id, c.name
+    FROM cameras c
+    WHERE EXISTS (
+      SELECT 1 FROM day_summary d
+      WHERE d.camera_id = c.id AND d.segments > 0
+    )
+    ORDER BY c.name
+)SQL";
+
+// primary-key range of day_summary: one row per recorded day
+static const char* const kDaysSql = R"SQL(
+    SELECT day, segments, covered_ms, bytes
+    FROM day_summary
+    WHERE camera_id = :cid AND segments > 0
+    ORDER BY day
+)SQL";
+
+// One range scan of idx_segments_span: camera_id =, start_utc_ns in
+// [start - max span, end), eff_end_ns checked in the index.
+// An open row's stored eff_end_ns is its start; it is still recording, so
+// its latest known end is now (:now_ns) - also across midnight.
+static const char* const kSegmentsSql = R"SQL(
+  SELECT s.file_path, s.start_utc_ns,
+         CASE WHEN s.status = 0 THEN MAX(s.eff_end_ns, :now_ns) ELSE s.eff_end_ns END,
+         s.duration_ms, COALESCE(s.health,0), sub.file_path, sub.start_utc_ns, s.status = 0
+  FROM segments s
+  LEFT JOIN segments sub ON sub.id = (
+    SELECT x.id FROM segments x
+    WHERE x.main_segment_id = s.id AND x.status IN (0,1) AND COALESCE(x.health,0) < 3
+    ORDER BY x.start_utc_ns LIMIT 1)
+  WHERE s.camera_id = :cid
+    AND s.start_utc_ns >= :min_start AND s.start_utc_ns < :end_ns
+    AND (s.eff_end_ns > :start_ns OR s.status = 0)
+    AND s.status IN (0,1)
+    AND COALESCE(s.variant,0) = 0
+  ORDER BY s.start_utc_ns
+)SQL";
+
+static const char* const kCoverageSql =
+    "SELECT bits FROM day_coverage WHERE camera_id = :cid AND day = :day";
+
+// idx_day_coverage_day: one bitmap per camera that recorded that day
+static const char* const kCamerasAtSql =
+    "SELECT camera_id, bits FROM day_coverage WHERE day = :day ORDER BY camera_id";
+
+// two range scans of idx_events_cam_ts (an OR would scan the table)
+static const char* const kCameraEventsSql = R"SQL(
+  SELECT ts_utc_ns, COALESCE(camera_id,0), kind, source, detail FROM events
+  WHERE camera_id = :cid AND ts_utc_ns >= :from AND ts_utc_ns < :to
+  UNION ALL
+  SELECT ts_utc_ns, 0, kind, source, detail FROM events
+  WHERE camera_id IS NULL AND ts_utc_ns >= :from2 AND ts_utc_ns < :to2
+  ORDER BY 1
+)SQL";
+
+// every camera: idx_events_ts
+static const char* const kAllEventsSql = R"SQL(
+  SELECT ts_utc_ns, COALESCE(camera_id,0), kind, source, detail FROM events
+  WHERE ts_utc_ns >= :from AND ts_utc_ns < :to
+  ORDER BY ts_utc_ns
+)SQL";
+
+// "SCAN <table|alias> ..." (older SQLite: "SCAN TABLE <table> ...") of
+// anything but cameras, which is a handful of rows.
+static bool fullScan(const QString& detail) {
+    if (!detail.startsWith("SCAN ")) return false;
+    QStringList words = detail.mid(5).split(' ');
+    if (words.value(0) == "TABLE") words.removeFirst();
+    const QString what = words.value(0);
+    return what != "c" && what != "cameras" && what != "CONSTANT";
+}
+
+// Debug builds: the listing queries must stay index range scans (schema
+// v2-v5); a full scan means an index or migration is missing.
+void DbReader::checkQueryPlans() {
+    const char* const queries[] = {
+        kCamerasSql, kDaysSql, kSegmentsSql, kCoverageSql, kCamerasAtSql,
+        kCameraEventsSql, kAllEventsSql,
+    };
+    static const QRegularExpression param(":(\\w+)");
+    for (const char* sql : queries) {
+        const QString text = QString::fromUtf8(sql).simplified();
+        QSqlQuery q(db_);
+        if (!q.prepare("EXPLAIN QUERY PLAN " + text)) continue;   // pre-v2 DB
+        auto it = param.globalMatch(text);
+        while (it.hasNext()) q.bindValue(it.next().captured(0), 0);
+        if (!q.exec()) continue;
+        while (q.next()) {
+            const QString detail = q.value(3).toString();
+            if (fullScan(detail)) qWarning() << "[DB] full scan in" << text << ":" << detail;
+        }
+    }
+}
+
 void DbReader::listCameras() {
     QVector<QPair<int,QString>> out;
     QSqlQuery q(db_);
-    q.prepare(R"SQL(
-        SELECT c.id, c.name
-        FROM cameras c
-        WHERE EXISTS (
-          SELECT 1 FROM segments s
-          WHERE s.status IN (0,1)
-            AND (s.camera_id=c.id OR s.camera_url=c.main_url)
-        )
-        ORDER BY c.name
-    )SQL");
+    q.prepare(kCamerasSql);
     if (!q.exec()) { emit error(q.lastError().text()); return; }
     while (q.next()) out.push_back({ q.value(0).toInt(), q.value(1).toString() });
     emit camerasReady(out);
 }
 
-void DbReader::listDays(int cameraId) {
+void DbReader::listDays(int cameraId, quint64 gen) {
+    if (stale(Days, gen)) return;
     QStringList days;
+    DaySummaryList summary;
     QSqlQuery q(db_);
-    q.prepare(R"SQL(
-        SELECT DISTINCT strftime('%Y-%m-%d',
-                                 datetime(start_utc_ns/1000000000,'unixepoch','localtime'))
-        FROM segments
-        WHERE status IN (0,1)
-          AND (camera_id=:cid OR camera_url=(SELECT main_url FROM cameras WHERE id=:cid))
-        ORDER BY 1
-    )SQL");
+    q.setForwardOnly(true);
+    q.prepare(kDaysSql);
     q.bindValue(":cid", cameraId);
     if (!q.exec()) { emit error(q.lastError().text()); return; }
-    while (q.next()) days << q.value(0).toString();
+    while (q.next()) {
+        DaySummary d;
+        d.day       = q.value(0).toString();
+        d.segments  = q.value(1).toInt();
+        d.coveredMs = q.value(2).toLongLong();
+        d.bytes     = q.value(3).toLongLong();
+        days << d.day;
+        summary.push_back(d);
+    }
+    if (stale(Days, gen)) return;
+    emit daySummaryReady(cameraId, summary);
     emit daysReady(cameraId, days);
 }
 
-void DbReader::listSegments(int cameraId, const QString& ymd) {
+void DbReader::listSegments(int cameraId, const QString& ymd, quint64 gen) {
+    if (stale(Segments, gen)) return;
     // compute local-day window in UTC epoch nanoseconds
     const QDate d = QDate::fromString(ymd, "yyyy-MM-dd");
     const QDateTime d0(d, QTime(0,0,0), Qt::LocalTime);
@@ -98,64 +204,13 @@ void DbReader::listSegments(int cameraId, const QString& ymd) {
     QVector<SegmentInfo> segs;
     QSqlQuery q(db_);
     q.setForwardOnly(true);
-
-    // NOTE: no "now()" fallback — open-ended rows collapse to start_utc_ns
-    q.prepare(R"SQL(
-      SELECT path, start_utc_ns, eff_end_ns, duration_ms FROM (
-        -- branch 1: rows with camera_id filled (uses idx_segments_camera_time)
-        SELECT
-          s.file_path AS path,
-          s.start_utc_ns,
-          CASE
-            WHEN s.end_utc_ns IS NOT NULL AND s.end_utc_ns > 0 THEN s.end_utc_ns
-            WHEN COALESCE(s.duration_ms,0) > 0 THEN s.start_utc_ns + s.duration_ms*1000000
-            ELSE s.start_utc_ns
-          END AS eff_end_ns,
-          s.duration_ms
-        FROM segments s
-        WHERE s.status IN (0,1)
-          AND s.camera_id = :cid
-          AND s.start_utc_ns < :end_ns
-          AND (
-                CASE
-                  WHEN s.end_utc_ns IS NOT NULL AND s.end_utc_ns > 0 THEN s.end_utc_ns
-                  WHEN COALESCE(s.duration_ms,0) > 0 THEN s.start_utc_ns + s.duration_ms*1000000
-                  ELSE s.start_utc_ns
-                END
-              ) > :start_ns
-
-        UNION ALL
-
-        -- branch 2: legacy rows matched by URL
-        SELECT
-          s.file_path AS path,
-          s.start_utc_ns,
-          CASE
-            WHEN s.end_utc_ns IS NOT NULL AND s.end_utc_ns > 0 THEN s.end_utc_ns
-            WHEN COALESCE(s.duration_ms,0) > 0 THEN s.start_utc_ns + s.duration_ms*1000000
-            ELSE s.start_utc_ns
-          END AS eff_end_ns,
-          s.duration_ms
-        FROM segments s
-        WHERE s.status IN (0,1)
-          AND s.camera_id IS NULL
-          AND s.camera_url = (SELECT main_url FROM cameras WHERE id=:cid)
-          AND s.start_utc_ns < :end_ns
-          AND (
-                CASE
-                  WHEN s.end_utc_ns IS NOT NULL AND s.end_utc_ns > 0 THEN s.end_utc_ns
-                  WHEN COALESCE(s.duration_ms,0) > 0 THEN s.start_utc_ns + s.duration_ms*1000000
-                  ELSE s.start_utc_ns
-                END
-              ) > :start_ns
-      )
-      ORDER BY start_utc_ns
-    )SQL");
+    q.prepare(kSegmentsSql);
 
     q.bindValue(":cid", cameraId);
+    q.bindValue(":min_start", start_ns - kMaxSegmentSpanNs);
     q.bindValue(":start_ns", start_ns);
     q.bindValue(":end_ns", end_ns);
-
+    q.bindValue(":now_ns", QDateTime::currentMSecsSinceEpoch() * 1000000LL);
     qInfo() << "[SQL] listSegments cid=" << cameraId
             << " day=" << ymd
             << " start_ns=" << start_ns << "end_ns=" << end_ns
@@ -164,14 +219,85 @@ void DbReader::listSegments(int cameraId, const QString& ymd) {
 
     if (!q.exec()) { emit error(q.lastError().text()); return; }
 
+    // rows are stepped lazily: a superseded scan stops here
+    int rows = 0;
     while (q.next()) {
+        if ((++rows & 255) == 0 && stale(Segments, gen)) {
+            qInfo() << "[SQL] listSegments cid=" << cameraId << "day=" << ymd << "superseded";
+            return;
+        }
         SegmentInfo s;
         s.path        = q.value(0).toString();
         s.start_ns    = q.value(1).toLongLong();
         s.end_ns      = q.value(2).toLongLong();
         s.duration_ms = q.value(3).toLongLong();
+        s.health      = q.value(4).toInt();
+        if (!q.value(5).isNull()) {
+            s.sub_path      = q.value(5).toString();
+            s.sub_offset_ns = q.value(6).toLongLong() - s.start_ns;
+        }
+        s.open        = q.value(7).toBool();
         segs.push_back(s);
     }
+    if (stale(Segments, gen)) return;
     emit segmentsReady(cameraId, segs);
 }
 
+
+void DbReader::coverage(int cameraId, const QString& ymd, quint64 gen) {
+    if (stale(Coverage, gen)) return;
+    QSqlQuery q(db_);
+    q.prepare(kCoverageSql);
+    q.bindValue(":cid", cameraId);
+    q.bindValue(":day", ymd);
+    if (!q.exec()) { emit error(q.lastError().text()); return; }
+    emit coverageReady(cameraId, ymd, q.next() ? q.value(0).toByteArray() : QByteArray());
+}
+
+void DbReader::camerasAt(qint64 utcNs, quint64 gen) {
+    if (stale(CamerasAt, gen)) return;
+    // one bit per camera that recorded that day, no segment rows touched
+    const QDate day = CoverageBitmap::localDay(utcNs);
+    const qint64 sec = (utcNs - CoverageBitmap::dayStartNs(day)) / 1000000000LL;
+    QVector<int> out;
+    QSqlQuery q(db_);
+    q.setForwardOnly(true);
+    q.prepare(kCamerasAtSql);
+    q.bindValue(":day", day.toString("yyyy-MM-dd"));
+    if (!q.exec()) { emit error(q.lastError().text()); return; }
+    while (q.next())
+        if (CoverageBitmap::unpack(q.value(1).toByteArray()).test(sec)) out << q.value(0).toInt();
+    if (stale(CamerasAt, gen)) return;
+    emit camerasAtReady(utcNs, out);
+}
+
+void DbReader::listEvents(int cameraId, qint64 fromNs, qint64 toNs, quint64 gen) {
+    if (stale(Events, gen)) return;
+    EventList out;
+    QSqlQuery q(db_);
+    q.setForwardOnly(true);
+    if (cameraId > 0) {
+        q.prepare(kCameraEventsSql);
+        q.bindValue(":cid", cameraId);
+        q.bindValue(":from2", fromNs);
+        q.bindValue(":to2", toNs);
+    } else {
+        q.prepare(kAllEventsSql);
+    }
+    q.bindValue(":from", fromNs);
+    q.bindValue(":to", toNs);
+    if (!q.exec()) { emit error(q.lastError().text()); return; }
+    int rows = 0;
+    while (q.next()) {
+        if ((++rows & 255) == 0 && stale(Events, gen)) return;
+        EventInfo e;
+        e.ts_ns     = q.value(0).toLongLong();
+        e.camera_id = q.value(1).toInt();
+        e.kind      = q.value(2).toInt();
+        e.source    = q.value(3).toString();
+        e.detail    = q.value(4).toString();
+        out.push_back(e);
+    }
+    if (stale(Events, gen)) return;
+    emit eventsReady(cameraId, fromNs, toNs, out);
+}
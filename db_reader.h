@@ -1,43 +1,93 @@
 #pragma once
+#include <QByteArray>
 #include <QObject>
 #include <QSqlDatabase>
 #include <QVector>
 #include <QPair>
 #include <QStringList>
 #include <QMetaType>
+#include <atomic>
+#include "db_events.h"
 
 struct SegmentInfo {
     QString path;
     qint64  start_ns;
     qint64  end_ns;
     qint64  duration_ms;
+    int     health = 0;   // ArchiveVerifier: 0 unchecked, 1 ok, 2 damaged, 3 corrupt, 4 missing
+    QString sub_path;     // substream copy ("" = none); see ArchiveWorker subUrl
+    qint64  sub_offset_ns = 0; // sub file start relative to start_ns
+    bool    open = false; // still recording; end_ns is "now" at query time
 };
 Q_DECLARE_METATYPE(SegmentInfo)
-using CamList     = QVector<QPair<int, QString>>;
-using SegmentList = QVector<SegmentInfo>;
+// One camera-day of day_summary (main-stream segments; bytes incl. substream).
+struct DaySummary {
+    QString day;              // local YYYY-MM-DD
+    int     segments   = 0;
+    qint64  coveredMs  = 0;
+    qint64  bytes      = 0;
+};
+Q_DECLARE_METATYPE(DaySummary)
+// One events row (schema v5).
+struct EventInfo {
+    qint64  ts_ns     = 0;
+    int     camera_id = 0;    // 0 = not tied to a camera (storage, ...)
+    int     kind      = 0;    // EventKind
+    QString source;
+    QString detail;
+};
+Q_DECLARE_METATYPE(EventInfo)
+using CamList        = QVector<QPair<int, QString>>;
+using SegmentList    = QVector<SegmentInfo>;
+using DaySummaryList = QVector<DaySummary>;
+using EventList      = QVector<EventInfo>;
 Q_DECLARE_METATYPE(CamList)
 Q_DECLARE_METATYPE(SegmentList)
+Q_DECLARE_METATYPE(DaySummaryList)
+Q_DECLARE_METATYPE(EventList)
 
+// The request slots below run in order on the DB thread. Those that take
+// `gen` can be superseded: the caller takes a token with supersede() (any
+// thread) and passes it along; a request whose token is no longer the
+// latest of its kind is dropped before it runs, abandoned mid-scan, or its
+// result is not emitted. gen 0 = always run.
 class DbReader : public QObject {
     Q_OBJECT
 public:
+    enum Request { Days, Segments, Coverage, Events, CamerasAt, RequestKinds };
+
     explicit DbReader(QObject* parent=nullptr);
     ~DbReader();
 
+    // Thread-safe: makes every earlier request of that kind stale.
+    quint64 supersede(Request r) { return ++gen_[r]; }
+
 public slots:
     void openAt(const QString& dbPath);                 // read-only connection
     void listCameras();                                 // id + name, only with recordings
-    void listDays(int cameraId);                        // distinct YYYY-MM-DD with data
-    void listSegments(int cameraId, const QString& ymd);// segments overlapping that day
+    void listDays(int cameraId, quint64 gen = 0);       // daySummaryReady, then daysReady
+    void listSegments(int cameraId, const QString& ymd, quint64 gen = 0); // segments overlapping that day
+    void coverage(int cameraId, const QString& ymd, quint64 gen = 0);     // day_coverage bitmap (schema v4)
+    void camerasAt(qint64 utcNs, quint64 gen = 0);      // cameras with footage at that instant
+    // events in [fromNs, toNs): that camera's plus the global ones
+    // (cameraId <= 0: every camera)
+    void listEvents(int cameraId, qint64 fromNs, qint64 toNs, quint64 gen = 0);
     void shutdown();
 signals:
     void opened(bool ok, QString err);
     void camerasReady(CamList cams);
     void daysReady(int cameraId, QStringList ymdList);
+    void daySummaryReady(int cameraId, DaySummaryList days);   // calendar heat-map
     void segmentsReady(int cameraId, SegmentList segs);
+    void coverageReady(int cameraId, QString ymd, QByteArray packed);   // CoverageBitmap::unpack
+    void camerasAtReady(qint64 utcNs, QVector<int> cameraIds);
+    void eventsReady(int cameraId, qint64 fromNs, qint64 toNs, EventList events);
     void error(QString err);
 
 private:
+    void checkQueryPlans();
+    bool stale(Request r, quint64 gen) const { return gen && gen != gen_[r].load(); }
+    std::atomic<quint64> gen_[RequestKinds] = {};
     QSqlDatabase db_;
     QString      connName_; // for QSqlDatabase::removeDatabase
 };
@@ -4,16 +4,27 @@
 #include <QSqlRecord>
 #include <QVariant>
 #include <QFileInfo>
+#include <QFile>
 #include <QDir>
 #include <QDebug>
+#include <QDateTime>
+#include <QTimer>
+#include <QtConcurrent>
+#include "coverage_bitmap.h"
+#include "mkv_probe.h"
+#include "sched_policy.h"
+#include "segment_hash.h"
 
 DbWriter::DbWriter(QObject* parent) : QObject(parent) {}
 DbWriter::~DbWriter() {
+    flush();
+    cameraQ_ = insertQ_ = insertSubQ_ = finalizeIdQ_ = finalizePathQ_ = QSqlQuery();
     if (db_.isOpen()) db_.close();
 }
 
 bool DbWriter::openAt(const QString& dbFile) {
     if (db_.isOpen()) return true;
+    SchedPolicy::applyToCurrentThread(SchedClass::Database);   // runs on the DB thread
     QDir().mkpath(QFileInfo(dbFile).absolutePath());
     db_ = QSqlDatabase::addDatabase("QSQLITE", "camvigil_db");
     db_.setDatabaseName(dbFile);
@@ -24,7 +35,62 @@ bool DbWriter::openAt(const QString& dbFile) {
     exec("PRAGMA journal_mode=WAL;");
     exec("PRAGMA synchronous=NORMAL;");
     exec("PRAGMA foreign_keys=ON;");
-    return ensureSchema();
+    if (!ensureSchema() || !prepareStatements()) return false;
+    flushTimer_ = new QTimer(this);
+    flushTimer_->setSingleShot(true);
+    connect(flushTimer_, &QTimer::timeout, this, &DbWriter::flush);
+    pruneGlobalEvents();
+    return true;
+}
+
+bool DbWriter::prepareStatements() {
+    cameraQ_      = QSqlQuery(db_);
+    insertQ_      = QSqlQuery(db_);
+    insertSubQ_   = QSqlQuery(db_);
+    finalizeIdQ_  = QSqlQuery(db_);
+    finalizePathQ_ = QSqlQuery(db_);
+    eventQ_       = QSqlQuery(db_);
+    const bool ok =
+        cameraQ_.prepare("SELECT id FROM cameras WHERE main_url=?;") &&
+        insertQ_.prepare("INSERT OR IGNORE INTO segments(session_id,camera_id,camera_url,file_path,start_utc_ns,"
+                         "                               start_pts_ns,time_source,quality,status)"
+                         " VALUES(?,?,?,?,?,?,?,?,0);") &&
+        // Link to the main segment by id (known when it was opened in this
+        // run), else by path; if the sub started before its main segment
+        // was known, fall back to the latest main segment of this camera/session.
+        insertSubQ_.prepare("INSERT OR IGNORE INTO segments(session_id,camera_id,camera_url,file_path,start_utc_ns,"
+                            "                               start_pts_ns,time_source,quality,variant,main_segment_id,status)"
+                            " VALUES(?,?,?,?,?,?,?,1,1,"
+                            "  COALESCE(?, (SELECT id FROM segments WHERE file_path=?),"
+                            "           (SELECT id FROM segments WHERE session_id=? AND camera_url=?"
+                            "              AND COALESCE(variant,0)=0 AND start_utc_ns<=?"
+                            "            ORDER BY start_utc_ns DESC LIMIT 1)),"
+                            "  0);") &&
+        finalizeIdQ_.prepare("UPDATE segments SET end_utc_ns=?, duration_ms=?, size_bytes=?, status=1 WHERE id=?;") &&
+        finalizePathQ_.prepare("UPDATE segments SET end_utc_ns=?, duration_ms=?, size_bytes=?, status=1 WHERE file_path=?;") &&
+        eventQ_.prepare("INSERT INTO events(ts_utc_ns, camera_id, kind, source, detail) VALUES(?,?,?,?,?);");
+    if (!ok) qWarning() << "[DB] prepare:" << db_.lastError().text();
+    return ok;
+}
+
+void DbWriter::batch() {
+    if (inBatch_ && batched_ >= kBatchRows) flush();
+    if (!inBatch_) {
+        inBatch_ = db_.transaction();
+        batched_ = 0;
+        if (inBatch_ && flushTimer_) flushTimer_->start(kFlushMs);
+    }
+    ++batched_;
+}
+
+void DbWriter::flush() {
+    if (!inBatch_) return;
+    inBatch_ = false;
+    if (flushTimer_) flushTimer_->stop();
+    if (!db_.commit()) {
+        qWarning() << "[DB] batch commit:" << db_.lastError().text();
+        db_.rollback();
+    }
 }
 
 bool DbWriter::exec(const QString& sql) {
@@ -52,7 +118,303 @@ bool DbWriter::ensureSchema() {
          " FOREIGN KEY(camera_id) REFERENCES cameras(id) ON DELETE SET NULL );") &&
     exec("CREATE INDEX IF NOT EXISTS idx_segments_camera_time ON segments(camera_id,start_utc_ns);") &&
     exec("CREATE INDEX IF NOT EXISTS idx_segments_path ON segments(file_path);")&&
-    exec("CREATE INDEX IF NOT EXISTS idx_segments_camera_url_time ON segments(camera_url, start_utc_ns);");
+    exec("CREATE INDEX IF NOT EXISTS idx_segments_camera_url_time ON segments(camera_url, start_utc_ns);") &&
+    // PTS→wall anchor of the segment's first frame.
+    // time_source: 'ntp' (RTCP SR), 'local' (clock at first buffer), 'system' (no PTS)
+    ensureColumn("segments", "start_pts_ns", "INTEGER") &&
+    ensureColumn("segments", "time_source", "TEXT") &&
+    // 0 full (main stream), 1 substream, 2 keyframes only (degraded, disk nearly full),
+    // 3 re-encoded at reduced size (ArchiveTranscoder)
+    ensureColumn("segments", "quality", "INTEGER DEFAULT 0") &&
+    // ArchiveVerifier: 0 unchecked, 1 ok, 2 damaged/playable, 3 corrupt, 4 missing
+    ensureColumn("segments", "health", "INTEGER DEFAULT 0") &&
+    ensureColumn("segments", "health_detail", "TEXT") &&
+    ensureColumn("segments", "verified_at", "INTEGER") &&
+    // 0 main stream, 1 substream copy of the main segment main_segment_id
+    ensureColumn("segments", "variant", "INTEGER DEFAULT 0") &&
+    ensureColumn("segments", "main_segment_id", "INTEGER") &&
+    exec("CREATE INDEX IF NOT EXISTS idx_segments_main ON segments(main_segment_id);") &&
+    // ArchiveTranscoder pass done (re-encoded, replaced by the sub copy, or kept)
+    ensureColumn("segments", "aged_at", "INTEGER") &&
+    // SegmentHasher digest of the file as recorded (hex), and the per-camera
+    // chain: chain_sha256 = SHA-256(chain_prev || sha256). NULL once the file
+    // is replaced (transcoded/compacted); its chain value still links on.
+    // Deleted rows keep their links in segment_chain (v6).
+    ensureColumn("segments", "sha256", "TEXT") &&
+    ensureColumn("segments", "chain_prev", "TEXT") &&
+    ensureColumn("segments", "chain_sha256", "TEXT") &&
+    // why a finished row has no sha256 (writer died before EOS, muxer
+    // rewrote a hashed block); NULL otherwise
+    ensureColumn("segments", "hash_note", "TEXT") &&
+    migrate();
+}
+
+// Effective end of a row: end_utc_ns, else start + duration, else start
+// (an open row covers nothing yet).
+static QString effEndExpr(const QString& row) {
+    return QString("CASE WHEN %1.end_utc_ns IS NOT NULL AND %1.end_utc_ns > 0 THEN %1.end_utc_ns"
+                   " WHEN COALESCE(%1.duration_ms,0) > 0 THEN %1.start_utc_ns + %1.duration_ms*1000000"
+                   " ELSE %1.start_utc_ns END").arg(row);
+}
+
+// Versioned steps (PRAGMA user_version), each in one transaction.
+bool DbWriter::migrate() {
+    QSqlQuery q(db_);
+    const int version = (q.exec("PRAGMA user_version;") && q.next()) ? q.value(0).toInt() : 0;
+    q.finish();
+
+    if (version < 2) {
+        // v2: camera_id on every row (legacy rows only had camera_url), and
+        // the effective end materialized in eff_end_ns (kept by triggers),
+        // so a day/time-window query is one range scan of idx_segments_span.
+        db_.transaction();
+        const bool ok =
+            ensureColumn("segments", "eff_end_ns", "INTEGER") &&
+            exec("INSERT OR IGNORE INTO cameras(name, main_url)"
+                 " SELECT DISTINCT camera_url, camera_url FROM segments"
+                 " WHERE COALESCE(camera_id,0)=0 AND camera_url IS NOT NULL;") &&
+            exec("UPDATE segments SET camera_id=(SELECT id FROM cameras WHERE main_url=segments.camera_url)"
+                 " WHERE COALESCE(camera_id,0)=0;") &&
+            exec("UPDATE segments SET eff_end_ns=" + effEndExpr("segments") + ";") &&
+            exec("CREATE TRIGGER IF NOT EXISTS segments_eff_end_ins AFTER INSERT ON segments BEGIN"
+                 " UPDATE segments SET eff_end_ns=" + effEndExpr("NEW") + " WHERE id=NEW.id; END;") &&
+            exec("CREATE TRIGGER IF NOT EXISTS segments_eff_end_upd"
+                 " AFTER UPDATE OF start_utc_ns, end_utc_ns, duration_ms ON segments BEGIN"
+                 " UPDATE segments SET eff_end_ns=" + effEndExpr("NEW") + " WHERE id=NEW.id; END;") &&
+            exec("DROP INDEX IF EXISTS idx_segments_camera_time;") &&   // prefix of the new one
+            exec("CREATE INDEX IF NOT EXISTS idx_segments_span"
+                 " ON segments(camera_id, start_utc_ns, eff_end_ns);") &&
+            exec("PRAGMA user_version=2;");
+        if (!ok || !db_.commit()) {
+            db_.rollback();
+            qWarning() << "[DB] migration to v2 failed";
+            return false;
+        }
+        qInfo() << "[DB] schema v2";
+    }
+
+    if (version < 3) {
+        // v3: day_summary, one row per camera and local day (the start
+        // day of each segment), kept by triggers: calendar, camera list and
+        // heat-map read a handful of rows instead of every segment.
+        // segments/covered_ms count main-stream rows, bytes all variants.
+        // The local date is the writer's timezone at write time.
+        const auto day = [](const QString& row) {
+            return QString("strftime('%Y-%m-%d', %1.start_utc_ns/1000000000, 'unixepoch', 'localtime')").arg(row);
+        };
+        const auto counted = [](const QString& row) {
+            return QString("%1.status IN (0,1) AND %1.camera_id IS NOT NULL").arg(row);
+        };
+        // INSERT OR IGNORE + UPDATE rather than an upsert (ON CONFLICT DO
+        // UPDATE needs SQLite 3.24; some distro Qt builds link an older one)
+        const auto add = [&](const QString& row, const QString& sign) {
+            return QString("INSERT OR IGNORE INTO day_summary(camera_id, day)"
+                           " SELECT %1.camera_id, %2 WHERE %5;"
+                           " UPDATE day_summary SET"
+                           "  segments=segments + %3(COALESCE(%1.variant,0)=0),"
+                           "  covered_ms=covered_ms + %3(CASE WHEN COALESCE(%1.variant,0)=0"
+                           "   THEN (%4 - %1.start_utc_ns)/1000000 ELSE 0 END),"
+                           "  bytes=bytes + %3COALESCE(%1.size_bytes,0)"
+                           " WHERE %5 AND camera_id=%1.camera_id AND day=%2;")
+                .arg(row, day(row), sign, effEndExpr(row), counted(row));
+        };
+        db_.transaction();
+        const bool ok =
+            exec("CREATE TABLE IF NOT EXISTS day_summary ("
+                 " camera_id INTEGER NOT NULL, day TEXT NOT NULL,"
+                 " segments INTEGER NOT NULL DEFAULT 0, covered_ms INTEGER NOT NULL DEFAULT 0,"
+                 " bytes INTEGER NOT NULL DEFAULT 0,"
+                 " PRIMARY KEY(camera_id, day) ) WITHOUT ROWID;") &&
+            exec("DELETE FROM day_summary;") &&
+            exec("INSERT INTO day_summary(camera_id, day, segments, covered_ms, bytes)"
+                 " SELECT s.camera_id, " + day("s") + ","
+                 "  SUM(COALESCE(s.variant,0)=0),"
+                 "  SUM(CASE WHEN COALESCE(s.variant,0)=0 THEN (s.eff_end_ns - s.start_utc_ns)/1000000 ELSE 0 END),"
+                 "  SUM(COALESCE(s.size_bytes,0))"
+                 " FROM segments s WHERE " + counted("s") + " GROUP BY 1, 2;") &&
+            exec("CREATE TRIGGER IF NOT EXISTS day_summary_ins AFTER INSERT ON segments BEGIN "
+                 + add("NEW", "") + " END;") &&
+            exec("CREATE TRIGGER IF NOT EXISTS day_summary_del AFTER DELETE ON segments BEGIN "
+                 + add("OLD", "-") + " DELETE FROM day_summary WHERE segments<=0 AND bytes<=0; END;") &&
+            exec("CREATE TRIGGER IF NOT EXISTS day_summary_upd AFTER UPDATE OF"
+                 " camera_id, start_utc_ns, end_utc_ns, duration_ms, size_bytes, status, variant"
+                 " ON segments BEGIN "
+                 + add("OLD", "-") + add("NEW", "") +
+                 " DELETE FROM day_summary WHERE segments<=0 AND bytes<=0; END;") &&
+            exec("PRAGMA user_version=3;");
+        if (!ok || !db_.commit()) {
+            db_.rollback();
+            qWarning() << "[DB] migration to v3 failed";
+            return false;
+        }
+        qInfo() << "[DB] schema v3";
+    }
+
+    if (version < 4) {
+        // v4: day_coverage, 1 s coverage bitmap per camera and local day
+        // (CoverageBitmap), so the timeline and "who has footage at T" need
+        // no segment query. Kept by this writer (not triggers: bit work).
+        db_.transaction();
+        const bool ok =
+            exec("CREATE TABLE IF NOT EXISTS day_coverage ("
+                 " camera_id INTEGER NOT NULL, day TEXT NOT NULL, bits BLOB NOT NULL,"
+                 " PRIMARY KEY(camera_id, day) ) WITHOUT ROWID;") &&
+            exec("CREATE INDEX IF NOT EXISTS idx_day_coverage_day ON day_coverage(day);") &&
+            rebuildAllCoverage() &&
+            exec("PRAGMA user_version=4;");
+        if (!ok || !db_.commit()) {
+            db_.rollback();
+            qWarning() << "[DB] migration to v4 failed";
+            return false;
+        }
+        qInfo() << "[DB] schema v4";
+    }
+
+    if (version < 5) {
+        // v5: events, what used to go only to the log (stream errors,
+        // restarts, media, retention). Timeline overlays read one camera's
+        // window (camera_id, ts) and the global rows (camera_id NULL).
+        db_.transaction();
+        const bool ok =
+            exec("CREATE TABLE IF NOT EXISTS events ("
+                 " id INTEGER PRIMARY KEY,"
+                 " ts_utc_ns INTEGER NOT NULL,"
+                 " camera_id INTEGER REFERENCES cameras(id) ON DELETE SET NULL,"
+                 " kind INTEGER NOT NULL,"
+                 " source TEXT, detail TEXT );") &&
+            exec("CREATE INDEX IF NOT EXISTS idx_events_cam_ts ON events(camera_id, ts_utc_ns);") &&
+            exec("CREATE INDEX IF NOT EXISTS idx_events_ts ON events(ts_utc_ns);") &&
+            exec("PRAGMA user_version=5;");
+        if (!ok || !db_.commit()) {
+            db_.rollback();
+            qWarning() << "[DB] migration to v5 failed";
+            return false;
+        }
+        qInfo() << "[DB] schema v5";
+    }
+
+    if (version < 6) {
+        // v6: segment_chain, the hash chain links of hashed rows that were
+        // deleted (compaction members, consumed substream copies, retention,
+        // loop reuse, spool eviction), so a camera's chain can still be
+        // walked end to end. Kept by a trigger, whatever path deletes.
+        db_.transaction();
+        const bool ok =
+            exec("CREATE TABLE IF NOT EXISTS segment_chain ("
+                 " segment_id INTEGER PRIMARY KEY,"
+                 " camera_id INTEGER, variant INTEGER NOT NULL DEFAULT 0,"
+                 " start_utc_ns INTEGER, file_path TEXT,"
+                 " sha256 TEXT, chain_prev TEXT, chain_sha256 TEXT NOT NULL,"
+                 " removed_at INTEGER DEFAULT (strftime('%s','now')) );") &&
+            exec("CREATE INDEX IF NOT EXISTS idx_segment_chain_cam"
+                 " ON segment_chain(camera_id, variant, start_utc_ns);") &&
+            exec("CREATE TRIGGER IF NOT EXISTS segments_chain_del BEFORE DELETE ON segments"
+                 " WHEN OLD.chain_sha256 IS NOT NULL BEGIN"
+                 " INSERT OR REPLACE INTO segment_chain(segment_id, camera_id, variant, start_utc_ns,"
+                 "   file_path, sha256, chain_prev, chain_sha256)"
+                 " VALUES(OLD.id, OLD.camera_id, COALESCE(OLD.variant,0), OLD.start_utc_ns,"
+                 "   OLD.file_path, OLD.sha256, OLD.chain_prev, OLD.chain_sha256); END;") &&
+            exec("PRAGMA user_version=6;");
+        if (!ok || !db_.commit()) {
+            db_.rollback();
+            qWarning() << "[DB] migration to v6 failed";
+            return false;
+        }
+        qInfo() << "[DB] schema v6";
+    }
+    return true;
+}
+
+void DbWriter::addCoverage(int camId, qint64 startNs, qint64 endNs) {
+    if (camId <= 0 || endNs <= startNs) return;
+    for (QDate day = CoverageBitmap::localDay(startNs);
+         day.isValid() && CoverageBitmap::dayStartNs(day) < endNs; day = day.addDays(1)) {
+        const QString ymd = day.toString("yyyy-MM-dd");
+        const qint64 d0 = CoverageBitmap::dayStartNs(day);
+        QSqlQuery q(db_);
+        q.prepare("SELECT bits FROM day_coverage WHERE camera_id=? AND day=?;");
+        q.addBindValue(camId);
+        q.addBindValue(ymd);
+        CoverageBitmap bits = (q.exec() && q.next()) ? CoverageBitmap::unpack(q.value(0).toByteArray())
+                                                     : CoverageBitmap();
+        q.finish();
+        bits.setRange((startNs - d0) / 1000000000LL, (endNs - d0 + 999999999LL) / 1000000000LL);
+        if (bits.isEmpty()) continue;
+        q.prepare("INSERT OR REPLACE INTO day_coverage(camera_id, day, bits) VALUES(?,?,?);");
+        q.addBindValue(camId);
+        q.addBindValue(ymd);
+        q.addBindValue(bits.pack());
+        if (!q.exec()) qWarning() << "[DB] coverage:" << q.lastError().text();
+    }
+}
+
+void DbWriter::rebuildCoverage(int camId, const QDate& day) {
+    const qint64 d0 = CoverageBitmap::dayStartNs(day);
+    const qint64 d1 = CoverageBitmap::dayStartNs(day.addDays(1));
+    QSqlQuery q(db_);
+    q.setForwardOnly(true);
+    // same window as DbReader::listSegments (spans are at most a day)
+    q.prepare("SELECT start_utc_ns, eff_end_ns FROM segments"
+              " WHERE camera_id=? AND start_utc_ns>=? AND start_utc_ns<? AND eff_end_ns>?"
+              "   AND status IN (0,1) AND COALESCE(variant,0)=0;");
+    q.addBindValue(camId);
+    q.addBindValue(d0 - 24LL * 3600 * 1000000000LL);
+    q.addBindValue(d1);
+    q.addBindValue(d0);
+    if (!q.exec()) { qWarning() << "[DB] coverage rebuild:" << q.lastError().text(); return; }
+    CoverageBitmap bits;
+    while (q.next()) {
+        const qint64 s = q.value(0).toLongLong(), e = q.value(1).toLongLong();
+        bits.setRange((s - d0) / 1000000000LL, (e - d0 + 999999999LL) / 1000000000LL);
+    }
+    QSqlQuery w(db_);
+    if (bits.isEmpty()) {
+        w.prepare("DELETE FROM day_coverage WHERE camera_id=? AND day=?;");
+        w.addBindValue(camId);
+        w.addBindValue(day.toString("yyyy-MM-dd"));
+    } else {
+        w.prepare("INSERT OR REPLACE INTO day_coverage(camera_id, day, bits) VALUES(?,?,?);");
+        w.addBindValue(camId);
+        w.addBindValue(day.toString("yyyy-MM-dd"));
+        w.addBindValue(bits.pack());
+    }
+    if (!w.exec()) qWarning() << "[DB] coverage rebuild:" << w.lastError().text();
+}
+
+bool DbWriter::rebuildAllCoverage() {
+    const QSet<QPair<int, QDate>> days = coverageDays("1", QVariantList());
+    if (!exec("DELETE FROM day_coverage;")) return false;
+    for (const auto& d : days) rebuildCoverage(d.first, d.second);
+    return true;
+}
+
+QSet<QPair<int, QDate>> DbWriter::coverageDays(const QString& where, const QVariantList& binds) {
+    QSet<QPair<int, QDate>> out;
+    QSqlQuery q(db_);
+    q.setForwardOnly(true);
+    q.prepare("SELECT s.camera_id, s.start_utc_ns, s.eff_end_ns FROM segments s"
+              " WHERE COALESCE(s.variant,0)=0 AND s.camera_id IS NOT NULL AND (" + where + ");");
+    for (const QVariant& v : binds) q.addBindValue(v);
+    if (!q.exec()) { qWarning() << "[DB] coverage days:" << q.lastError().text(); return out; }
+    while (q.next()) {
+        const int cam = q.value(0).toInt();
+        const qint64 s = q.value(1).toLongLong();
+        const qint64 e = qMax(s, q.value(2).toLongLong());
+        for (QDate d = CoverageBitmap::localDay(s); d.isValid() && d <= CoverageBitmap::localDay(e);
+             d = d.addDays(1))
+            out.insert({ cam, d });
+    }
+    return out;
+}
+
+// Columns added after the first release; ALTER only when missing.
+bool DbWriter::ensureColumn(const QString& table, const QString& column, const QString& decl) {
+    QSqlQuery q(db_);
+    if (!q.exec(QString("PRAGMA table_info(%1);").arg(table))) return false;
+    while (q.next()) {
+        if (q.value(1).toString() == column) return true;
+    }
+    return exec(QString("ALTER TABLE %1 ADD COLUMN %2 %3;").arg(table, column, decl));
 }
 
 void DbWriter::ensureCamera(const QString& mainUrl, const QString& subUrl, const QString& name) {
@@ -63,6 +425,7 @@ void DbWriter::ensureCamera(const QString& mainUrl, const QString& subUrl, const
     q.addBindValue(mainUrl);
     q.addBindValue(subUrl);
     if (!q.exec()) qWarning() << "[DB] ensureCamera:" << q.lastError().text();
+    cameraIds_.remove(mainUrl);
 }
 
 void DbWriter::beginSession(const QString& sessionId, const QString& archiveDir, int segmentSec) {
@@ -75,40 +438,573 @@ void DbWriter::beginSession(const QString& sessionId, const QString& archiveDir,
     if (!q.exec()) qWarning() << "[DB] beginSession:" << q.lastError().text();
 }
 
-static int cameraIdForUrl(QSqlDatabase& db, const QString& url) {
-    QSqlQuery q(db);
-    q.prepare("SELECT id FROM cameras WHERE main_url=?;");
-    q.addBindValue(url);
-    if (q.exec() && q.next()) return q.value(0).toInt();
-    return 0;
+// camera_id is mandatory (schema v2): a URL nobody registered gets a row
+// named after itself; ensureCamera fills in the name later.
+int DbWriter::cameraId(const QString& url) {
+    const auto it = cameraIds_.constFind(url);
+    if (it != cameraIds_.constEnd()) return it.value();
+    cameraQ_.addBindValue(url);
+    int id = (cameraQ_.exec() && cameraQ_.next()) ? cameraQ_.value(0).toInt() : 0;
+    cameraQ_.finish();
+    if (!id) {
+        QSqlQuery q(db_);
+        q.prepare("INSERT INTO cameras(name, main_url) VALUES(?,?);");
+        q.addBindValue(url);
+        q.addBindValue(url);
+        if (q.exec()) id = q.lastInsertId().toInt();
+        else qWarning() << "[DB] camera for" << url << ":" << q.lastError().text();
+    }
+    if (id) cameraIds_.insert(url, id);
+    return id;
 }
 
 void DbWriter::addSegmentOpened(const QString& sessionId, const QString& cameraUrl,
-                                const QString& filePath, qint64 startUtcNs) {
-    const int camId = cameraIdForUrl(db_, cameraUrl);
-    QSqlQuery q(db_);
-    q.prepare("INSERT OR IGNORE INTO segments(session_id,camera_id,camera_url,file_path,start_utc_ns,status)"
-              " VALUES(?,?,?,?,?,0);");
+                                const QString& filePath, qint64 startUtcNs,
+                                qint64 startPtsNs, const QString& timeSource, int quality) {
+    const int camId = cameraId(cameraUrl);
+    batch();
+    QSqlQuery& q = insertQ_;
     q.addBindValue(sessionId);
     q.addBindValue(camId);
     q.addBindValue(cameraUrl);
     q.addBindValue(filePath);
     q.addBindValue(startUtcNs);
+    q.addBindValue(startPtsNs >= 0 ? QVariant(startPtsNs) : QVariant());
+    q.addBindValue(timeSource);
+    q.addBindValue(quality);
     if (!q.exec()) qWarning() << "[DB] addSegmentOpened:" << q.lastError().text();
+    else if (q.numRowsAffected() == 1)
+        openRows_.insert(filePath, { q.lastInsertId().toLongLong(), camId, startUtcNs, true });
+}
+
+void DbWriter::addSubSegmentOpened(const QString& sessionId, const QString& cameraUrl,
+                                   const QString& filePath, qint64 startUtcNs,
+                                   qint64 startPtsNs, const QString& timeSource,
+                                   const QString& mainFilePath) {
+    const int camId = cameraId(cameraUrl);
+    const qint64 mainId = openRows_.value(mainFilePath).id;
+    batch();
+    QSqlQuery& q = insertSubQ_;
+    q.addBindValue(sessionId);
+    q.addBindValue(camId);
+    q.addBindValue(cameraUrl);
+    q.addBindValue(filePath);
+    q.addBindValue(startUtcNs);
+    q.addBindValue(startPtsNs >= 0 ? QVariant(startPtsNs) : QVariant());
+    q.addBindValue(timeSource);
+    q.addBindValue(mainId > 0 ? QVariant(mainId) : QVariant());
+    q.addBindValue(mainFilePath);
+    q.addBindValue(sessionId);
+    q.addBindValue(cameraUrl);
+    q.addBindValue(startUtcNs);
+    if (!q.exec()) qWarning() << "[DB] addSubSegmentOpened:" << q.lastError().text();
+    else if (q.numRowsAffected() == 1)
+        openRows_.insert(filePath, { q.lastInsertId().toLongLong(), camId, startUtcNs, false });
 }
 
 void DbWriter::finalizeSegmentByPath(const QString& filePath, qint64 endUtcNs, qint64 durationMs) {
-    const qint64 size = QFileInfo(filePath).exists() ? QFileInfo(filePath).size() : 0;
-    QSqlQuery q(db_);
-    q.prepare("UPDATE segments SET end_utc_ns=?, duration_ms=?, size_bytes=?, status=1 WHERE file_path=?;");
+    const QFileInfo fi(filePath);
+    const qint64 size = fi.exists() ? fi.size() : 0;
+    // by rowid when it was opened in this run; by path for older rows
+    OpenRow row = openRows_.take(filePath);
+    batch();
+    QSqlQuery& q = row.id > 0 ? finalizeIdQ_ : finalizePathQ_;
     q.addBindValue(endUtcNs);
     q.addBindValue(durationMs);
     q.addBindValue(size);
-    q.addBindValue(filePath);
-    if (!q.exec()) qWarning() << "[DB] finalizeSegment:" << q.lastError().text();
+    if (row.id > 0) q.addBindValue(row.id);
+    else            q.addBindValue(filePath);
+    if (!q.exec()) {
+        qWarning() << "[DB] finalizeSegment:" << q.lastError().text();
+        return;
+    }
+    if (row.id <= 0) {
+        QSqlQuery r(db_);
+        r.prepare("SELECT camera_id, start_utc_ns, COALESCE(variant,0)=0 FROM segments WHERE file_path=?;");
+        r.addBindValue(filePath);
+        if (!r.exec() || !r.next()) return;
+        row.camId   = r.value(0).toInt();
+        row.startNs = r.value(1).toLongLong();
+        row.main    = r.value(2).toBool();
+    }
+    const qint64 endNs = endUtcNs > 0 ? endUtcNs : row.startNs + durationMs * 1000000LL;
+    if (row.main) addCoverage(row.camId, row.startNs, endNs);
 }
 
 void DbWriter::markError(const QString& where, const QString& detail) {
-    Q_UNUSED(where); Q_UNUSED(detail);
-    // Hook for future 'events' table.
+    addEvent(EventKind::Error, 0, 0, where, detail);
+}
+
+void DbWriter::logEvent(int kind, const QString& cameraUrl, qint64 tsUtcNs,
+                        const QString& source, const QString& detail) {
+    addEvent(EventKind(kind), cameraUrl.isEmpty() ? 0 : cameraId(cameraUrl), tsUtcNs, source, detail);
+}
+
+void DbWriter::addEvent(EventKind kind, int camId, qint64 tsUtcNs, const QString& source,
+                        const QString& detail) {
+    if (tsUtcNs <= 0) tsUtcNs = QDateTime::currentMSecsSinceEpoch() * 1000000LL;
+    batch();
+    QSqlQuery& q = eventQ_;
+    q.addBindValue(tsUtcNs);
+    q.addBindValue(camId > 0 ? QVariant(camId) : QVariant());
+    q.addBindValue(int(kind));
+    q.addBindValue(source);
+    q.addBindValue(detail);
+    if (!q.exec()) qWarning() << "[DB] event:" << q.lastError().text();
+}
+
+namespace {
+struct OpenSegment {
+    qint64  id = 0;
+    QString path;
+    qint64  startNs = 0;
+    // filled by the probe
+    qint64  durationMs = 0;
+    qint64  sizeBytes = 0;
+    bool    missing = false;
+};
+}
+
+// Derive the real length of a segment whose writer never closed it.
+// Cluster timestamps from the file tail are exact; mtime is the fallback for
+// files we can't parse (non-MKV, or the tail is garbage).
+static OpenSegment probeOpenSegment(OpenSegment s) {
+    const QFileInfo fi(s.path);
+    if (!fi.exists()) { s.missing = true; return s; }
+    s.sizeBytes = fi.size();
+
+    mkvprobe::TailInfo tail;
+    if (mkvprobe::readTail(s.path, &tail) && tail.durationNs() > 0) {
+        s.durationMs = tail.durationNs() / 1000000LL;
+    } else {
+        const qint64 mtimeNs = fi.lastModified().toMSecsSinceEpoch() * 1000000LL;
+        s.durationMs = qMax<qint64>(0, (mtimeNs - s.startNs) / 1000000LL);
+    }
+    return s;
+}
+
+int DbWriter::recoverOpenSegments() {
+    flush();
+    QVector<OpenSegment> open;
+    {
+        QSqlQuery q(db_);
+        q.setForwardOnly(true);
+        if (!q.exec("SELECT id, file_path, start_utc_ns FROM segments WHERE status=0;")) {
+            qWarning() << "[DB] recoverOpenSegments:" << q.lastError().text();
+            return 0;
+        }
+        while (q.next()) {
+            OpenSegment s;
+            s.id      = q.value(0).toLongLong();
+            s.path    = q.value(1).toString();
+            s.startNs = q.value(2).toLongLong();
+            open.push_back(s);
+        }
+    }
+    if (open.isEmpty()) return 0;
+
+    // Files are independent: probe them in parallel (each reads only head + tail).
+    const QVector<OpenSegment> probed = QtConcurrent::blockingMapped(open, probeOpenSegment);
+
+    db_.transaction();
+    QSqlQuery fin(db_);
+    // never reached EOS, so no digest was taken: say so rather than leave a gap
+    fin.prepare("UPDATE segments SET end_utc_ns=?, duration_ms=?, size_bytes=?, status=1,"
+                " hash_note=CASE WHEN sha256 IS NULL THEN 'no EOS (recovered)' END WHERE id=?;");
+    QSqlQuery gone(db_);
+    gone.prepare("UPDATE segments SET status=2 WHERE id=?;");   // 2 = file missing
+    int recovered = 0;
+    QStringList recoveredIds;
+    for (const auto& s : probed) {
+        QSqlQuery& q = s.missing ? gone : fin;
+        if (!s.missing) {
+            q.addBindValue(s.startNs + s.durationMs * 1000000LL);
+            q.addBindValue(s.durationMs);
+            q.addBindValue(s.sizeBytes);
+        }
+        q.addBindValue(s.id);
+        if (!q.exec()) qWarning() << "[DB] recover" << s.path << ":" << q.lastError().text();
+        else if (!s.missing) { ++recovered; recoveredIds << QString::number(s.id); }
+    }
+    if (!db_.commit()) {
+        qWarning() << "[DB] recover commit:" << db_.lastError().text();
+        db_.rollback();
+        return 0;
+    }
+    if (!recoveredIds.isEmpty()) {
+        batch();
+        for (const auto& d : coverageDays("s.id IN (" + recoveredIds.join(',') + ")", QVariantList()))
+            rebuildCoverage(d.first, d.second);
+    }
+    qInfo() << "[DB] recovered" << recovered << "of" << probed.size() << "open segments";
+    return recovered;
+}
+
+// The maintenance calls below are blocking calls from other workers that
+// act on files right after: commit the open batch first (the finalize that
+// closed the row may still be in it), and have their own change committed
+// when they return.
+bool DbWriter::relocateSegment(const QString& oldPath, const QString& newPath) {
+    flush();
+    QSqlQuery q(db_);
+    // closed rows only: finalize may still address an open row by its path
+    q.prepare("UPDATE segments SET file_path=?, size_bytes=? WHERE file_path=? AND status<>0;");
+    q.addBindValue(newPath);
+    q.addBindValue(QFileInfo(newPath).size());
+    q.addBindValue(oldPath);
+    if (!q.exec()) {
+        qWarning() << "[DB] relocateSegment:" << q.lastError().text();
+        return false;
+    }
+    if (q.numRowsAffected() != 1) {
+        qWarning() << "[DB] relocateSegment: no closed row for" << oldPath;
+        return false;
+    }
+    openRows_.remove(oldPath);
+    return true;
+}
+
+int DbWriter::segmentStatus(const QString& filePath) {
+    flush();
+    QSqlQuery q(db_);
+    q.prepare("SELECT status FROM segments WHERE file_path=?;");
+    q.addBindValue(filePath);
+    if (!q.exec()) {
+        qWarning() << "[DB] segmentStatus:" << q.lastError().text();
+        return 0;                       // unknown: treat as still open
+    }
+    return q.next() ? q.value(0).toInt() : -1;
+}
+
+bool DbWriter::deleteSegment(const QString& filePath) {
+    flush();
+    batch();
+    const auto days = coverageDays("s.file_path=?", { filePath });
+    QSqlQuery q(db_);
+    q.prepare("DELETE FROM segments WHERE file_path=?;");
+    q.addBindValue(filePath);
+    if (!q.exec()) {
+        qWarning() << "[DB] deleteSegment:" << q.lastError().text();
+        flush();
+        return false;
+    }
+    openRows_.remove(filePath);
+    QSet<int> cams;
+    for (const auto& d : days) {
+        rebuildCoverage(d.first, d.second);
+        cams.insert(d.first);
+    }
+    for (int cam : cams) addEvent(EventKind::Retention, cam, 0, "spool", QString("evicted %1").arg(filePath));
+    flush();
+    return true;
+}
+
+void DbWriter::importArchiveDb(const QString& archiveDir) {
+    const QString legacy = archiveDir + "/camvigil.sqlite";
+    if (!QFileInfo::exists(legacy)) return;
+    if (QFileInfo(legacy).canonicalFilePath() == QFileInfo(db_.databaseName()).canonicalFilePath()) return;
+    flush();                        // ATTACH is not allowed inside a transaction
+
+    QSqlQuery q(db_);
+    q.prepare("ATTACH DATABASE ? AS ext;");
+    q.addBindValue(legacy);
+    if (!q.exec()) { qWarning() << "[DB] import attach:" << q.lastError().text(); return; }
+
+    const bool ok =
+        exec("INSERT OR IGNORE INTO cameras(name, main_url, sub_url)"
+             " SELECT name, main_url, sub_url FROM ext.cameras;") &&
+        exec("INSERT OR IGNORE INTO cameras(name, main_url)"
+             " SELECT DISTINCT camera_url, camera_url FROM ext.segments WHERE camera_url IS NOT NULL;") &&
+        exec("INSERT OR IGNORE INTO segments(camera_id,camera_url,file_path,start_utc_ns,"
+             "                               end_utc_ns,duration_ms,size_bytes,status)"
+             " SELECT c.id, s.camera_url, s.file_path, s.start_utc_ns,"
+             "        s.end_utc_ns, s.duration_ms, s.size_bytes, s.status"
+             " FROM ext.segments s LEFT JOIN cameras c ON c.main_url = s.camera_url;");
+    exec("DETACH DATABASE ext;");
+    if (ok) {
+        db_.transaction();
+        if (!rebuildAllCoverage() || !db_.commit()) db_.rollback();
+        // Don't import again; keep the file for forensic purposes.
+        QFile::rename(legacy, legacy + ".imported");
+        qInfo() << "[DB] imported legacy archive DB" << legacy;
+    }
+}
+
+bool DbWriter::replaceSegmentFile(qint64 id, const QString& oldPath, const QString& newPath,
+                                  int quality, const QString& consumedSubPath) {
+    flush();
+    db_.transaction();
+    QSqlQuery del(db_);
+    // the substream row whose file became the main file goes away
+    del.prepare("DELETE FROM segments WHERE main_segment_id=? AND file_path=?;");
+    del.addBindValue(id);
+    del.addBindValue(consumedSubPath);
+    QSqlQuery q(db_);
+    q.prepare("UPDATE segments SET file_path=?, size_bytes=?, quality=?, health=0,"
+              "  health_detail=NULL, verified_at=NULL, aged_at=strftime('%s','now'), sha256=NULL"
+              " WHERE id=? AND file_path=?;");
+    q.addBindValue(newPath);
+    q.addBindValue(QFileInfo(newPath).size());
+    q.addBindValue(quality);
+    q.addBindValue(id);
+    q.addBindValue(oldPath);
+    if (!del.exec() || !q.exec() || q.numRowsAffected() != 1) {
+        qWarning() << "[DB] replaceSegmentFile:" << oldPath << del.lastError().text() << q.lastError().text();
+        db_.rollback();
+        return false;
+    }
+    return db_.commit();
+}
+
+qint64 DbWriter::replaceSegments(const QVariantList& ids, const QString& mergedPath,
+                                 const QString& mergedSubPath) {
+    if (ids.size() < 2) return 0;
+    QStringList idList;
+    for (const QVariant& v : ids) idList << QString::number(v.toLongLong());
+    const QString in = idList.join(',');
+    const QString first = idList.first();
+
+    flush();
+    db_.transaction();
+    auto fail = [this](const QSqlQuery& q) {
+        qWarning() << "[DB] replaceSegments:" << q.lastError().text();
+        db_.rollback();
+        return qint64(0);
+    };
+    QSqlQuery q(db_);
+    // members must be untouched since the compactor read them
+    if (!q.exec(QString("SELECT COUNT(*) FROM segments WHERE id IN (%1)"
+                        " AND status=1 AND aged_at IS NULL;").arg(in)) || !q.next())
+        return fail(q);
+    if (q.value(0).toInt() != ids.size()) {
+        db_.rollback();
+        return 0;
+    }
+
+    // The merged row spans the members' links (chain_prev of the first,
+    // chain_sha256 of the last hashed one) so later segments chain on; the
+    // members themselves move to segment_chain when deleted below.
+    q.prepare(QString(
+        "INSERT INTO segments(session_id,camera_id,camera_url,file_path,start_utc_ns,end_utc_ns,"
+        "                     duration_ms,size_bytes,status,start_pts_ns,time_source,quality,variant,"
+        "                     chain_prev,chain_sha256)"
+        " SELECT session_id,camera_id,camera_url,?,start_utc_ns,"
+        "        (SELECT MAX(end_utc_ns) FROM segments WHERE id IN (%1)),"
+        "        (SELECT SUM(duration_ms) FROM segments WHERE id IN (%1)),"
+        "        ?,1,start_pts_ns,time_source,quality,0,chain_prev,"
+        "        (SELECT chain_sha256 FROM segments WHERE id IN (%1) AND chain_sha256 IS NOT NULL"
+        "          ORDER BY start_utc_ns DESC LIMIT 1)"
+        " FROM segments WHERE id=%2;").arg(in, first));
+    q.addBindValue(mergedPath);
+    q.addBindValue(QFileInfo(mergedPath).size());
+    if (!q.exec()) return fail(q);
+    const qint64 newId = q.lastInsertId().toLongLong();
+
+    if (!mergedSubPath.isEmpty()) {
+        q.prepare(QString(
+            "INSERT INTO segments(session_id,camera_id,camera_url,file_path,start_utc_ns,end_utc_ns,"
+            "                     duration_ms,size_bytes,status,start_pts_ns,time_source,quality,"
+            "                     variant,main_segment_id,chain_prev,chain_sha256)"
+            " SELECT session_id,camera_id,camera_url,?,start_utc_ns,"
+            "        (SELECT MAX(end_utc_ns) FROM segments WHERE main_segment_id IN (%1)),"
+            "        (SELECT SUM(duration_ms) FROM segments WHERE main_segment_id IN (%1)),"
+            "        ?,1,start_pts_ns,time_source,quality,1,?,chain_prev,"
+            "        (SELECT chain_sha256 FROM segments WHERE main_segment_id IN (%1)"
+            "          AND chain_sha256 IS NOT NULL ORDER BY start_utc_ns DESC LIMIT 1)"
+            " FROM segments WHERE main_segment_id=%2 ORDER BY start_utc_ns LIMIT 1;").arg(in, first));
+        q.addBindValue(mergedSubPath);
+        q.addBindValue(QFileInfo(mergedSubPath).size());
+        q.addBindValue(newId);
+        if (!q.exec()) return fail(q);
+    }
+
+    if (!q.exec(QString("DELETE FROM segments WHERE main_segment_id IN (%1);").arg(in)) ||
+        !q.exec(QString("DELETE FROM segments WHERE id IN (%1);").arg(in)))
+        return fail(q);
+    if (!db_.commit()) return fail(q);
+    // concat closes the (sub-second) gaps between members
+    for (const auto& d : coverageDays("s.id=?", { newId })) rebuildCoverage(d.first, d.second);
+    return newId;
+}
+
+int DbWriter::deleteSegmentsUnder(const QString& dirPrefix) {
+    flush();
+    batch();
+    const auto days = coverageDays("substr(s.file_path,1,?)=?", { dirPrefix.size(), dirPrefix });
+    QSqlQuery q(db_);
+    q.prepare("DELETE FROM segments WHERE substr(file_path,1,?)=?;");
+    q.addBindValue(dirPrefix.size());
+    q.addBindValue(dirPrefix);
+    if (!q.exec()) {
+        qWarning() << "[DB] deleteSegmentsUnder:" << q.lastError().text();
+        flush();
+        return 0;
+    }
+    const int rows = q.numRowsAffected();
+    for (auto it = openRows_.begin(); it != openRows_.end();) {
+        if (it.key().startsWith(dirPrefix)) it = openRows_.erase(it);
+        else ++it;
+    }
+    QHash<int, QDate> lastDay;            // per camera: latest day removed
+    for (const auto& d : days) {
+        rebuildCoverage(d.first, d.second);
+        QDate& last = lastDay[d.first];
+        if (!last.isValid() || d.second > last) last = d.second;
+    }
+    // the camera's events go with its footage (nothing older is left either)
+    QSqlQuery ev(db_);
+    ev.prepare("DELETE FROM events WHERE camera_id=? AND ts_utc_ns < ?;");   // idx_events_cam_ts
+    for (auto it = lastDay.cbegin(); it != lastDay.cend(); ++it) {
+        ev.addBindValue(it.key());
+        ev.addBindValue(CoverageBitmap::dayStartNs(it.value().addDays(1)));
+        if (!ev.exec()) qWarning() << "[DB] deleteSegmentsUnder events:" << ev.lastError().text();
+        addEvent(EventKind::Retention, it.key(), 0, "retention", QString("removed %1").arg(dirPrefix));
+    }
+    pruneGlobalEvents();
+    flush();
+    return rows;
+}
+
+void DbWriter::pruneGlobalEvents() {
+    const qint64 cutoffNs =
+        (QDateTime::currentMSecsSinceEpoch() - qint64(kGlobalEventDays) * 86400000LL) * 1000000LL;
+    batch();
+    QSqlQuery q(db_);
+    q.prepare("DELETE FROM events WHERE camera_id IS NULL AND ts_utc_ns < ?;");   // idx_events_cam_ts
+    q.addBindValue(cutoffNs);
+    if (!q.exec()) qWarning() << "[DB] pruneGlobalEvents:" << q.lastError().text();
+}
+
+int DbWriter::countSegmentsUnder(const QString& dirPrefix) {
+    QSqlQuery q(db_);
+    q.prepare("SELECT COUNT(*) FROM segments WHERE substr(file_path,1,?)=?;");
+    q.addBindValue(dirPrefix.size());
+    q.addBindValue(dirPrefix);
+    if (!q.exec() || !q.next()) {
+        qWarning() << "[DB] countSegmentsUnder:" << q.lastError().text();
+        return 0;
+    }
+    return q.value(0).toInt();
+}
+
+QString DbWriter::takeOldestSegmentUnder(const QString& dirPrefix) {
+    flush();
+    QSqlQuery q(db_);
+    // closed rows only: an open one is still being written
+    q.prepare("SELECT id, file_path FROM segments"
+              " WHERE substr(file_path,1,?)=? AND status<>0"
+              " ORDER BY start_utc_ns LIMIT 1;");
+    q.addBindValue(dirPrefix.size());
+    q.addBindValue(dirPrefix);
+    if (!q.exec()) {
+        qWarning() << "[DB] takeOldestSegmentUnder:" << q.lastError().text();
+        return QString();
+    }
+    if (!q.next()) return QString();
+    const qint64  id   = q.value(0).toLongLong();
+    const QString path = q.value(1).toString();
+    q.finish();
+    batch();
+    const auto days = coverageDays("s.id=?", { id });
+    QSqlQuery del(db_);
+    del.prepare("DELETE FROM segments WHERE id=?;");
+    del.addBindValue(id);
+    if (!del.exec()) {
+        qWarning() << "[DB] takeOldestSegmentUnder:" << del.lastError().text();
+        flush();
+        return QString();
+    }
+    openRows_.remove(path);
+    QSet<int> cams;
+    for (const auto& d : days) {
+        rebuildCoverage(d.first, d.second);
+        cams.insert(d.first);
+    }
+    for (int cam : cams) addEvent(EventKind::Retention, cam, 0, "loop", QString("reused %1").arg(path));
+    flush();
+    return path;
+}
+
+void DbWriter::setSegmentHash(const QString& filePath, const QByteArray& sha256) {
+    batch();
+    if (sha256.isEmpty()) {
+        QSqlQuery q(db_);
+        q.prepare("UPDATE segments SET hash_note='rewritten block unreadable at finalize' WHERE file_path=?;");
+        q.addBindValue(filePath);
+        if (!q.exec()) qWarning() << "[DB] setSegmentHash:" << q.lastError().text();
+        return;
+    }
+    // previous link: latest earlier segment of this camera stream with a
+    // chain, whether its row is still there or already in segment_chain
+    QSqlQuery prev(db_);
+    prev.prepare("SELECT chain_sha256 FROM ("
+                 " SELECT p.chain_sha256, p.start_utc_ns FROM segments s JOIN segments p"
+                 "   ON p.camera_id = s.camera_id"
+                 "  AND COALESCE(p.variant,0) = COALESCE(s.variant,0)"
+                 "  WHERE s.file_path=? AND p.chain_sha256 IS NOT NULL"
+                 "    AND p.start_utc_ns < s.start_utc_ns"
+                 " UNION ALL"
+                 " SELECT c.chain_sha256, c.start_utc_ns FROM segments s JOIN segment_chain c"
+                 "   ON c.camera_id = s.camera_id AND c.variant = COALESCE(s.variant,0)"
+                 "  WHERE s.file_path=? AND c.start_utc_ns < s.start_utc_ns)"
+                 " ORDER BY start_utc_ns DESC LIMIT 1;");
+    prev.addBindValue(filePath);
+    prev.addBindValue(filePath);
+    if (!prev.exec()) {
+        qWarning() << "[DB] setSegmentHash:" << prev.lastError().text();
+        return;
+    }
+    const QByteArray prevChain = prev.next() ? QByteArray::fromHex(prev.value(0).toByteArray())
+                                             : QByteArray();
+    const QByteArray chain = SegmentHasher::chain(prevChain, sha256);
+
+    QSqlQuery q(db_);
+    q.prepare("UPDATE segments SET sha256=?, chain_prev=?, chain_sha256=?, hash_note=NULL WHERE file_path=?;");
+    q.addBindValue(QString::fromLatin1(sha256.toHex()));
+    q.addBindValue(prevChain.isEmpty() ? QVariant() : QVariant(QString::fromLatin1(prevChain.toHex())));
+    q.addBindValue(QString::fromLatin1(chain.toHex()));
+    q.addBindValue(filePath);
+    if (!q.exec()) qWarning() << "[DB] setSegmentHash:" << q.lastError().text();
+    else if (q.numRowsAffected() == 0) qWarning() << "[DB] setSegmentHash: no row for" << filePath;
+}
+
+void DbWriter::markAged(qint64 id) {
+    QSqlQuery q(db_);
+    q.prepare("UPDATE segments SET aged_at=strftime('%s','now') WHERE id=?;");
+    q.addBindValue(id);
+    if (!q.exec()) qWarning() << "[DB] markAged:" << q.lastError().text();
+}
+
+void DbWriter::setSegmentHealth(qint64 id, const QString& filePath, int health, const QString& detail) {
+    QSqlQuery q(db_);
+    q.prepare("UPDATE segments SET health=?, health_detail=?, verified_at=strftime('%s','now')"
+              " WHERE id=? AND file_path=?;");
+    q.addBindValue(health);
+    q.addBindValue(detail.isEmpty() ? QVariant() : QVariant(detail));
+    q.addBindValue(id);
+    q.addBindValue(filePath);
+    if (!q.exec()) qWarning() << "[DB] setSegmentHealth:" << q.lastError().text();
+}
+
+void DbWriter::summarizeArchive() {
+    ArchiveSummary out;
+    QSqlQuery q(db_);
+    q.setForwardOnly(true);
+    // one row per camera-day: no segment rows touched
+    if (!q.exec("SELECT c.name, COUNT(*), MIN(d.day), SUM(d.covered_ms), SUM(d.bytes)"
+                " FROM day_summary d JOIN cameras c ON c.id = d.camera_id"
+                " WHERE d.segments > 0 GROUP BY d.camera_id ORDER BY c.name;")) {
+        qWarning() << "[DB] summarizeArchive:" << q.lastError().text();
+        return;
+    }
+    while (q.next()) {
+        ArchivedCamera c;
+        c.name      = q.value(0).toString();
+        c.days      = q.value(1).toInt();
+        c.firstDay  = q.value(2).toString();
+        c.coveredMs = q.value(3).toLongLong();
+        c.bytes     = q.value(4).toLongLong();
+        out.push_back(c);
+    }
+    emit archiveSummary(out);
 }
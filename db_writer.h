@@ -1,8 +1,38 @@
 #pragma once
+#include <QByteArray>
+#include <QDate>
+#include <QHash>
 #include <QObject>
+#include <QSet>
 #include <QSqlDatabase>
+#include <QSqlQuery>
 #include <QString>
+#include <QVariantList>
+#include <QVector>
+#include "db_events.h"
 
+class QTimer;
+
+// One camera's footage in the DB, from day_summary (storage view).
+struct ArchivedCamera {
+    QString name;
+    int     days = 0;
+    QString firstDay;        // local YYYY-MM-DD
+    qint64  coveredMs = 0;
+    qint64  bytes = 0;
+};
+using ArchiveSummary = QVector<ArchivedCamera>;
+Q_DECLARE_METATYPE(ArchiveSummary)
+
+// Single writer of the recording DB; lives on its own thread, everything
+// else reaches it through queued/blocking invokes.
+//
+// The per-segment writes (open, finalize, hash) are batched: they join one
+// transaction that is committed after kBatchRows statements or kFlushMs,
+// whichever comes first, so a busy recorder costs one fsync per batch
+// instead of one per row. Slots that run their own transaction commit the
+// batch first. Their statements are prepared once, camera ids are cached,
+// and a segment opened in this run is finalized by its rowid.
 class DbWriter : public QObject {
     Q_OBJECT
 public:
@@ -14,12 +44,91 @@ public slots:
     void ensureCamera(const QString& mainUrl, const QString& subUrl, const QString& name);
     void beginSession(const QString& sessionId, const QString& archiveDir, int segmentSec);
     void addSegmentOpened(const QString& sessionId, const QString& cameraUrl,
-                          const QString& filePath, qint64 startUtcNs);
+                          const QString& filePath, qint64 startUtcNs,
+                          qint64 startPtsNs, const QString& timeSource, int quality);
+    // Substream copy, linked to its main segment (variant=1, main_segment_id).
+    void addSubSegmentOpened(const QString& sessionId, const QString& cameraUrl,
+                             const QString& filePath, qint64 startUtcNs,
+                             qint64 startPtsNs, const QString& timeSource,
+                             const QString& mainFilePath);
     void finalizeSegmentByPath(const QString& filePath, qint64 endUtcNs, qint64 durationMs);
-    void markError(const QString& where, const QString& detail);
+    void markError(const QString& where, const QString& detail);   // EventKind::Error
+    // events row (schema v5), batched like the segment writes. kind is an
+    // EventKind; cameraUrl "" = not tied to a camera; tsUtcNs <= 0 = now.
+    void logEvent(int kind, const QString& cameraUrl, qint64 tsUtcNs,
+                  const QString& source, const QString& detail);
+    // Startup pass: finalize rows left at status=0 by a crash/power cut.
+    int  recoverOpenSegments();
+    // Segment moved (spool → archive): path + size in one statement. False
+    // unless exactly one closed (status<>0) row had oldPath.
+    bool relocateSegment(const QString& oldPath, const QString& newPath);
+    // status of the row with that path (0 open, 1 closed, 2 missing); -1 = no row
+    int  segmentStatus(const QString& filePath);
+    // Spool cap (ArchiveMigrator): drop one row by path.
+    bool deleteSegment(const QString& filePath);
+    // Pull rows from a legacy per-archive DB (<archiveDir>/camvigil.sqlite) once.
+    void importArchiveDb(const QString& archiveDir);
+    // ArchiveVerifier result; ignored if the row was relocated meanwhile.
+    void setSegmentHealth(qint64 id, const QString& filePath, int health, const QString& detail);
+    // ArchiveTranscoder: swap a segment's file for a smaller one (one transaction;
+    // false if the row moved meanwhile). Resets health so the verifier rechecks it.
+    // consumedSubPath: substream row whose file was renamed to newPath ("" = none).
+    bool replaceSegmentFile(qint64 id, const QString& oldPath, const QString& newPath, int quality,
+                            const QString& consumedSubPath);
+    void markAged(qint64 id);
+    // ArchiveSinkTap digest at finalize; links it into the camera's hash chain.
+    // An empty digest marks the row unhashed (hash_note) instead.
+    void setSegmentHash(const QString& filePath, const QByteArray& sha256);
+    // Retention: drop every row whose file lives under dirPrefix (ends with '/'),
+    // and the events of those cameras up to the end of the days removed.
+    int  deleteSegmentsUnder(const QString& dirPrefix);
+    // Loop recording (ArchiveMigrator): segments under dirPrefix, and taking
+    // the oldest one for reuse (row deleted, path returned; "" if none).
+    int  countSegmentsUnder(const QString& dirPrefix);
+    QString takeOldestSegmentUnder(const QString& dirPrefix);
+    // ArchiveCompactor: one row (plus one substream row) for the concatenated
+    // members, in one transaction. Returns the new id, 0 if members changed.
+    qint64 replaceSegments(const QVariantList& ids, const QString& mergedPath,
+                           const QString& mergedSubPath);
+    // Per-camera totals from day_summary, answered with archiveSummary().
+    void summarizeArchive();
+
+signals:
+    void archiveSummary(ArchiveSummary cams);
+
+private slots:
+    void flush();                   // commit the open batch, if any
 
 private:
+    static const int kBatchRows = 64;
+    static const int kFlushMs   = 250;
+    static const int kGlobalEventDays = 90;
+
+    void batch();                   // next statement joins the open batch
+    int  cameraId(const QString& url);
+    bool prepareStatements();
     bool ensureSchema();
+    bool migrate();
+    // day_coverage (schema v4): OR a finalized span in, or recompute a day
+    // from its segments after rows went away.
+    void addCoverage(int camId, qint64 startNs, qint64 endNs);
+    void rebuildCoverage(int camId, const QDate& day);
+    bool rebuildAllCoverage();
+    // camera-days touched by the main-stream rows `where` selects (alias s)
+    QSet<QPair<int, QDate>> coverageDays(const QString& where, const QVariantList& binds);
+    void addEvent(EventKind kind, int camId, qint64 tsUtcNs, const QString& source,
+                  const QString& detail);
+    // camera-less events (storage, system) have no footage to follow:
+    // kept for kGlobalEventDays
+    void pruneGlobalEvents();
     bool exec(const QString& sql);
+    bool ensureColumn(const QString& table, const QString& column, const QString& decl);
     QSqlDatabase db_;
+    QTimer*      flushTimer_ = nullptr;
+    bool         inBatch_ = false;
+    int          batched_ = 0;
+    QHash<QString, int>    cameraIds_;   // main_url -> cameras.id
+    struct OpenRow { qint64 id = 0; int camId = 0; qint64 startNs = 0; bool main = true; };
+    QHash<QString, OpenRow> openRows_;   // file_path -> row opened in this run, until finalized
+    QSqlQuery    cameraQ_, insertQ_, insertSubQ_, finalizeIdQ_, finalizePathQ_, eventQ_;
 };
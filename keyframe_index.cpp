@@ -0,0 +1,107 @@
+#include "keyframe_index.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDebug>
+#include <QtEndian>
+#include <algorithm>
+#include <unistd.h>
+
+static const quint32 kMagic   = 0x494B5643; // "CVKI" read as little-endian u32
+static const quint16 kVersion = 2;        // 1: with entry count, still read
+static const int     kHeaderBytes = 8;
+static const int     kEntryBytes  = 16;
+
+bool KeyframeIndex::load(const QString& sidecar) {
+    entries_.clear();
+    QFile f(sidecar);
+    if (!f.open(QIODevice::ReadOnly)) return false;
+    QDataStream in(&f);
+    in.setByteOrder(QDataStream::LittleEndian);
+    quint32 magic = 0, count = 0;
+    quint16 version = 0, reserved = 0;
+    in >> magic >> version >> reserved;
+    if (in.status() != QDataStream::Ok || magic != kMagic) return false;
+    if (version == 1) {
+        in >> count;
+        // sanity: count must fit in the file
+        if (in.status() != QDataStream::Ok || qint64(count) * kEntryBytes > f.size()) return false;
+    } else if (version == kVersion) {
+        count = quint32((f.size() - kHeaderBytes) / kEntryBytes);   // drops a torn tail
+    } else {
+        return false;
+    }
+    entries_.reserve(int(count));
+    for (quint32 i = 0; i < count; ++i) {
+        qint64 pts = 0, off = 0;
+        in >> pts >> off;
+        if (in.status() != QDataStream::Ok) { entries_.clear(); return false; }
+        entries_.push_back({ pts, off });
+    }
+    return true;
+}
+
+static void writeHeader(QDataStream& out) {
+    out << kMagic << kVersion << quint16(0);
+}
+
+bool KeyframeIndex::save(const QString& sidecar) const {
+    QSaveFile f(sidecar);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qWarning() << "[KFI] cannot write" << sidecar << f.errorString();
+        return false;
+    }
+    QDataStream out(&f);
+    out.setByteOrder(QDataStream::LittleEndian);
+    writeHeader(out);
+    for (const auto& e : entries_) out << e.ptsNs << e.offset;
+    return f.commit();
+}
+
+bool KeyframeIndexWriter::open(const QString& sidecar) {
+    close();
+    file_.setFileName(sidecar);
+    if (!file_.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+        qWarning() << "[KFI] cannot write" << sidecar << file_.errorString();
+        return false;
+    }
+    QDataStream out(&file_);
+    out.setByteOrder(QDataStream::LittleEndian);
+    writeHeader(out);
+    return true;
+}
+
+void KeyframeIndexWriter::append(qint64 ptsNs, qint64 offset) {
+    if (!file_.isOpen()) return;
+    // one write per entry (Unbuffered): never half of it in a user buffer
+    char rec[kEntryBytes];
+    qToLittleEndian(ptsNs, rec);
+    qToLittleEndian(offset, rec + 8);
+    if (file_.write(rec, kEntryBytes) != kEntryBytes) {
+        qWarning() << "[KFI] append failed" << file_.fileName() << file_.errorString();
+        file_.close();
+        return;
+    }
+    ++count_;
+    if (ptsNs - lastSyncPts_ >= kSyncNs) {
+        ::fdatasync(file_.handle());
+        lastSyncPts_ = ptsNs;
+    }
+}
+
+void KeyframeIndexWriter::close() {
+    if (!file_.isOpen()) return;
+    ::fdatasync(file_.handle());
+    file_.close();
+    count_ = 0;
+    lastSyncPts_ = 0;
+}
+
+bool KeyframeIndex::floorEntry(qint64 ptsNs, Entry* out) const {
+    if (entries_.isEmpty()) return false;
+    auto it = std::upper_bound(entries_.begin(), entries_.end(), ptsNs,
+                               [](qint64 t, const Entry& e){ return t < e.ptsNs; });
+    if (it != entries_.begin()) --it;
+    *out = *it;
+    return true;
+}
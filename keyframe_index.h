@@ -0,0 +1,58 @@
+#pragma once
+#include <QFile>
+#include <QVector>
+#include <QString>
+#include <QtGlobal>
+
+// Per-segment keyframe table stored next to the recording as "<file>.kfi".
+// Appended by ArchiveSinkTap (KeyframeIndexWriter) as each keyframe is
+// written, so it exists even when the container's own index (MKV Cues)
+// never was: a crash leaves the entries up to the last keyframe.
+//
+// On-disk layout (little-endian):
+//   v2: "CVKI" | u16 2 | u16 reserved | { i64 pts_ns, i64 byte_offset } ... to EOF
+//   v1: "CVKI" | u16 1 | u16 reserved | u32 count | count * { i64 pts_ns, i64 byte_offset }
+// pts_ns is relative to the first timestamped buffer of the file. A torn
+// last v2 record (power cut mid-write) is ignored.
+class KeyframeIndex final {
+public:
+    struct Entry {
+        qint64 ptsNs  = 0;
+        qint64 offset = 0;
+    };
+
+    static QString sidecarPath(const QString& mediaPath) { return mediaPath + ".kfi"; }
+
+    void clear() { entries_.clear(); }
+    void append(qint64 ptsNs, qint64 offset) { entries_.push_back({ ptsNs, offset }); }
+    bool isEmpty() const { return entries_.isEmpty(); }
+    const QVector<Entry>& entries() const { return entries_; }
+
+    bool load(const QString& sidecar);         // v1 or v2
+    bool save(const QString& sidecar) const;   // v2, atomic (QSaveFile)
+
+    // Last keyframe with pts <= ptsNs (the first one if ptsNs precedes all).
+    bool floorEntry(qint64 ptsNs, Entry* out) const;
+
+private:
+    QVector<Entry> entries_;
+};
+
+// Append-only v2 sidecar for a file being recorded. Each entry is handed
+// to the kernel when added (survives a process crash) and the file is
+// fdatasync'ed every kSyncNs of media (bounds what a power cut loses).
+class KeyframeIndexWriter final {
+public:
+    ~KeyframeIndexWriter() { close(); }
+    bool open(const QString& sidecar);         // truncates
+    void append(qint64 ptsNs, qint64 offset);
+    void close();
+    bool isOpen() const { return file_.isOpen(); }
+    int  count() const { return count_; }
+
+private:
+    static constexpr qint64 kSyncNs = 5000000000LL;
+    QFile  file_;
+    int    count_ = 0;
+    qint64 lastSyncPts_ = 0;
+};
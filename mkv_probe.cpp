@@ -0,0 +1,290 @@
+#include "mkv_probe.h"
+#include "archive_cipher.h"
+#include <QFile>
+#include <QByteArray>
+#include <QDebug>
+#include <memory>
+
+namespace mkvprobe {
+
+static const quint32 kIdEbml           = 0x1A45DFA3;
+static const quint32 kIdSegment        = 0x18538067;
+static const quint32 kIdInfo           = 0x1549A966;
+static const quint32 kIdTimestampScale = 0x2AD7B1;
+static const quint32 kIdCluster        = 0x1F43B675;
+static const quint8  kIdTimestamp      = 0xE7;
+static const quint8  kIdSimpleBlock    = 0xA3;
+static const quint8  kIdBlockGroup     = 0xA0;
+static const quint8  kIdBlock          = 0xA1;
+
+static const qint64 kHeadBytes = 64 * 1024;
+static const qint64 kTailBytes = 4 * 1024 * 1024;   // > one cluster at our bitrates
+
+// EBML variable-length integer (size field). Returns byte length or 0 on error.
+// `unknown` is set for the reserved all-ones value (live/unfinished masters).
+static int readVint(const uchar* p, const uchar* end, quint64* value, bool* unknown = nullptr) {
+    if (p >= end || *p == 0) return 0;
+    int len = 1;
+    quint8 mask = 0x80;
+    while (!(*p & mask)) { mask >>= 1; ++len; }
+    if (p + len > end) return 0;
+    quint64 v = *p & (mask - 1);
+    bool allOnes = (v == quint64(mask - 1));
+    for (int i = 1; i < len; ++i) {
+        v = (v << 8) | p[i];
+        allOnes = allOnes && p[i] == 0xFF;
+    }
+    if (unknown) *unknown = allOnes;
+    *value = v;
+    return len;
+}
+
+static quint64 readUint(const uchar* p, int len) {
+    quint64 v = 0;
+    for (int i = 0; i < len; ++i) v = (v << 8) | p[i];
+    return v;
+}
+
+static int findId4(const uchar* begin, const uchar* end, quint32 id, const uchar* from) {
+    const uchar b0 = uchar(id >> 24), b1 = uchar(id >> 16), b2 = uchar(id >> 8), b3 = uchar(id);
+    for (const uchar* p = from; p + 4 <= end; ++p) {
+        if (p[0] == b0 && p[1] == b1 && p[2] == b2 && p[3] == b3) return int(p - begin);
+    }
+    return -1;
+}
+
+// Parses "Cluster <size> Timestamp <size> <value>" at `p`. Returns pointer to the
+// first child after the Timestamp element, or nullptr if this isn't a real cluster.
+static const uchar* parseClusterStart(const uchar* p, const uchar* end, qint64* clusterTs) {
+    p += 4;                                     // Cluster ID
+    quint64 size = 0; bool unknown = false;
+    int n = readVint(p, end, &size, &unknown);
+    if (!n) return nullptr;
+    p += n;
+    if (p >= end || *p != kIdTimestamp) return nullptr;   // matroskamux writes it first
+    ++p;
+    quint64 tsLen = 0;
+    n = readVint(p, end, &tsLen);
+    if (!n || tsLen == 0 || tsLen > 8) return nullptr;
+    p += n;
+    if (p + tsLen > end) return nullptr;
+    *clusterTs = qint64(readUint(p, int(tsLen)));
+    return p + tsLen;
+}
+
+// Block header: track vint, int16 relative timestamp, flags.
+static bool blockRelTs(const uchar* p, const uchar* end, int* rel) {
+    quint64 track = 0;
+    int n = readVint(p, end, &track);
+    if (!n || p + n + 2 > end) return false;
+    *rel = qint16((p[n] << 8) | p[n + 1]);
+    return true;
+}
+
+// Walks cluster children and returns the highest block timestamp offset seen.
+// Stops silently at the first truncated element (the tail of a crashed file).
+static int maxBlockOffset(const uchar* p, const uchar* end) {
+    int maxRel = 0;
+    while (p < end) {
+        const quint8 id = *p;
+        if (id != kIdSimpleBlock && id != kIdBlockGroup) break;   // next cluster / cues / junk
+        ++p;
+        quint64 size = 0;
+        int n = readVint(p, end, &size);
+        if (!n) break;
+        p += n;
+        const uchar* body = p;
+        const uchar* bodyEnd = (size > quint64(end - body)) ? end : body + size;
+        int rel = 0;
+        if (id == kIdSimpleBlock) {
+            if (blockRelTs(body, bodyEnd, &rel)) maxRel = qMax(maxRel, rel);
+        } else if (body < bodyEnd && *body == kIdBlock) {
+            quint64 bsize = 0;
+            int bn = readVint(body + 1, bodyEnd, &bsize);
+            if (bn && blockRelTs(body + 1 + bn, bodyEnd, &rel)) maxRel = qMax(maxRel, rel);
+        }
+        if (size > quint64(end - body)) break;                  // truncated block
+        p = body + size;
+    }
+    return maxRel;
+}
+
+bool readTail(const QString& path, TailInfo* out) {
+    std::unique_ptr<QIODevice> dev(ArchiveCipher::openForRead(path));
+    if (!dev) return false;
+    QIODevice& f = *dev;
+    const qint64 fileSize = f.size();
+
+    // --- head: EBML magic, TimestampScale, first cluster ---
+    const QByteArray head = f.read(qMin(fileSize, kHeadBytes));
+    const uchar* hb = reinterpret_cast<const uchar*>(head.constData());
+    const uchar* he = hb + head.size();
+    if (head.size() < 4 || readUint(hb, 4) != kIdEbml) return false;
+
+    TailInfo info;
+    for (const uchar* p = hb; p + 3 <= he; ++p) {
+        if (readUint(p, 3) != kIdTimestampScale) continue;
+        quint64 len = 0;
+        const int n = readVint(p + 3, he, &len);
+        if (n && len > 0 && len <= 8 && p + 3 + n + len <= he) {
+            const qint64 scale = qint64(readUint(p + 3 + n, int(len)));
+            if (scale > 0) info.timestampScaleNs = scale;
+        }
+        break;
+    }
+    for (int pos = findId4(hb, he, kIdCluster, hb); pos >= 0;
+         pos = findId4(hb, he, kIdCluster, hb + pos + 1)) {
+        qint64 ts = 0;
+        if (parseClusterStart(hb + pos, he, &ts)) { info.firstTimestampNs = ts; break; }
+    }
+    if (info.firstTimestampNs < 0) return false;
+
+    // --- tail: last parsable cluster and its blocks ---
+    const qint64 tailStart = qMax<qint64>(0, fileSize - kTailBytes);
+    if (!f.seek(tailStart)) return false;
+    const QByteArray tail = f.read(fileSize - tailStart);
+    const uchar* tb = reinterpret_cast<const uchar*>(tail.constData());
+    const uchar* te = tb + tail.size();
+    if (tail.size() < 4) return false;
+
+    qint64 lastTs = -1;
+    // by offset: stepping a pointer below tb is undefined
+    for (int i = tail.size() - 4; i >= 0; --i) {
+        const uchar* p = tb + i;
+        if (readUint(p, 4) != kIdCluster) continue;
+        qint64 ts = 0;
+        const uchar* children = parseClusterStart(p, te, &ts);
+        if (!children || ts < info.firstTimestampNs) continue;  // false match inside payload
+        lastTs = ts + maxBlockOffset(children, te);
+        break;
+    }
+    if (lastTs < 0) return false;
+
+    info.firstTimestampNs *= info.timestampScaleNs;
+    info.lastTimestampNs   = lastTs * info.timestampScaleNs;
+    *out = info;
+    return true;
+}
+
+// Element IDs keep their length marker: 1xxx xxxx = 1 byte ... 0001 xxxx = 4 bytes.
+static int idLength(uchar b) {
+    if (b & 0x80) return 1;
+    if (b & 0x40) return 2;
+    if (b & 0x20) return 3;
+    if (b & 0x10) return 4;
+    return 0;
+}
+
+static int readElementHeader(const uchar* p, const uchar* end, quint32* id, quint64* size, bool* unknown) {
+    if (p >= end) return 0;
+    const int idLen = idLength(*p);
+    if (!idLen || p + idLen > end) return 0;
+    *id = quint32(readUint(p, idLen));
+    const int n = readVint(p + idLen, end, size, unknown);
+    return n ? idLen + n : 0;
+}
+
+static const qint64 kMaxClusterGapNs = 15LL * 1000000000LL;   // longer than any sane GOP
+
+void verify(const QString& path, VerifyReport* out, const ReadThrottle& throttle) {
+    VerifyReport r;
+    auto finish = [&](int health, const QString& detail) {
+        r.health = health;
+        r.detail = detail;
+        *out = r;
+    };
+    auto account = [&](qint64 bytes) { if (throttle) throttle(bytes); };
+
+    if (!QFile::exists(path)) return finish(VerifyReport::Missing, "file missing");
+    std::unique_ptr<QIODevice> dev(ArchiveCipher::openForRead(path));
+    if (!dev) return finish(VerifyReport::Corrupt, "cannot open");
+    QIODevice& f = *dev;
+    const qint64 fileSize = f.size();
+
+    auto headerAt = [&](qint64 pos, quint32* id, quint64* size, bool* unknown) -> int {
+        if (!f.seek(pos)) return 0;
+        const QByteArray h = f.read(12);
+        account(h.size());
+        const uchar* p = reinterpret_cast<const uchar*>(h.constData());
+        return readElementHeader(p, p + h.size(), id, size, unknown);
+    };
+
+    quint32 id = 0; quint64 size = 0; bool unknown = false;
+    int hl = headerAt(0, &id, &size, &unknown);
+    if (!hl || id != kIdEbml) return finish(VerifyReport::Corrupt, "not a Matroska file");
+    qint64 pos = hl + qint64(size);
+
+    hl = headerAt(pos, &id, &size, &unknown);
+    if (!hl || id != kIdSegment) return finish(VerifyReport::Corrupt, "no Segment after EBML header");
+    pos += hl;
+    bool truncated = false;
+    qint64 segEnd = unknown ? fileSize : pos + qint64(size);
+    if (segEnd > fileSize) { truncated = true; segEnd = fileSize; }
+
+    qint64 scaleNs = 1000000;
+    qint64 prevTs = -1;
+    QString problem;                         // first continuity problem, if any
+    while (pos < segEnd) {
+        hl = headerAt(pos, &id, &size, &unknown);
+        if (!hl) {
+            if (fileSize - pos < 12) { truncated = true; break; }
+            return finish(VerifyReport::Corrupt, QString("bad element header at %1").arg(pos));
+        }
+        if (unknown) return finish(VerifyReport::Damaged, QString("unfinished element at %1").arg(pos));
+        const qint64 bodyStart = pos + hl;
+        const qint64 elemEnd = bodyStart + qint64(size);
+        if (elemEnd > fileSize) truncated = true;
+
+        if (id == kIdInfo || id == kIdCluster) {
+            if (!f.seek(bodyStart)) return finish(VerifyReport::Corrupt, "seek failed");
+            const QByteArray body = f.read(qMin(qint64(size), fileSize - bodyStart));
+            account(body.size());
+            const uchar* p = reinterpret_cast<const uchar*>(body.constData());
+            const uchar* end = p + body.size();
+            qint64 clusterTs = -1;
+            while (p < end) {
+                quint32 cid = 0; quint64 csize = 0; bool cu = false;
+                const int chl = readElementHeader(p, end, &cid, &csize, &cu);
+                if (!chl || cu || csize > quint64(end - p - chl)) {
+                    if (elemEnd > fileSize) break;             // tail cut off by the crash
+                    return finish(VerifyReport::Corrupt,
+                                  QString("element overruns its parent at %1")
+                                      .arg(bodyStart + (p - reinterpret_cast<const uchar*>(body.constData()))));
+                }
+                const uchar* v = p + chl;
+                if (id == kIdInfo && cid == kIdTimestampScale && csize >= 1 && csize <= 8) {
+                    const qint64 s = qint64(readUint(v, int(csize)));
+                    if (s > 0) scaleNs = s;
+                } else if (id == kIdCluster && cid == kIdTimestamp && csize >= 1 && csize <= 8) {
+                    clusterTs = qint64(readUint(v, int(csize)));
+                }
+                p = v + csize;
+            }
+            if (id == kIdCluster) {
+                if (clusterTs < 0) {
+                    if (elemEnd > fileSize) break;
+                    return finish(VerifyReport::Corrupt, QString("cluster without timestamp at %1").arg(pos));
+                }
+                if (prevTs >= 0) {
+                    const qint64 gapNs = (clusterTs - prevTs) * scaleNs;
+                    r.maxGapNs = qMax(r.maxGapNs, gapNs);
+                    if (problem.isEmpty() && gapNs < 0)
+                        problem = QString("timestamps go backwards at %1").arg(pos);
+                    else if (problem.isEmpty() && gapNs > kMaxClusterGapNs)
+                        problem = QString("%1 s gap at %2").arg(gapNs / 1000000000LL).arg(pos);
+                }
+                prevTs = clusterTs;
+                ++r.clusters;
+            }
+        }
+        if (elemEnd > fileSize) break;
+        pos = elemEnd;
+    }
+
+    if (r.clusters == 0) return finish(VerifyReport::Corrupt, "no clusters");
+    if (truncated)        return finish(VerifyReport::Damaged, "truncated (not finalized)");
+    if (!problem.isEmpty()) return finish(VerifyReport::Damaged, problem);
+    finish(VerifyReport::Ok, QString());
+}
+
+} // namespace mkvprobe
@@ -0,0 +1,40 @@
+#pragma once
+#include <QString>
+#include <QtGlobal>
+#include <functional>
+
+// Lightweight Matroska inspection without decoding.
+// Only the file head (Info/TimestampScale + first Cluster) and the file tail
+// (last Cluster + its blocks) are read, so this is cheap even on USB media
+// and works on files whose Cues/Duration were never written (power cut).
+namespace mkvprobe {
+
+struct TailInfo {
+    qint64 timestampScaleNs = 1000000;  // Matroska default (1 ms ticks)
+    qint64 firstTimestampNs = -1;       // first Cluster timestamp
+    qint64 lastTimestampNs  = -1;       // last block timestamp found in the tail
+    qint64 durationNs() const {
+        return (firstTimestampNs >= 0 && lastTimestampNs >= firstTimestampNs)
+                   ? lastTimestampNs - firstTimestampNs : 0;
+    }
+};
+
+// Reads head + tail of an MKV and fills `out`. Returns false if the file is
+// not Matroska or no usable cluster timestamps were found.
+bool readTail(const QString& path, TailInfo* out);
+
+// Full structural check: every top-level element and cluster child must fit,
+// cluster timestamps must be present and move forward without large gaps.
+// Reads every cluster, so callers pass a throttle to bound I/O.
+struct VerifyReport {
+    enum Health { Unchecked = 0, Ok = 1, Damaged = 2, Corrupt = 3, Missing = 4 };
+    int     health = Unchecked;  // Damaged: truncated tail or timestamp gap, still playable
+    QString detail;
+    qint64  clusters = 0;
+    qint64  maxGapNs = 0;        // largest jump between consecutive cluster timestamps
+};
+using ReadThrottle = std::function<void(qint64 bytes)>;
+
+void verify(const QString& path, VerifyReport* out, const ReadThrottle& throttle = ReadThrottle());
+
+} // namespace mkvprobe
@@ -100,6 +100,14 @@ void PlaybackControlsWidget::setCurrentCamera(const QString& name) {
         cameraCombo->setCurrentIndex(idx);
     }
 }
+void PlaybackControlsWidget::setCamerasWithFootage(const QSet<QString>& names) {
+    for (int i = 0; i < cameraCombo->count(); ++i) {
+        const bool has = names.contains(cameraCombo->itemText(i));
+        cameraCombo->setItemData(i, has ? QVariant() : QVariant(QColor("#666")), Qt::ForegroundRole);
+        cameraCombo->setItemData(i, has ? QVariant() : QVariant(tr("No footage at this time")),
+                                 Qt::ToolTipRole);
+    }
+}
 void PlaybackControlsWidget::setAvailableDates(const QSet<QDate>& dates) {
     availableDates_ = dates;
     auto* cal = dateEdit->calendarWidget();
@@ -116,13 +124,21 @@ void PlaybackControlsWidget::setAvailableDates(const QSet<QDate>& dates) {
         cal->setDateTextFormat(d, gray);
     }
 
-    // Highlight available
+    // Highlight available; heat-map by coverage when known (#444 → green)
     QTextCharFormat hi;
     hi.setForeground(Qt::white);
     hi.setBackground(QColor("#444"));
     hi.setFontWeight(QFont::Bold);
     for (const QDate& d : availableDates_) {
-        if (d.isValid()) cal->setDateTextFormat(d, hi);
+        if (!d.isValid()) continue;
+        QTextCharFormat f = hi;
+        const auto it = coverage_.constFind(d);
+        if (it != coverage_.constEnd()) {
+            const double c = it.value();
+            f.setBackground(QColor(int(0x44 * (1 - c) + 0x2e * c), int(0x44 * (1 - c) + 0x9e * c),
+                                   int(0x44 * (1 - c) + 0x4a * c)));
+        }
+        cal->setDateTextFormat(d, f);
     }
 
     // Enforce selection to available dates
@@ -4,6 +4,7 @@
 #include <QDateEdit>
 #include <QStringList>
 #include <QDate>
+#include <QHash>
 #include <QSet>
 #include <QPushButton>
 class PlaybackControlsWidget : public QWidget {
@@ -21,6 +22,12 @@ public:
     void setDate(const QDate& dt);
     void setCurrentCamera(const QString& name);
     void setAvailableDates(const QSet<QDate>& dates);
+    // Fraction of each day with footage (0..1); available dates are shaded
+    // by it. Call before setAvailableDates.
+    void setDayCoverage(const QHash<QDate, double>& coverage) { coverage_ = coverage; }
+    // Cameras with footage at the playhead; the others are greyed in the
+    // camera list (still selectable).
+    void setCamerasWithFootage(const QSet<QString>& names);
     QPushButton* goBtn{nullptr};
 signals:
     void cameraChanged(const QString& name);
@@ -30,5 +37,6 @@ private:
     QComboBox* cameraCombo{nullptr};
     QDateEdit* dateEdit{nullptr};
     QSet<QDate> availableDates_;
+    QHash<QDate, double> coverage_;
     QDate nearestAvailable(const QDate& base) const;
 };
@@ -1,9 +1,13 @@
 #include "playback_exporter.h"
+#include "archive_cipher.h"
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QDate>
 #include <QTextStream>
+#include "keyframe_index.h"
+#include "sched_policy.h"
+#include <memory>
 
 static inline double secFromNs(qint64 ns){ return double(ns)/1e9; }
 
@@ -93,6 +97,7 @@ bool PlaybackExporter::runFfmpeg_(const QStringList& args, QByteArray* errOut){
     p.setProcessChannelMode(QProcess::SeparateChannels);
     p.start();
     if (!p.waitForStarted()) return false;
+    SchedPolicy::applyToProcess(p.processId(), SchedClass::Export);   // recording first
 
     // Poll for cancel and progress
     while (p.state() == QProcess::Running) {
@@ -119,12 +124,32 @@ bool PlaybackExporter::cutParts_(const QVector<ClipPart>& parts, QStringList* cu
         const QString cut = QString("%1/part_%2.mkv").arg(QDir::tempPath()).arg(i,4,10,QChar('0'));
         cutPaths->push_back(cut);
 
+        // ffmpeg cannot read encrypted segments: hand it a private plaintext
+        // copy (0600, unguessable name, removed when this part is done)
+        QString input = part.path;
+        QTemporaryFile plain(QDir::temp().absoluteFilePath(
+            QString("plain_XXXXXX.%1").arg(QFileInfo(part.path).suffix())));
+        if (ArchiveCipher::isEncrypted(part.path)) {
+            if (!decryptTo_(part.path, &plain)) {
+                emit log(QString("[Export] cannot decrypt %1").arg(part.path));
+                return false;
+            }
+            input = plain.fileName();
+        }
+
         QStringList args; args << "-hide_banner" << "-y";
 
+        // Recorded keyframe table (if any): cut on a known keyframe instead of guessing
+        KeyframeIndex kfi;
+        KeyframeIndex::Entry kf;
+        const bool haveKf = kfi.load(KeyframeIndex::sidecarPath(part.path)) &&
+                            kfi.floorEntry(part.inStartNs, &kf);
+
         if (opts_.precise) {
-            const double coarse = std::max(0.0, ss - 3.0); // jump ~3s earlier to reduce decode cost
+            // coarse input seek to the keyframe at/before ss (or ~3s earlier without a table)
+            const double coarse = haveKf ? secFromNs(kf.ptsNs) : std::max(0.0, ss - 3.0);
             args << "-ss" << QString::number(coarse, 'f', 3)      // coarse input seek
-                 << "-i"  << part.path
+                 << "-i"  << input
                  << "-ss" << QString::number(ss - coarse, 'f', 6) // fine output seek
                  << "-to" << QString::number(to - coarse, 'f', 6)
                  << "-c:v" << opts_.vcodec
@@ -138,9 +163,10 @@ bool PlaybackExporter::cutParts_(const QVector<ClipPart>& parts, QStringList* cu
             args << "-movflags" << "+faststart"
                  << cut;
         } else {
-            args << "-ss" << QString::number(ss, 'f', 6)
+            // stream copy can only start on a keyframe anyway; be explicit about which one
+            args << "-ss" << QString::number(haveKf ? secFromNs(kf.ptsNs) : ss, 'f', 6)
                  << "-to" << QString::number(to, 'f', 6)
-                 << "-i"  << part.path
+                 << "-i"  << input
                  << "-c"  << "copy"
                  << "-avoid_negative_ts" << "make_zero"
                  << cut;
@@ -148,12 +174,26 @@ bool PlaybackExporter::cutParts_(const QVector<ClipPart>& parts, QStringList* cu
 
         QByteArray err;
         emit log(QString("[Export] cut %1/%2").arg(i+1).arg(N));
-        if (!runFfmpeg_(args, &err)) { emit log(QString::fromUtf8(err)); return false; }
+        const bool ok = runFfmpeg_(args, &err);
+        if (!ok) { emit log(QString::fromUtf8(err)); return false; }
         emit progress( (i+1) * 100.0 / (N+1) );
     }
     return true;
 }
 
+// Chunked copy through the decrypting reader; owner-only permissions.
+bool PlaybackExporter::decryptTo_(const QString& in, QTemporaryFile* out){
+    static const qint64 kChunk = 1024 * 1024;
+    std::unique_ptr<QIODevice> src(ArchiveCipher::openForRead(in));
+    if (!src || !out->open()) return false;       // created 0600
+    while (!src->atEnd()) {
+        if (abort_.load()) return false;
+        const QByteArray chunk = src->read(kChunk);
+        if (chunk.isEmpty() || out->write(chunk) != chunk.size()) return false;
+    }
+    out->close();                                 // flushed; still there for ffmpeg
+    return true;
+}
 
 bool PlaybackExporter::writeConcatList_(const QStringList& cutPaths, QString* listPath){
     const QString p = QDir::temp().absoluteFilePath("concat_inputs.txt");
@@ -5,6 +5,7 @@
 #include <atomic>
 #include <QProcess>
 #include <QTemporaryDir>
+#include <QTemporaryFile>
 #include "playback_segment_index.h" // for FileSeg
 
 struct ExportOptions {
@@ -57,6 +58,7 @@ private:
     QString uniqueOutPath_() const;
     bool runFfmpeg_(const QStringList& args, QByteArray* errOut);
     bool cutParts_(const QVector<ClipPart>& parts, QStringList* cutPaths);
+    bool decryptTo_(const QString& in, QTemporaryFile* out);
     bool writeConcatList_(const QStringList& cutPaths, QString* listPath);
     bool concat_(const QString& listPath, const QString& outPath);
 };
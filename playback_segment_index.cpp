@@ -35,7 +35,7 @@ void PlaybackSegmentIndex::build(const SegmentList& segs, qint64 dayStartNs, qin
                     ++printed;
                 }
         if (b <= a) continue; // drop zero/neg
-        FileSeg fs{ s.path, a, b };
+        FileSeg fs{ s.path, a, b, s.sub_path, s.sub_offset_ns };
         raw.push_back(fs);
     }
 
@@ -59,7 +59,7 @@ void PlaybackSegmentIndex::build(const SegmentList& segs, qint64 dayStartNs, qin
         // Clamp overlaps to monotonic progression (prefer earlier segment)
         qint64 start = qMax(fs.start_ns, lastEnd); // avoid negative "gaps" on overlaps
         if (fs.end_ns > start) {
-            list_.push_back({ fs.path, start, fs.end_ns });
+            list_.push_back({ fs.path, start, fs.end_ns, fs.sub_path, fs.sub_offset_ns });
             lastEnd = fs.end_ns;
         }
     }
@@ -16,6 +16,8 @@ public:
         QString path;
         qint64  start_ns = 0;     // wall-clock ns (UTC epoch)
         qint64  end_ns   = 0;     // exclusive
+        QString sub_path;         // low-res copy, "" = none
+        qint64  sub_offset_ns = 0;// sub file start relative to the main file start
         qint64  duration_ns() const { return qMax<qint64>(0, end_ns - start_ns); }
     };
     struct Gap {
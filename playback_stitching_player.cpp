@@ -23,6 +23,7 @@ void PlaybackStitchingPlayer::setPlaylist(QVector<SegmentMeta> metas, qint64 day
     qInfo() << "[Stitch] setPlaylist called with" << metas.size() << "segments";
     
     paths_.clear(); wallStarts_.clear(); offsets_.clear(); durations_.clear();
+    subPaths_.clear(); subOffsets_.clear();
     totalVirt_ = 0; curIdx_ = -1; dayStartNs_ = day_start_ns;
     isPlaying_ = false; // Reset playing state
 
@@ -30,12 +31,16 @@ void PlaybackStitchingPlayer::setPlaylist(QVector<SegmentMeta> metas, qint64 day
     wallStarts_.reserve(metas.size());
     offsets_.reserve(metas.size());
     durations_.reserve(metas.size());
+    subPaths_.reserve(metas.size());
+    subOffsets_.reserve(metas.size());
 
     for (const auto& m : metas) {
         paths_     << m.path;
         wallStarts_<< m.wall_start_ns;
         offsets_   << m.offset_ns;
         durations_ << m.duration_ns;
+        subPaths_  << m.sub_path;
+        subOffsets_<< m.sub_offset_ns;
         totalVirt_  = qMax(totalVirt_, m.offset_ns + m.duration_ns);
     }
     
@@ -55,7 +60,7 @@ void PlaybackStitchingPlayer::play() {
     if (!isPlaying_) {
             // Start at the beginning unless already opened
             if (curIdx_ < 0) playAtVirtual(0);
-            else { playerPlay(); emit stateChanged(true); isPlaying_ = true; }
+            else { isPlaying_ = true; updateVariant(); playerPlay(); emit stateChanged(true); }
         }
 }
 
@@ -69,6 +74,7 @@ void PlaybackStitchingPlayer::pause() {
     
     playerPause();
     isPlaying_ = false;
+    updateVariant();        // hold on a full-resolution frame
     emit stateChanged(false);
 }
 
@@ -83,6 +89,7 @@ void PlaybackStitchingPlayer::stop() {
 void PlaybackStitchingPlayer::setRate(double r) {
     rate_ = (r == 0.0 ? 1.0 : r);
     playerSetRate(rate_);
+    updateVariant();
 }
 
 void PlaybackStitchingPlayer::playAtVirtual(qint64 virt_ns) {
@@ -105,11 +112,12 @@ void PlaybackStitchingPlayer::playAtVirtual(qint64 virt_ns) {
     }
 
     qInfo() << "[Stitch] Opening segment" << idx << "at position" << inSeg;
+    isPlaying_ = true;
     if (idx != curIdx_) openIndex(idx);
+    else updateVariant();
     playerSeek(inSeg);
     playerPlay();
     
-    isPlaying_ = true;
     emit stateChanged(true);
 }
 
@@ -125,14 +133,14 @@ void PlaybackStitchingPlayer::seekWall(qint64 wall_ns) {
         return;
     }
 OPEN:
+    // reflect actual playing state so Pause works immediately after a drag seek
+    const bool wasPlaying = isPlaying_;
+    isPlaying_ = true;
     if (idx != curIdx_) openIndex(idx);
+    else updateVariant();
     playerSeek(inSeg);
     playerPlay();
-    // reflect actual playing state so Pause works immediately after a drag seek
-    if (!isPlaying_) {
-    isPlaying_ = true;
-    emit stateChanged(true);
-    }
+    if (!wasPlaying) emit stateChanged(true);
 }
 
 void PlaybackStitchingPlayer::onPlayerEos() {
@@ -156,6 +164,8 @@ void PlaybackStitchingPlayer::onPlayerEos() {
 
 void PlaybackStitchingPlayer::onPlayerPos(qint64 in_seg_pos_ns) {
     if (curIdx_ < 0 || curIdx_ >= offsets_.size()) return;
+    if (openedSub_) in_seg_pos_ns += subOffsets_[curIdx_];
+    lastInSegNs_ = in_seg_pos_ns;
     const qint64 virt = offsets_[curIdx_] + in_seg_pos_ns;
     const qint64 wall = virtualToWall(virt); // absolute within day
     emit wallPositionNs(wall - dayStartNs_);
@@ -163,9 +173,27 @@ void PlaybackStitchingPlayer::onPlayerPos(qint64 in_seg_pos_ns) {
 
 void PlaybackStitchingPlayer::openIndex(int idx) {
     curIdx_ = idx;
+    lastInSegNs_ = 0;
     emit segmentChanged(curIdx_);
-    playerOpen(paths_[curIdx_]);
+    openedSub_ = wantSub(curIdx_);
+    playerOpen(openedSub_ ? subPaths_[curIdx_] : paths_[curIdx_]);
+    playerSetRate(rate_);
+}
+
+bool PlaybackStitchingPlayer::wantSub(int idx) const {
+    return isPlaying_ && qAbs(rate_) >= 2.0 && !subPaths_.value(idx).isEmpty();
+}
+
+// Swap the current segment between main and substream file, keeping position.
+void PlaybackStitchingPlayer::updateVariant() {
+    if (curIdx_ < 0 || curIdx_ >= paths_.size() || wantSub(curIdx_) == openedSub_) return;
+    const qint64 pos = lastInSegNs_;
+    openedSub_ = !openedSub_;
+    qInfo() << "[Stitch] segment" << curIdx_ << "->" << (openedSub_ ? "substream" : "main");
+    playerOpen(openedSub_ ? subPaths_[curIdx_] : paths_[curIdx_]);
     playerSetRate(rate_);
+    playerSeek(pos);
+    if (isPlaying_) playerPlay(); else playerPause();
 }
 
 bool PlaybackStitchingPlayer::computeIndexFromWall(qint64 wall_ns, int& idx, qint64& in_seg_ns) const {
@@ -228,6 +256,8 @@ void PlaybackStitchingPlayer::playerStop() {
 }
 void PlaybackStitchingPlayer::playerSeek(qint64 in_seg_ns) {
     if (!player_) return;
+    lastInSegNs_ = qMax<qint64>(0, in_seg_ns);
+    if (openedSub_ && curIdx_ >= 0) in_seg_ns = qMax<qint64>(0, in_seg_ns - subOffsets_[curIdx_]);
     QMetaObject::invokeMethod(player_, "seekNs", Qt::QueuedConnection,
                               Q_ARG(qint64, in_seg_ns));
 }
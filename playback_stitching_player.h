@@ -11,6 +11,8 @@ struct SegmentMeta {
     qint64  wall_start_ns;  // absolute wall time within the day (ns from midnight local)
     qint64  offset_ns;      // virtual (gapless) base offset
     qint64  duration_ns;    // length to play
+    QString sub_path;       // substream copy ("" = none): used while fast-forwarding
+    qint64  sub_offset_ns;  // sub file start relative to path's start
 };
 Q_DECLARE_METATYPE(SegmentMeta)
 
@@ -18,6 +20,10 @@ Q_DECLARE_METATYPE(SegmentMeta)
  * Gapless stitching controller that plays a day’s worth of clips
  * as a continuous virtual timeline (gaps skipped).
  *
+ * Segments with a substream copy play from that copy while fast-forwarding
+ * (|rate| >= 2); pausing or returning to normal speed reopens the main
+ * recording at the same position.
+ *
  * Thread model:
  * - This object is moved to its own QThread by the owner.
  * - It calls the GStreamer player via queued invokeMethod (player is in its own thread).
@@ -60,6 +66,8 @@ private slots:
 private:
     // helpers
     void openIndex(int idx);
+    bool wantSub(int idx) const;
+    void updateVariant();
     bool computeIndexFromWall(qint64 wall_ns, int& idx, qint64& in_seg_ns) const;
     bool computeIndexFromVirtual(qint64 virt_ns, int& idx, qint64& in_seg_ns) const;
     qint64 virtualToWall(qint64 virt_ns) const;
@@ -78,11 +86,15 @@ private:
     QVector<qint64>  wallStarts_;
     QVector<qint64>  offsets_;    // virtual offset base per segment
     QVector<qint64>  durations_;
+    QVector<QString> subPaths_;
+    QVector<qint64>  subOffsets_;
     qint64           totalVirt_ = 0;
     qint64           dayStartNs_ = 0;
 
     int              curIdx_ = -1;
     double           rate_   = 1.0;
     bool             isPlaying_ = false; // NEW: track play/pause state
+    bool             openedSub_ = false; // current file is the substream copy
+    qint64           lastInSegNs_ = 0;   // last reported position (main-file time)
 };
 Q_DECLARE_METATYPE(QVector<SegmentMeta>)
@@ -16,6 +16,12 @@ void PlaybackTimelineController::attach(DbReader* r){
             connect(db_, &DbReader::segmentsReady,
                     this, &PlaybackTimelineController::onSegmentsReady,
                     Qt::QueuedConnection);
+            connect(db_, &DbReader::coverageReady,
+                    this, &PlaybackTimelineController::onCoverageReady,
+                    Qt::QueuedConnection);
+            connect(db_, &DbReader::eventsReady,
+                    this, &PlaybackTimelineController::onEventsReady,
+                    Qt::QueuedConnection);
             emit log(QString("[Ctl] attached DbReader=%1")
                      .arg(reinterpret_cast<quintptr>(db_), 0, 16));
         }
@@ -38,18 +44,43 @@ void PlaybackTimelineController::onGo(const QString& camName, const QDate& day){
     }
     pendingCid_ = cid; pendingDay_ = day;
     emit log(QString("[Go] cid=%1 day=%2").arg(cid).arg(day.toString("yyyy-MM-dd")));
+    // one-row bitmap first, so the bar is drawn before the segment list lands
+    // earlier Go clicks still queued on the DB thread are dropped there
+    QMetaObject::invokeMethod(db_, "coverage", Qt::QueuedConnection,
+                              Q_ARG(int, cid),
+                              Q_ARG(QString, day.toString("yyyy-MM-dd")),
+                              Q_ARG(quint64, db_->supersede(DbReader::Coverage)));
     QMetaObject::invokeMethod(db_, "listSegments", Qt::QueuedConnection,
                               Q_ARG(int, cid),
-                              Q_ARG(QString, day.toString("yyyy-MM-dd")));
+                              Q_ARG(QString, day.toString("yyyy-MM-dd")),
+                              Q_ARG(quint64, db_->supersede(DbReader::Segments)));
+    QMetaObject::invokeMethod(db_, "listEvents", Qt::QueuedConnection,
+                              Q_ARG(int, cid),
+                              Q_ARG(qint64, dayStartNs(day)),
+                              Q_ARG(qint64, dayEndNs(day)),
+                              Q_ARG(quint64, db_->supersede(DbReader::Events)));
 }
 
 void PlaybackTimelineController::onSegmentsReady(int cameraId, const SegmentList& segs){
     if (cameraId != pendingCid_) return;
     QVector<TimelineSpan> raw; raw.reserve(segs.size());
-    for (const auto& s: segs) raw.push_back({s.start_ns, s.end_ns});
+    for (const auto& s: segs) raw.push_back({s.start_ns, s.end_ns, s.open});
     model_.build(dayStartNs(pendingDay_), dayEndNs(pendingDay_), raw);
     emit built(pendingDay_, model_);
     emit log(QString("[Timeline] built spans=%1 covered_s=%2")
              .arg(model_.spans().size())
              .arg(model_.totalCoveredNs()/1e9, 0, 'f', 3));
 }
+
+void PlaybackTimelineController::onCoverageReady(int cameraId, const QString& ymd, const QByteArray& packed){
+    if (cameraId != pendingCid_ || ymd != pendingDay_.toString("yyyy-MM-dd")) return;
+    const CoverageBitmap bits = CoverageBitmap::unpack(packed);
+    emit coverageBuilt(pendingDay_, bits);
+    emit log(QString("[Timeline] coverage bitmap covered_s=%1").arg(bits.count()));
+}
+
+void PlaybackTimelineController::onEventsReady(int cameraId, qint64 fromNs, qint64, const EventList& events){
+    if (cameraId != pendingCid_ || fromNs != dayStartNs(pendingDay_)) return;
+    emit eventsBuilt(pendingDay_, fromNs, events);
+    emit log(QString("[Timeline] events=%1").arg(events.size()));
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <QObject>
 #include <QDate>
+#include "coverage_bitmap.h"
 #include "db_reader.h"
 #include "playback_timeline_model.h"
 
@@ -13,10 +14,14 @@ public:
     void setCameraResolver(const std::function<int(const QString&)>& fn) { resolveCamId_ = fn; }
 signals:
     void built(const QDate& day, const PlaybackTimelineModel& model);
+    void coverageBuilt(const QDate& day, const CoverageBitmap& bits);   // usually before built
+    void eventsBuilt(const QDate& day, qint64 dayStartNs, const EventList& events);
     void log(const QString& msg);
 public slots:
     void onGo(const QString& camName, const QDate& day);
     void onSegmentsReady(int cameraId, const SegmentList& segs);
+    void onCoverageReady(int cameraId, const QString& ymd, const QByteArray& packed);
+    void onEventsReady(int cameraId, qint64 fromNs, qint64 toNs, const EventList& events);
 private:
     DbReader* db_{nullptr};
     std::function<int(const QString&)> resolveCamId_;
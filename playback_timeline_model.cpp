@@ -1,8 +1,9 @@
 #include "playback_timeline_model.h"
+#include <QDateTime>
 #include <algorithm>
 
 static inline TimelineSpan clip(const TimelineSpan& s, qint64 a, qint64 b) {
-    TimelineSpan c{ std::max(s.start_ns, a), std::min(s.end_ns, b) };
+    TimelineSpan c{ std::max(s.start_ns, a), std::min(s.end_ns, b), s.open };
     if (c.end_ns < c.start_ns) c.end_ns = c.start_ns;
     return c;
 }
@@ -11,9 +12,12 @@ void PlaybackTimelineModel::build(qint64 dayStartNs, qint64 dayEndNs,
                                   const QVector<TimelineSpan>& raw) {
     t0_ = dayStartNs; t1_ = dayEndNs; spans_.clear();
 
-    // 1) Clip-by-day and drop outside
+    // 1) Clip-by-day and drop outside. An open row ends at the time it was
+    //    listed; it has footage up to now (capped at the next start in step 3).
+    const qint64 nowNs = QDateTime::currentMSecsSinceEpoch() * 1000000LL;
     QVector<TimelineSpan> v; v.reserve(raw.size());
-    for (const auto& s : raw) {
+    for (TimelineSpan s : raw) {
+        if (s.open) s.end_ns = std::max(s.end_ns, nowNs);
         if (s.end_ns <= dayStartNs || s.start_ns >= dayEndNs) continue;
         v.push_back(clip(s, dayStartNs, dayEndNs));
     }
@@ -43,6 +47,7 @@ void PlaybackTimelineModel::build(qint64 dayStartNs, qint64 dayEndNs,
             spans_.push_back(s);
         } else {
             spans_.last().end_ns = std::max(spans_.last().end_ns, s.end_ns);
+            spans_.last().open |= s.open;
         }
     }
 }
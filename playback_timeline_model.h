@@ -5,6 +5,7 @@
 struct TimelineSpan {
     qint64 start_ns{0};
     qint64 end_ns{0};
+    bool   open{false};   // still recording: drawn up to now
 };
 
 class PlaybackTimelineModel {
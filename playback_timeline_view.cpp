@@ -1,7 +1,9 @@
 #include "playback_timeline_view.h"
 #include <QPainter>
+#include <QDateTime>
 #include <QMouseEvent>
 #include <QtMath>
+#include <algorithm>
 
 PlaybackTimelineView::PlaybackTimelineView(QWidget* parent)
 : QWidget(parent)
@@ -13,9 +15,103 @@ setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
 
 void PlaybackTimelineView::setModel(const PlaybackTimelineModel* m) {
 model_ = m;
+mergeCoverage_();
 update();
 }
 
+void PlaybackTimelineView::setDay(qint64 dayStartNs, qint64 dayEndNs) {
+dayStartNs_ = dayStartNs;
+if (dayEndNs > dayStartNs) dayLenNs_ = dayEndNs - dayStartNs;
+setPlayheadNs(playheadNs_);
+}
+
+void PlaybackTimelineView::setCoverage(const CoverageBitmap& bits) {
+bitmapRuns_ = bits.runs();
+mergeCoverage_();
+update();
+}
+
+// Coverage is added when a segment is finalized, so the segment being
+// recorded is only in the model (open span); union the two.
+void PlaybackTimelineView::mergeCoverage_() {
+coverageRuns_.clear();
+coverageSec_ = 0;
+if (bitmapRuns_.isEmpty()) return;
+QVector<QPair<int,int>> all = bitmapRuns_;
+if (model_ && dayStartNs_ > 0) {
+    for (const auto& s : model_->spans()) {
+        if (!s.open) continue;
+        all.push_back({ int((s.start_ns - dayStartNs_) / 1000000000LL),
+                        int((s.end_ns - dayStartNs_ + 999999999LL) / 1000000000LL) });
+    }
+    std::sort(all.begin(), all.end());
+}
+for (const auto& run : all) {
+    if (!coverageRuns_.isEmpty() && run.first <= coverageRuns_.last().second)
+        coverageRuns_.last().second = qMax(coverageRuns_.last().second, run.second);
+    else
+        coverageRuns_.push_back(run);
+}
+for (const auto& run : coverageRuns_) coverageSec_ += run.second - run.first;
+}
+
+static QColor markerColor(int kind) {
+switch (EventKind(kind)) {
+case EventKind::StreamError:
+case EventKind::Error:            return QColor("#e5533d");
+case EventKind::StreamRestart:    return QColor("#f0a030");
+case EventKind::StorageMounted:
+case EventKind::StorageUnmounted: return QColor("#5aa0e6");
+case EventKind::Retention:        return QColor("#9a9a9a");
+case EventKind::Motion:           return QColor("#e6d74a");
+}
+return QColor("#cccccc");
+}
+
+static QString markerLabel(int kind) {
+switch (EventKind(kind)) {
+case EventKind::Error:            return "Error";
+case EventKind::StreamError:      return "Stream error";
+case EventKind::StreamRestart:    return "Stream restart";
+case EventKind::StorageMounted:   return "Storage mounted";
+case EventKind::StorageUnmounted: return "Storage removed";
+case EventKind::Retention:        return "Footage removed";
+case EventKind::Motion:           return "Motion";
+}
+return "Event";
+}
+
+void PlaybackTimelineView::setEvents(qint64 dayStartNs, const EventList& events) {
+markers_.clear();
+markers_.reserve(events.size());
+for (const auto& e : events) {
+    const qint64 ns = e.ts_ns - dayStartNs;
+    if (ns < 0 || ns >= dayNs_()) continue;
+    const QString when = QDateTime::fromMSecsSinceEpoch(e.ts_ns / 1000000).toString("HH:mm:ss");
+    QString text = QString("%1 %2").arg(when, markerLabel(e.kind));
+    if (!e.detail.isEmpty()) text += ": " + e.detail;
+    markers_.push_back({ ns, e.kind, text });
+}
+update();
+}
+
+QRect PlaybackTimelineView::markerStrip_(const QRect& r) const {
+return QRect(r.left() - kHandlePx, r.top() - 6, r.width() + 2*kHandlePx, 12);
+}
+
+// nearest marker within the hit width, in the strip along the top edge
+const PlaybackTimelineView::Marker* PlaybackTimelineView::markerAt_(const QPoint& pos, const QRect& r) const {
+if (markers_.isEmpty() || !markerStrip_(r).contains(pos)) return nullptr;
+const Marker* best = nullptr;
+int bestDx = kMarkerHitPx + 1;
+for (const auto& m : markers_) {
+    const int x = int(r.left() + m.ns / (qreal)dayNs_() * r.width());
+    const int dx = qAbs(x - pos.x());
+    if (dx < bestDx) { bestDx = dx; best = &m; }
+}
+return best;
+}
+
 void PlaybackTimelineView::setPlayheadNs(qint64 ns_from_midnight) {
 const qint64 d = dayNs_();
 if (ns_from_midnight < 0) ns_from_midnight = 0;
@@ -40,6 +136,11 @@ const int cx = int(r.left() + fx * r.width());
 return QRect(cx - kHandlePx, r.top()+1, 2*kHandlePx, r.height()-2);
 }
 
+bool PlaybackTimelineView::onHandle_(const QPoint& pos, const QRect& r) const {
+return selEnabled_ && (handleRectAt_(selStartNs_, r).contains(pos)
+                       || handleRectAt_(selEndNs_, r).contains(pos));
+}
+
 void PlaybackTimelineView::setSelection(qint64 s, qint64 e, bool enabled){
 selEnabled_ = enabled;
 selStartNs_ = qMax<qint64>(0, qMin(s, dayNs_()-1));
@@ -68,36 +169,50 @@ p.setPen(QColor("#2f2f2f")); p.drawRect(r.adjusted(-4,-6,4,10));
 p.fillRect(r, QColor("#242424"));
 p.setPen(QColor("#3a3a3a")); p.drawRect(r.adjusted(0,0,-1,-1));
 
-// grid
+// grid: one line per elapsed hour (23/24/25), labelled with the clock hour
 QFont f = p.font(); f.setPointSizeF(f.pointSizeF()*0.9); p.setFont(f);
+const int hours = int(dayNs_() / (3600LL*1000000000LL));
 p.setPen(QColor(60,60,60));
-for (int q=0; q<=24*4; ++q) {
-    const qreal fx = q/(24.0*4.0);
+for (int q=0; q<=hours*4; ++q) {
+    const qreal fx = q/(hours*4.0);
     const qreal x = r.left() + r.width()*fx;
     p.drawLine(QPointF(x, r.center().y()-6), QPointF(x, r.center().y()+6));
 }
 p.setPen(QColor(110,110,110));
-for (int h=0; h<=24; ++h) {
-    const qreal fx = h/24.0;
+for (int h=0; h<=hours; ++h) {
+    const qreal fx = h/qreal(hours);
     const qreal x = r.left() + r.width()*fx;
     p.drawLine(QPointF(x, r.top()), QPointF(x, r.bottom()));
-    const QString lab = QString("%1").arg(h,2,10,QChar('0'));
+    const int clock = (dayStartNs_ > 0 && h < hours)
+        ? QDateTime::fromMSecsSinceEpoch((dayStartNs_ + h*3600LL*1000000000LL) / 1000000).time().hour()
+        : h;
+    const QString lab = QString("%1").arg(clock,2,10,QChar('0'));
     const QRect tr(int(x)-14, r.bottom()+4, 28, 14);
     p.drawText(tr, Qt::AlignHCenter|Qt::AlignTop, lab);
 }
 
-if (model_) {
+auto drawSpan = [&](qreal fx1, qreal fx2) {
+    const int x1 = int(r.left() + fx1 * r.width());
+    const int x2 = int(r.left() + fx2 * r.width());
+    QRect seg(x1, r.top()+4, qMax(2, x2-x1), r.height()-8);
+    p.fillRect(seg, QColor("#3ddc84"));
+    p.setPen(QColor("#2aa864")); p.drawRect(seg.adjusted(0,0,-1,-1));
     p.setPen(Qt::NoPen);
-    for (const auto& s : model_->spans()) {
-        const qreal fx1 = model_->fractionFor(s.start_ns);
-        const qreal fx2 = model_->fractionFor(s.end_ns);
-        const int x1 = int(r.left() + fx1 * r.width());
-        const int x2 = int(r.left() + fx2 * r.width());
-        QRect seg(x1, r.top()+4, qMax(2, x2-x1), r.height()-8);
-        p.fillRect(seg, QColor("#3ddc84"));
-        p.setPen(QColor("#2aa864")); p.drawRect(seg.adjusted(0,0,-1,-1));
-        p.setPen(Qt::NoPen);
-    }
+};
+if (!coverageRuns_.isEmpty()) {
+    // bitmap runs: cost follows the gaps in the day, not the segment count
+    p.setPen(Qt::NoPen);
+    const qreal daySec = dayNs_() / 1e9;
+    for (const auto& run : coverageRuns_)
+        drawSpan(qMin<qreal>(1.0, run.first / daySec), qMin<qreal>(1.0, run.second / daySec));
+    p.setPen(QColor(180,180,180));
+    p.drawText(QRect(r.left(), r.top()-14, r.width(), 12),
+               Qt::AlignLeft|Qt::AlignVCenter,
+               QString("Coverage: %1%").arg(QString::number(qMin(100.0, coverageSec_ / daySec * 100.0), 'f', 1)));
+} else if (model_) {
+    p.setPen(Qt::NoPen);
+    for (const auto& s : model_->spans())
+        drawSpan(model_->fractionFor(s.start_ns), model_->fractionFor(s.end_ns));
 
     const qint64 covered = model_->totalCoveredNs();
     const qreal pct = (covered / (qreal)dayNs_()) * 100.0;
@@ -106,6 +221,18 @@ if (model_) {
                Qt::AlignLeft|Qt::AlignVCenter,
                QString("Coverage: %1%").arg(QString::number(pct, 'f', 1)));
 }
+// event markers: tick through the bar, cap above it
+for (const auto& m : markers_) {
+    const int x = int(r.left() + m.ns / (qreal)dayNs_() * r.width());
+    const QColor c = markerColor(m.kind);
+    p.setPen(QColor(c.red(), c.green(), c.blue(), 160));
+    p.drawLine(QPoint(x, r.top()), QPoint(x, r.bottom()));
+    p.setPen(Qt::NoPen);
+    p.setBrush(c);
+    const QPoint cap[3] = { QPoint(x-4, r.top()-6), QPoint(x+4, r.top()-6), QPoint(x, r.top()) };
+    p.drawPolygon(cap, 3);
+    p.setBrush(Qt::NoBrush);
+}
 // selection shading and handles (only when enabled)
     if (selEnabled_) {
         const qreal fx1 = qBound<qreal>(0.0, selStartNs_ / (qreal)dayNs_(), 1.0);
@@ -132,15 +259,22 @@ p.drawLine(QPoint(x, r.top()), QPoint(x, r.bottom()));
 
 void PlaybackTimelineView::mouseMoveEvent(QMouseEvent* e) {
 const QRect r = barRect();
+if (!dragging_ && !onHandle_(e->pos(), r)) {
+    if (const Marker* m = markerAt_(e->pos(), r)) { setToolTip(m->text); return; }
+}
 if (!r.contains(e->pos())) { setToolTip(QString()); return; }
 
 
 const qint64 t_ns = posToNs_(e->pos().x(), r);
 
-const qreal fx = qBound<qreal>(0.0, t_ns / (qreal)dayNs_(), 1.0);
-const int hh = int(fx * 24.0);
-const int mm = int(fmod(fx*24.0, 1.0) * 60.0);
-setToolTip(QString("%1:%2").arg(hh,2,10,QChar('0')).arg(mm,2,10,QChar('0')));
+if (dayStartNs_ > 0) {
+    setToolTip(QDateTime::fromMSecsSinceEpoch((dayStartNs_ + t_ns) / 1000000).toString("HH:mm"));
+} else {
+    const qreal fx = qBound<qreal>(0.0, t_ns / (qreal)dayNs_(), 1.0);
+    const int hh = int(fx * 24.0);
+    const int mm = int(fmod(fx*24.0, 1.0) * 60.0);
+    setToolTip(QString("%1:%2").arg(hh,2,10,QChar('0')).arg(mm,2,10,QChar('0')));
+}
 
 emit hoverTimeNs(t_ns);
 
@@ -171,12 +305,8 @@ if (dragging_) {
 void PlaybackTimelineView::mousePressEvent(QMouseEvent* e) {
 if (e->button()!=Qt::LeftButton) return;
 const QRect r = barRect();
-if (!r.contains(e->pos())) return;
-
-
-const qint64 t = posToNs_(e->pos().x(), r);
-
-    // If selection is enabled, check handle hit first
+    // If selection is enabled, check handle hit first (the marker strip
+    // overlaps the bar's top edge and must not steal a trim drag)
     if (selEnabled_) {
         const QRect hs = handleRectAt_(selStartNs_, r);
         const QRect he = handleRectAt_(selEndNs_,   r);
@@ -187,6 +317,17 @@ const qint64 t = posToNs_(e->pos().x(), r);
             dragging_ = true; dragKind_ = DragKind::EndHandle; return;
         }
     }
+if (const Marker* m = markerAt_(e->pos(), r)) {
+    // jump to the incident itself, not to the pixel that was hit
+    setPlayheadNs(m->ns);
+    emit seekRequested(m->ns);
+    return;
+}
+if (!r.contains(e->pos())) return;
+
+
+const qint64 t = posToNs_(e->pos().x(), r);
+
 dragging_ = true;
 dragKind_ = DragKind::Playhead;
 dragTick_.restart(); // start throttle window
@@ -1,6 +1,8 @@
 #pragma once
 #include <QWidget>
 #include <QElapsedTimer>
+#include "coverage_bitmap.h"
+#include "db_reader.h"
 #include "playback_timeline_model.h"
 
 class PlaybackTimelineView : public QWidget {
@@ -8,6 +10,16 @@ Q_OBJECT
 public:
 explicit PlaybackTimelineView(QWidget* parent=nullptr);
 void setModel(const PlaybackTimelineModel* m);
+// The local day shown: the bar spans [dayStartNs, dayEndNs), 23 or 25 h on
+// a DST change day; ns arguments below are offsets from dayStartNs.
+void setDay(qint64 dayStartNs, qint64 dayEndNs);
+qint64 dayLengthNs() const { return dayLenNs_; }
+// Day bitmap (day_coverage); when set, the bar is drawn from it instead of
+// the model spans. An empty bitmap falls back to the model. The bitmap only
+// has finalized segments; the model's open (recording) spans are merged in.
+void setCoverage(const CoverageBitmap& bits);
+// Event markers (DbReader::listEvents) above the bar; pressing one seeks to it.
+void setEvents(qint64 dayStartNs, const EventList& events);
 void setPlayheadNs(qint64 ns_from_midnight);
 qint64 playheadNs() const { return playheadNs_; }
 // --- Trim selection API ---
@@ -30,8 +42,18 @@ QSize sizeHint() const override { return {800, 64}; }
 
 private:
 const PlaybackTimelineModel* model_{nullptr};
+QVector<QPair<int,int>> bitmapRuns_;     // [start, end) seconds from midnight
+QVector<QPair<int,int>> coverageRuns_;   // bitmap runs + open model spans
+int coverageSec_ = 0;
+void mergeCoverage_();
+struct Marker { qint64 ns; int kind; QString text; };   // ns from midnight
+QVector<Marker> markers_;
+QRect markerStrip_(const QRect& bar) const;
+const Marker* markerAt_(const QPoint& pos, const QRect& bar) const;
 QRect  barRect() const;
-qint64 dayNs_() const { return 24LL*3600LL*1000000000LL; }
+qint64 dayNs_() const { return dayLenNs_; }
+qint64 dayStartNs_ = 0;                  // 0 = not set (plain 00-24 labels)
+qint64 dayLenNs_   = 24LL*3600LL*1000000000LL;
 
 qint64       playheadNs_ = 0;
 bool         dragging_   = false;
@@ -41,12 +63,14 @@ static constexpr int kDragEmitMs = 90; // ~11 Hz while dragging
 //trim selecion
 qint64 posToNs_(int x, const QRect& bar) const;
 QRect handleRectAt_(qint64 ns, const QRect& bar) const;
+bool  onHandle_(const QPoint& pos, const QRect& bar) const;   // over a trim handle (selection on)
 // --- Selection state ---
 bool   selEnabled_ = false;
 qint64 selStartNs_ = 0;
 qint64 selEndNs_   = 0;
 enum class DragKind { None, Playhead, StartHandle, EndHandle } dragKind_ = DragKind::None;
 static constexpr int kHandlePx = 8; // visual + hit area half-width
+static constexpr int kMarkerHitPx = 5;
 void clampSelection_();
 
 };
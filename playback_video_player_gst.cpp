@@ -1,4 +1,7 @@
 #include "playback_video_player_gst.h"
+#include "archive_cipher.h"
+#include "sched_policy.h"
+#include <QIODevice>
 #include <QTimer>
 #include <QDebug>
 #include <gst/video/videooverlay.h>
@@ -34,16 +37,26 @@ void PlaybackVideoPlayerGst::setWindowHandle(quintptr wid) {
 bool PlaybackVideoPlayerGst::open(const QString& path) {
     qInfo() << "[Player] Opening file:" << path;
 
+    // Pick a demuxer (fallback to decodebin if unknown)
+    const QString p = path.toLower();
+    const char* demuxFactory = "decodebin";
+    if      (p.endsWith(".mkv") || p.endsWith(".webm")) demuxFactory = "matroskademux";
+    else if (p.endsWith(".mp4") || p.endsWith(".mov") || p.endsWith(".m4v")) demuxFactory = "qtdemux";
+    else if (p.endsWith(".ts")) demuxFactory = "tsdemux";
+
+    // Cameras may record different containers, and encryption may have been
+    // switched on at some point: rebuild if the demuxer or the source changes
+    const bool encrypted = ArchiveCipher::isEncrypted(path);
+    if (pipeline && (demuxFactory_ != demuxFactory || encrypted_ != encrypted)) teardown();
+
     // First-time pipeline build
     if (!pipeline) {
         pipeline = gst_pipeline_new("playback-player");
-        filesrc  = mk("filesrc");
-
-        // Pick a demuxer (fallback to decodebin if unknown)
-        const QString p = path.toLower();
-        if      (p.endsWith(".mkv") || p.endsWith(".webm")) demux = mk("matroskademux");
-        else if (p.endsWith(".mp4") || p.endsWith(".mov") || p.endsWith(".m4v")) demux = mk("qtdemux");
-        else demux = mk("decodebin");
+        SchedPolicy::applyToStreamingThreads(pipeline, SchedClass::Playback);
+        filesrc  = mk(encrypted ? "appsrc" : "filesrc");
+        demux    = mk(demuxFactory);
+        demuxFactory_ = demuxFactory;
+        encrypted_ = encrypted;
 
         // Buffers around decode to smooth playback during seeks
         // filesrc ! demux ! queue_demux ! h264parse ! avdec_h264 ! queue_post ! videoconvert ! sink
@@ -65,6 +78,16 @@ bool PlaybackVideoPlayerGst::open(const QString& path) {
         g_object_set(queue_demux, "max-size-buffers", 0, "max-size-bytes", 0, "max-size-time", 2*GST_SECOND, nullptr);
         g_object_set(queue_post,  "max-size-buffers", 0, "max-size-bytes", 0, "max-size-time", 2*GST_SECOND, nullptr);
 
+        if (encrypted_) {
+            // pull mode like filesrc: the demuxer asks for byte ranges
+            g_object_set(filesrc, "stream-type", GST_APP_STREAM_TYPE_RANDOM_ACCESS,
+                         "format", GST_FORMAT_BYTES, nullptr);
+            GstAppSrcCallbacks cb = {};
+            cb.need_data = &PlaybackVideoPlayerGst::needData;
+            cb.seek_data = &PlaybackVideoPlayerGst::seekData;
+            gst_app_src_set_callbacks(GST_APP_SRC(filesrc), &cb, this, nullptr);
+        }
+
         if (g_object_class_find_property(G_OBJECT_GET_CLASS(videosink), "force-aspect-ratio"))
             g_object_set(videosink, "force-aspect-ratio", TRUE, nullptr);
         if (g_object_class_find_property(G_OBJECT_GET_CLASS(videosink), "sync"))
@@ -135,9 +158,23 @@ bool PlaybackVideoPlayerGst::open(const QString& path) {
         startTimers();
     }
 
+    // Keyframe table written while recording (absent for older files)
+    if (!kfIndex_.load(KeyframeIndex::sidecarPath(path))) kfIndex_.clear();
+
     // Reuse pipeline: go READY, swap location, preroll to PAUSED
     gst_element_set_state(pipeline, GST_STATE_READY);
-    g_object_set(filesrc, "location", path.toUtf8().constData(), nullptr);
+    if (encrypted_) {
+        QMutexLocker lk(&cipherMutex_);
+        cipherIn_.reset(ArchiveCipher::openForRead(path));
+        if (!cipherIn_) {
+            lk.unlock();
+            emit errorText("Cannot open " + path);
+            teardown(); return false;
+        }
+        gst_app_src_set_size(GST_APP_SRC(filesrc), cipherIn_->size());
+    } else {
+        g_object_set(filesrc, "location", path.toUtf8().constData(), nullptr);
+    }
     gst_element_set_state(pipeline, GST_STATE_PAUSED);
     if (gst_element_get_state(pipeline, nullptr, nullptr, 3*GST_SECOND) != GST_STATE_CHANGE_SUCCESS) {
         emit errorText("Preroll failed");
@@ -182,9 +219,16 @@ void PlaybackVideoPlayerGst::stop()  {
 
 bool PlaybackVideoPlayerGst::seekNs(qint64 t_ns) {
     if (!pipeline) return false;
-    // Interactive seeks: fast, keyframe-based, flushing
-    gboolean ok = gst_element_seek(pipeline, rate_, GST_FORMAT_TIME,
-        (GstSeekFlags)(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_NEAREST),
+    // Interactive seeks: fast, keyframe-based, flushing.
+    // With a keyframe table we already know where the keyframe is, so land on it
+    // directly instead of asking the demuxer to search for the nearest one.
+    GstSeekFlags flags = (GstSeekFlags)(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_NEAREST);
+    KeyframeIndex::Entry kf;
+    if (kfIndex_.floorEntry(t_ns, &kf)) {
+        t_ns  = kf.ptsNs;
+        flags = (GstSeekFlags)(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT);
+    }
+    gboolean ok = gst_element_seek(pipeline, rate_, GST_FORMAT_TIME, flags,
         GST_SEEK_TYPE_SET, t_ns,
         GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_NONE);
     // Do NOT auto-play here; the caller controls play/pause
@@ -217,11 +261,48 @@ void PlaybackVideoPlayerGst::teardown() {
     }
     if (busTimer) busTimer->stop();
     if (bus) { gst_object_unref(bus); bus = nullptr; }
+    {
+        QMutexLocker lk(&cipherMutex_);
+        cipherIn_.reset();
+    }
     filesrc = demux = parser = decoder = queue_demux = queue_post = vconv = videosink = nullptr;
     if (posTimer && posTimer->isActive()) posTimer->stop();
     stop();
 }
 
+// appsrc (random access): hand out exactly the range asked for, decrypted.
+void PlaybackVideoPlayerGst::needData(GstAppSrc* src, guint length, gpointer user) {
+    static const qint64 kMaxChunk = 4 * 1024 * 1024;
+    auto self = static_cast<PlaybackVideoPlayerGst*>(user);
+    QMutexLocker lk(&self->cipherMutex_);
+    QIODevice* in = self->cipherIn_.get();
+    const qint64 offset = in ? in->pos() : 0;
+    const qint64 n = in ? qMin(qMin<qint64>(length, kMaxChunk), in->size() - offset) : 0;
+    if (n <= 0) { gst_app_src_end_of_stream(src); return; }
+
+    GstBuffer* buf = gst_buffer_new_allocate(nullptr, gsize(n), nullptr);
+    GstMapInfo map;
+    qint64 got = -1;
+    if (gst_buffer_map(buf, &map, GST_MAP_WRITE)) {
+        got = in->read(reinterpret_cast<char*>(map.data), n);
+        gst_buffer_unmap(buf, &map);
+    }
+    if (got <= 0) {
+        gst_buffer_unref(buf);
+        gst_app_src_end_of_stream(src);
+        return;
+    }
+    if (got < n) gst_buffer_set_size(buf, gssize(got));
+    GST_BUFFER_OFFSET(buf) = guint64(offset);
+    gst_app_src_push_buffer(src, buf);     // takes ownership
+}
+
+gboolean PlaybackVideoPlayerGst::seekData(GstAppSrc*, guint64 offset, gpointer user) {
+    auto self = static_cast<PlaybackVideoPlayerGst*>(user);
+    QMutexLocker lk(&self->cipherMutex_);
+    return self->cipherIn_ && self->cipherIn_->seek(qint64(offset));
+}
+
 gboolean PlaybackVideoPlayerGst::bus_cb(GstBus*, GstMessage* msg, gpointer s) {
     auto self = static_cast<PlaybackVideoPlayerGst*>(s);
     switch (GST_MESSAGE_TYPE(msg)) {
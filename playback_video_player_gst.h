@@ -1,10 +1,15 @@
 #pragma once
 #include <QObject>
+#include <QMutex>
 #include <QString>
 #include <QTimer>
 #include <QtGlobal>
+#include <memory>
 #include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+#include "keyframe_index.h"
 
+class QIODevice;
 class QTimer;
 
 /**
@@ -15,6 +20,9 @@ class QTimer;
  * - open(path) → preroll (PAUSED)
  * - play(), pause(), stop()
  * - seekNs(t), setRate(r)
+ *   (seeks snap to the recorded keyframe table when a .kfi sidecar exists)
+ * Encrypted segments (ArchiveCipher) are read through a random-access appsrc
+ * that decrypts each range the demuxer pulls; plain files use filesrc.
  */
 class PlaybackVideoPlayerGst : public QObject {
     Q_OBJECT
@@ -45,12 +53,14 @@ public slots:                         // make invokable across threads
 private:
     void bindOverlay();
     static gboolean bus_cb(GstBus*, GstMessage*, gpointer);
+    static void     needData(GstAppSrc* src, guint length, gpointer user);
+    static gboolean seekData(GstAppSrc* src, guint64 offset, gpointer user);
 
     GstElement *queue_demux = nullptr;
     GstElement *queue_post  = nullptr;
     QTimer*     posTimer      = nullptr;
     GstElement* pipeline      = nullptr;
-    GstElement* filesrc       = nullptr;
+    GstElement* filesrc       = nullptr;   // appsrc when encrypted_
     GstElement* demux         = nullptr;
     GstElement* parser        = nullptr;
     GstElement* decoder       = nullptr;
@@ -58,6 +68,11 @@ private:
     GstElement* videosink     = nullptr;
     quintptr    winHandle     = 0;
     double      rate_         = 1.0;
+    QString     demuxFactory_;        // demuxer the pipeline was built with
+    bool        encrypted_    = false;
+    QMutex      cipherMutex_;         // cipherIn_ is read on the appsrc thread
+    std::unique_ptr<QIODevice> cipherIn_;   // decrypting reader of the open file
+    KeyframeIndex kfIndex_;           // sidecar of the open file (may be empty)
     QTimer* busTimer = nullptr;
     GstBus* bus = nullptr;
 };
@@ -75,6 +75,9 @@ PlaybackWindow::PlaybackWindow(QWidget* parent)
     qRegisterMetaType<SegmentInfo>("SegmentInfo");
     qRegisterMetaType<CamList>("CamList");
     qRegisterMetaType<SegmentList>("SegmentList");
+    qRegisterMetaType<DaySummaryList>("DaySummaryList");
+    qRegisterMetaType<EventList>("EventList");
+    qRegisterMetaType<QVector<int>>("QVector<int>");
 
     connect(controls, &PlaybackControlsWidget::cameraChanged,
             this, &PlaybackWindow::onUiCameraChanged);
@@ -85,12 +88,21 @@ PlaybackWindow::PlaybackWindow(QWidget* parent)
         connect(controls, &PlaybackControlsWidget::goPressed,
                 timelineCtl, &PlaybackTimelineController::onGo);
         connect(controls, &PlaybackControlsWidget::goPressed, this,
-                    [this](const QString& /*cam*/, const QDate& day){ currentDay_ = day; });
+                    [this](const QString& /*cam*/, const QDate& day){
+                        currentDay_ = day;
+                        timelineView->setDay(dayStartNs(day), dayEndNs(day));
+                    });
         connect(timelineCtl, &PlaybackTimelineController::built, this,
                     [this](const QDate&, const PlaybackTimelineModel& m){
                         timelineView->setModel(&m);
                         controls->setGoIdle();   // explicitly reset button
                     });
+        connect(timelineCtl, &PlaybackTimelineController::coverageBuilt, this,
+                    [this](const QDate&, const CoverageBitmap& bits){ timelineView->setCoverage(bits); });
+        connect(timelineCtl, &PlaybackTimelineController::eventsBuilt, this,
+                    [this](const QDate&, qint64 dayStartNs, const EventList& events){
+                        timelineView->setEvents(dayStartNs, events);
+                    });
         connect(timelineCtl, &PlaybackTimelineController::log, this,
                 [](const QString& s){ qInfo().noquote() << s; });
         // Timeline seek → stitching seek (wall clock)
@@ -104,6 +116,10 @@ PlaybackWindow::PlaybackWindow(QWidget* parent)
              }
              const qint64 wall = dayStartNs_ + t;
              QMetaObject::invokeMethod(stitch_, "seekWall", Qt::QueuedConnection, Q_ARG(qint64, wall));
+             // which other cameras can be switched to at this instant
+             if (db)
+                 QMetaObject::invokeMethod(db, "camerasAt", Qt::QueuedConnection, Q_ARG(qint64, wall),
+                                           Q_ARG(quint64, db->supersede(DbReader::CamerasAt)));
          });
 
             // Note: Side controls connections moved to initStitch_() to ensure proper timing
@@ -111,7 +127,7 @@ PlaybackWindow::PlaybackWindow(QWidget* parent)
                 // Checkbox toggles trim mode
                 connect(trimPanel, &PlaybackTrimPanel::trimModeToggled, this, [this](bool on){
                     trim_.enabled = on;
-                    const qint64 dayNs = 24LL*3600LL*1000000000LL;
+                    const qint64 dayNs = timelineView->dayLengthNs();
                     const qint64 ph = timelineView->playheadNs();
                     qint64 s = qBound<qint64>(0, ph, dayNs - 2'000'000'000LL);
                     qint64 e = qMin(s + 60LL*1000000000LL, dayNs - 1);
@@ -135,7 +151,7 @@ PlaybackWindow::PlaybackWindow(QWidget* parent)
                 });
                 connect(trimPanel, &PlaybackTrimPanel::endEditedNs, this, [this](qint64 e){
                     if (!trim_.enabled) return;
-                    const qint64 dayNs = 24LL*3600LL*1000000000LL;
+                    const qint64 dayNs = timelineView->dayLengthNs();
                     e = qBound<qint64>(trim_.start_ns + 1, e, dayNs - 1);
                     trim_.end_ns = e;
                     timelineView->setSelection(trim_.start_ns, trim_.end_ns, true);
@@ -250,10 +266,18 @@ void PlaybackWindow::openDb(const QString& dbPath) {
             });
             connect(db, &DbReader::camerasReady, this,
                     &PlaybackWindow::onCamerasReady, Qt::QueuedConnection);
+            connect(db, &DbReader::daySummaryReady, this,
+                    &PlaybackWindow::onDaySummaryReady, Qt::QueuedConnection);
             connect(db, &DbReader::daysReady,     this,
                     &PlaybackWindow::onDaysReady, Qt::QueuedConnection);
             connect(db, &DbReader::segmentsReady, this,
                     &PlaybackWindow::onSegmentsReady, Qt::QueuedConnection);
+            connect(db, &DbReader::camerasAtReady, this, [this](qint64, const QVector<int>& ids){
+                QSet<QString> names;
+                for (auto it = nameToId.cbegin(); it != nameToId.cend(); ++it)
+                    if (ids.contains(it.value())) names.insert(it.key());
+                controls->setCamerasWithFootage(names);
+            }, Qt::QueuedConnection);
             connect(db, &DbReader::error,         this,
                     [](const QString& e){ qWarning() << "[Playback] DB error:" << e; });
         }
@@ -299,14 +323,28 @@ void PlaybackWindow::onUiCameraChanged(const QString& camName) {
     }
     
     if (db && cid > 0) {
+        // only the last camera picked matters; older listDays are dropped
         QMetaObject::invokeMethod(db, "listDays", Qt::QueuedConnection,
-                                  Q_ARG(int, cid));
+                                  Q_ARG(int, cid),
+                                  Q_ARG(quint64, db->supersede(DbReader::Days)));
     } else {
         qWarning() << "[Playback] Cannot list days: db=" << (db != nullptr) << "cid=" << cid;
         qWarning() << "[Playback] This usually means the camera name doesn't match the database.";
         qWarning() << "[Playback] Check that camera names in cameras.json match those in the database.";
     }
 }
+// Precedes daysReady for the same camera: shades the calendar by coverage.
+void PlaybackWindow::onDaySummaryReady(int cameraId, const DaySummaryList& days) {
+    if (cameraId != selectedCamId) return;
+    QHash<QDate, double> coverage;
+    for (const DaySummary& d : days) {
+        const QDate day = QDate::fromString(d.day, "yyyy-MM-dd");
+        if (!day.isValid()) continue;
+        const double dayMs = (dayEndNs(day) - dayStartNs(day)) / 1e6;   // 23-25 h
+        coverage.insert(day, qBound(0.0, d.coveredMs / dayMs, 1.0));
+    }
+    controls->setDayCoverage(coverage);
+}
 void PlaybackWindow::onDaysReady(int cameraId, const QStringList& ymdList) {
     if (cameraId != selectedCamId) return;
 
@@ -360,6 +398,19 @@ void PlaybackWindow::onSegmentsReady(int cameraId, const SegmentList& segs) {
                     << "] end_ns=[" << minEnd << ".." << maxEnd << "]";
        }
 
+    // Warn up front about recordings the background verifier flagged
+    int damaged = 0, broken = 0;
+    for (const auto& s : segs) {
+        if (s.health == 2) ++damaged;
+        else if (s.health >= 3) ++broken;
+    }
+    if (titleBar) {
+        QString title = "Playback";
+        if (broken)  title += QString("  —  %1 recording(s) unreadable").arg(broken);
+        if (damaged) title += QString("  —  %1 recording(s) incomplete").arg(damaged);
+        titleBar->setTitle(title);
+    }
+
     // Compute day window (local midnight)
     dayStartNs_ = dayStartNs(day);
     dayEndNs_   = dayEndNs(day);
@@ -375,11 +426,14 @@ void PlaybackWindow::onSegmentsReady(int cameraId, const SegmentList& segs) {
 
     QVector<SegmentMeta> metas;
     metas.reserve(paths.size());
+    const auto& files = segIndex_.playlist();   // same order as the export
     for (int i=0;i<paths.size();++i) {
         metas.push_back({ paths[i],
                           dayStartNs_ + wallStarts[i],
                           offsets[i],
-                         durations[i] });
+                         durations[i],
+                          files[i].sub_path,
+                          files[i].sub_offset_ns });
     }
     // Feed stitching engine
     if (stitch_) {
@@ -393,7 +447,7 @@ void PlaybackWindow::onSegmentsReady(int cameraId, const SegmentList& segs) {
         // Update trim panel’s notion of the day start and clamp selection to new day
         if (trimPanel) trimPanel->setDayStartNs(dayStartNs_);
                 if (trim_.enabled) {
-                    const qint64 dayNs = 24LL*3600LL*1000000000LL;
+                    const qint64 dayNs = timelineView->dayLengthNs();
                     trim_.start_ns = qBound<qint64>(0, trim_.start_ns, dayNs - 2'000'000'000LL);
                     trim_.end_ns   = qBound<qint64>(trim_.start_ns + 1, trim_.end_ns, dayNs - 1);
                     if (timelineView) {
@@ -529,7 +583,7 @@ void PlaybackWindow::runGoFor(const QString& camName, const QDate& day) {
         });
         connect(sideControls, &PlaybackSideControls::forward10Clicked, this, [this](){
             if (!stitch_) return;
-            const qint64 dayNs = 24LL*3600LL*1000000000LL;
+            const qint64 dayNs = timelineView ? timelineView->dayLengthNs() : 24LL*3600LL*1000000000LL;
             qint64 t = timelineView ? timelineView->playheadNs() + 10LL*1000000000LL : 0;
             t = qMin<qint64>(dayNs - 1, t);
             if (trim_.enabled) t = qMin<qint64>(trim_.end_ns - 1, t);
@@ -77,6 +77,7 @@ private:
 
 private slots:
     void onCamerasReady(const CamList& cams);
+    void onDaySummaryReady(int cameraId, const DaySummaryList& days);
     void onDaysReady(int cameraId, const QStringList& ymdList);
     void onSegmentsReady(int cameraId, const SegmentList& segs);
     void onUiCameraChanged(const QString& camName);
@@ -0,0 +1,62 @@
+#include "recording_stats.h"
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <algorithm>
+
+static const size_t kMaxPending = 512;   // ~20 s at 25 fps; beyond that timestamps don't line up
+static const int    kMaxSamples = 600;
+
+static qint64 monotonicNs() {
+    static QElapsedTimer clock = []{ QElapsedTimer t; t.start(); return t; }();
+    return clock.nsecsElapsed();
+}
+
+void RecordingStats::onIngress(qint64 ptsNs, qint64 bytes) {
+    bytesIn_.fetch_add(bytes, std::memory_order_relaxed);
+    framesIn_.fetch_add(1, std::memory_order_relaxed);
+    if (ptsNs < 0) return;
+
+    QMutexLocker lk(&mutex_);
+    if (pending_.size() >= kMaxPending) pending_.pop_front();
+    pending_.push_back({ ptsNs, monotonicNs() });
+}
+
+void RecordingStats::onWritten(qint64 ptsNs, qint64 bytes) {
+    bytesWritten_.fetch_add(bytes, std::memory_order_relaxed);
+    if (ptsNs < 0) return;
+
+    QMutexLocker lk(&mutex_);
+    qint64 at = -1;
+    while (!pending_.empty() && pending_.front().ptsNs <= ptsNs) {
+        at = pending_.front().atNs;
+        pending_.pop_front();
+    }
+    if (at < 0) return;
+    const qint64 ms = (monotonicNs() - at) / 1000000;
+    if (latencyMs_.size() < kMaxSamples) latencyMs_.push_back(ms);
+    else latencyMs_[latencyNext_] = ms;
+    latencyNext_ = (latencyNext_ + 1) % kMaxSamples;
+}
+
+RecordingStats::Snapshot RecordingStats::snapshot() {
+    Snapshot s;
+    s.bytesIn      = bytesIn_.load(std::memory_order_relaxed);
+    s.framesIn     = framesIn_.load(std::memory_order_relaxed);
+    s.bytesWritten = bytesWritten_.load(std::memory_order_relaxed);
+
+    QVector<qint64> v;
+    {
+        QMutexLocker lk(&mutex_);
+        v = latencyMs_;
+    }
+    if (v.isEmpty()) return s;
+    auto pct = [&v](int p) {
+        const int k = std::min(v.size() - 1, v.size() * p / 100);
+        std::nth_element(v.begin(), v.begin() + k, v.end());
+        return v[k];
+    };
+    s.p50Ms = pct(50);
+    s.p95Ms = pct(95);
+    s.p99Ms = pct(99);
+    return s;
+}
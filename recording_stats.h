@@ -0,0 +1,45 @@
+#pragma once
+#include <QMutex>
+#include <QVector>
+#include <atomic>
+#include <deque>
+
+/**
+ * RecordingStats
+ * --------------
+ * Per-camera counters shared by the GStreamer streaming threads of one
+ * ArchiveWorker and read once a second by ArchiveManager.
+ *
+ * - onIngress(): frames/bytes handed to splitmuxsink (h264parse src pad)
+ * - onWritten(): bytes handed to the segment file (ArchiveSinkTap)
+ *
+ * Write latency is "frame entered the muxer" → "frame reached the file sink",
+ * matched by PTS. It includes splitmuxsink's one-GOP hold-back, so the
+ * baseline is roughly the GOP length; growth beyond that means the disk is
+ * not keeping up.
+ */
+class RecordingStats {
+public:
+    struct Snapshot {
+        qint64 bytesIn = 0;        // cumulative
+        qint64 framesIn = 0;       // cumulative
+        qint64 bytesWritten = 0;   // cumulative
+        qint64 p50Ms = -1, p95Ms = -1, p99Ms = -1;   // -1 = no samples yet
+    };
+
+    void onIngress(qint64 ptsNs, qint64 bytes);
+    void onWritten(qint64 ptsNs, qint64 bytes);
+    Snapshot snapshot();
+
+private:
+    struct Pending { qint64 ptsNs; qint64 atNs; };
+
+    std::atomic<qint64> bytesIn_{0};
+    std::atomic<qint64> framesIn_{0};
+    std::atomic<qint64> bytesWritten_{0};
+
+    QMutex mutex_;                  // guards the two containers below
+    std::deque<Pending> pending_;   // ingress times not yet seen at the sink
+    QVector<qint64> latencyMs_;     // ring of recent samples
+    int latencyNext_ = 0;
+};
@@ -0,0 +1,144 @@
+#include "sched_policy.h"
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QDebug>
+#include <gst/gst.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const int kIoprioWhoProcess = 1;   // a task id: thread or process
+static const int kIoprioClassShift = 13;
+
+static const char* key(SchedClass c) {
+    switch (c) {
+    case SchedClass::Recording:  return "recording";
+    case SchedClass::Database:   return "database";
+    case SchedClass::LiveView:   return "live_view";
+    case SchedClass::Playback:   return "playback";
+    case SchedClass::Export:     return "export";
+    case SchedClass::Background: return "background";
+    }
+    return "";
+}
+
+static SchedSettings defaults(SchedClass c) {
+    SchedSettings s;
+    switch (c) {
+    case SchedClass::Recording:  s.nice = -5; s.ioClass = 2; s.ioLevel = 0; break;
+    case SchedClass::Database:   s.nice = -2; s.ioClass = 2; s.ioLevel = 1; break;
+    case SchedClass::LiveView:   s.nice = 0;  s.ioClass = 2; s.ioLevel = 4; break;
+    case SchedClass::Playback:   s.nice = 5;  s.ioClass = 2; s.ioLevel = 5; break;
+    case SchedClass::Export:     s.nice = 10; s.ioClass = 2; s.ioLevel = 7; break;
+    case SchedClass::Background: s.nice = 19; s.ioClass = 3; s.ioLevel = 7; break;
+    }
+    return s;
+}
+
+static QHash<int, SchedSettings> load() {
+    QHash<int, SchedSettings> all;
+    const SchedClass classes[] = { SchedClass::Recording, SchedClass::Database, SchedClass::LiveView,
+                                   SchedClass::Playback, SchedClass::Export, SchedClass::Background };
+    for (SchedClass c : classes) all.insert(int(c), defaults(c));
+
+    QFile f(SchedPolicy::configPath());
+    if (!f.open(QIODevice::ReadOnly)) return all;
+    const QJsonObject root = QJsonDocument::fromJson(f.readAll()).object();
+    for (SchedClass c : classes) {
+        const QJsonObject o = root.value(key(c)).toObject();
+        if (o.isEmpty()) continue;
+        SchedSettings& s = all[int(c)];
+        s.nice = qBound(-20, o.value("nice").toInt(s.nice), 19);
+        const QString io = o.value("io_class").toString();
+        if (io == "rt")        s.ioClass = 1;
+        else if (io == "be")   s.ioClass = 2;
+        else if (io == "idle") s.ioClass = 3;
+        s.ioLevel = qBound(0, o.value("io_level").toInt(s.ioLevel), 7);
+        const QJsonArray cpus = o.value("cpus").toArray();
+        if (!cpus.isEmpty()) {
+            s.cpus.clear();
+            for (const QJsonValue& v : cpus) s.cpus << v.toInt();
+        }
+        qInfo() << "[Sched]" << key(c) << "nice" << s.nice << "io" << s.ioClass << "/" << s.ioLevel
+                << "cpus" << s.cpus;
+    }
+    return all;
+}
+
+SchedSettings SchedPolicy::settings(SchedClass c) {
+    static const QHash<int, SchedSettings> all = load();    // once per process, thread-safe
+    return all.value(int(c));
+}
+
+QString SchedPolicy::configPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation) + "/sched.json";
+}
+
+// One task (thread or single-threaded process) by kernel id.
+static void applyToTask(pid_t tid, SchedClass c) {
+    static std::atomic<bool> niceWarned{false}, ioWarned{false}, cpuWarned{false};
+    const SchedSettings s = SchedPolicy::settings(c);
+
+    if (setpriority(PRIO_PROCESS, id_t(tid), s.nice) != 0 && !niceWarned.exchange(true))
+        qInfo() << "[Sched] cannot set nice" << s.nice << "for" << key(c) << ":" << strerror(errno);
+#ifdef SYS_ioprio_set
+    if (syscall(SYS_ioprio_set, kIoprioWhoProcess, int(tid),
+                (s.ioClass << kIoprioClassShift) | s.ioLevel) != 0 && !ioWarned.exchange(true))
+        qInfo() << "[Sched] cannot set I/O class" << s.ioClass << "for" << key(c) << ":" << strerror(errno);
+#endif
+    if (!s.cpus.isEmpty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : s.cpus)
+            if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+        if (sched_setaffinity(tid, sizeof(set), &set) != 0 && !cpuWarned.exchange(true))
+            qWarning() << "[Sched] cannot pin" << key(c) << "to" << s.cpus << ":" << strerror(errno);
+    }
+}
+
+void SchedPolicy::applyToCurrentThread(SchedClass c) {
+    applyToTask(pid_t(syscall(SYS_gettid)), c);
+}
+
+void SchedPolicy::applyToProcess(qint64 pid, SchedClass c) {
+    if (pid <= 0) return;
+    // threads it already started as well (ffmpeg spins up its pool early)
+    const QStringList tasks = QDir(QString("/proc/%1/task").arg(pid))
+                                  .entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    if (tasks.isEmpty()) { applyToTask(pid_t(pid), c); return; }
+    for (const QString& t : tasks) applyToTask(pid_t(t.toInt()), c);
+}
+
+// class + 1 on the pipeline's bus; set once the handler is connected
+static const char* kBusClassKey = "camvigil-sched-class";
+
+static void onStreamStatus(GstBus* bus, GstMessage* msg, gpointer) {
+    GstStreamStatusType type;
+    GstElement* owner = nullptr;
+    gst_message_parse_stream_status(msg, &type, &owner);
+    const int c = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(bus), kBusClassKey)) - 1;
+    if (type == GST_STREAM_STATUS_TYPE_ENTER && c >= 0)   // posted from the new thread itself
+        SchedPolicy::applyToCurrentThread(SchedClass(c));
+}
+
+void SchedPolicy::applyToStreamingThreads(GstElement* pipeline, SchedClass c) {
+    if (!pipeline) return;
+    GstBus* bus = gst_element_get_bus(pipeline);
+    // a reused pipeline keeps its handler; only the class is updated
+    const bool connected = g_object_get_data(G_OBJECT(bus), kBusClassKey) != nullptr;
+    g_object_set_data(G_OBJECT(bus), kBusClassKey, GINT_TO_POINTER(int(c) + 1));
+    if (!connected) {
+        gst_bus_enable_sync_message_emission(bus);
+        g_signal_connect(bus, "sync-message::stream-status", G_CALLBACK(onStreamStatus), nullptr);
+    }
+    gst_object_unref(bus);
+}
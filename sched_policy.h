@@ -0,0 +1,52 @@
+#pragma once
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+typedef struct _GstElement GstElement;
+
+// Who gets the CPU and the disk first. Recording must never lose packets
+// to a heavy export or playback, so every thread and child process that
+// does real work is put in one of these classes.
+enum class SchedClass {
+    Recording,     // ArchiveWorker threads + their GStreamer streaming threads
+    Database,      // DbWriter thread (segment rows are part of recording)
+    LiveView,      // live decode pipelines
+    Playback,      // playback decode pipelines
+    Export,        // ffmpeg export children
+    Background,    // transcoder / compactor children
+};
+
+// nice value, I/O class (ioprio: 1 realtime, 2 best-effort, 3 idle) with
+// level 0-7, and CPU set (empty = any CPU).
+struct SchedSettings {
+    int          nice    = 0;
+    int          ioClass = 2;
+    int          ioLevel = 4;
+    QVector<int> cpus;
+};
+
+// Defaults, overridable per class in <AppConfigLocation>/sched.json:
+//   { "recording": { "nice": -5, "io_class": "be", "io_level": 0, "cpus": [2,3] }, ... }
+// keys: recording, database, live_view, playback, export, background;
+// io_class: "rt", "be" or "idle".
+//
+// Linux applies nice, ioprio and affinity per thread (a thread is a task),
+// so threads of one process can sit in different classes. A negative nice
+// or the realtime I/O class needs CAP_SYS_NICE / CAP_SYS_ADMIN; without it
+// the class keeps the current value (logged once), which still leaves
+// recording ahead of everything that is lowered.
+class SchedPolicy final {
+public:
+    static SchedSettings settings(SchedClass c);
+    static QString configPath();
+
+    // The calling thread.
+    static void applyToCurrentThread(SchedClass c);
+    // A child process (QProcess::processId()); threads it starts inherit it.
+    static void applyToProcess(qint64 pid, SchedClass c);
+    // Every streaming thread the pipeline starts from now on (stream-status
+    // ENTER, handled synchronously on the new thread). Call before PLAYING;
+    // calling it again for the same pipeline only changes the class.
+    static void applyToStreamingThreads(GstElement* pipeline, SchedClass c);
+};
@@ -0,0 +1,130 @@
+#include "segment_hash.h"
+#include <QCryptographicHash>
+#include <QFile>
+#include <atomic>
+#include <cstring>
+
+static QByteArray sha256(const QByteArray& data) {
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+}
+
+// grows with the furthest patch any muxer made behind its write position
+static std::atomic<qint64> s_window{SegmentHasher::kMinWindow};
+
+qint64 SegmentHasher::window() {
+    return s_window.load(std::memory_order_relaxed);
+}
+
+void SegmentHasher::write(qint64 offset, const char* data, qint64 size) {
+    if (size <= 0) return;
+    if (offset < end_) {
+        const qint64 behind = qMin(kMaxWindow, (end_ - offset + kBlockSize - 1) / kBlockSize * kBlockSize);
+        qint64 w = window();
+        while (behind > w && !s_window.compare_exchange_weak(w, behind)) {}
+    }
+    qint64 done = 0;
+    while (done < size) {
+        const qint64 at    = offset + done;
+        const qint64 index = at / kBlockSize;
+        const qint64 inBlk = at % kBlockSize;
+        const qint64 n     = qMin(size - done, kBlockSize - inBlk);
+        if (index < digests_.size() && !digests_[int(index)].isEmpty()) {
+            // behind the window: finish() takes this block from disk
+            stale_.insert(index);
+            patches_.append({ at, QByteArray(data + done, int(n)) });
+            done += n;
+            continue;
+        }
+        QByteArray& blk = pending_[index];
+        if (blk.size() < inBlk + n) {
+            const int old = blk.size();
+            blk.resize(int(inBlk + n));
+            if (old < inBlk) memset(blk.data() + old, 0, size_t(inBlk - old));  // hole
+        }
+        memcpy(blk.data() + inBlk, data + done, size_t(n));
+        done += n;
+    }
+    end_ = qMax(end_, offset + size);
+
+    // the header block stays until finish(); the rest once safely behind
+    const qint64 win = window();
+    auto it = pending_.begin();
+    if (it != pending_.end() && it.key() == 0) ++it;
+    while (it != pending_.end() && (it.key() + 1) * kBlockSize + win <= end_) {
+        const qint64 index = it.key();
+        ++it;
+        hashBlock(index, kBlockSize);
+    }
+}
+
+void SegmentHasher::hashBlock(qint64 index, qint64 length) {
+    QByteArray blk = pending_.take(index);
+    if (blk.size() < length) blk.append(QByteArray(int(length - blk.size()), '\0'));
+    if (digests_.size() <= index) digests_.resize(int(index + 1));
+    digests_[int(index)] = sha256(blk);
+}
+
+// Stale blocks are far behind the write position, so their appended bytes
+// reached the file long ago; a patch may still sit in the sink's buffer,
+// hence the overlay.
+bool SegmentHasher::rehashStale(const QString& path) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) return false;
+    for (qint64 index : stale_) {
+        const qint64 base   = index * kBlockSize;
+        const qint64 length = qMin(kBlockSize, end_ - base);
+        if (!f.seek(base)) return false;
+        QByteArray blk = f.read(length);
+        if (blk.size() < length) return false;
+        for (const Patch& p : patches_) {
+            const qint64 from = qMax(p.offset, base);
+            const qint64 to   = qMin(p.offset + p.data.size(), base + length);
+            if (from < to)
+                memcpy(blk.data() + (from - base), p.data.constData() + (from - p.offset), size_t(to - from));
+        }
+        digests_[int(index)] = sha256(blk);
+    }
+    return true;
+}
+
+QByteArray SegmentHasher::finish(const QString& path, int* rehashed) {
+    QByteArray out;
+    if (rehashed) *rehashed = stale_.size();
+    if (end_ > 0 && (stale_.isEmpty() || rehashStale(path))) {
+        const qint64 blocks = (end_ + kBlockSize - 1) / kBlockSize;
+        QByteArray list;
+        list.reserve(int(blocks * 32));
+        for (qint64 i = 0; i < blocks; ++i) {
+            if (i >= digests_.size() || digests_[int(i)].isEmpty())
+                hashBlock(i, qMin(kBlockSize, end_ - i * kBlockSize));
+            list.append(digests_[int(i)]);
+        }
+        out = sha256(list);
+    }
+    reset();
+    return out;
+}
+
+void SegmentHasher::reset() {
+    pending_.clear();
+    digests_.clear();
+    stale_.clear();
+    patches_.clear();
+    end_ = 0;
+}
+
+QByteArray SegmentHasher::fileDigest(const QString& path) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) return QByteArray();
+    QByteArray list;
+    while (!f.atEnd()) {
+        const QByteArray blk = f.read(kBlockSize);
+        if (blk.isEmpty()) return QByteArray();   // read error
+        list.append(sha256(blk));
+    }
+    return list.isEmpty() ? QByteArray() : sha256(list);
+}
+
+QByteArray SegmentHasher::chain(const QByteArray& prevChain, const QByteArray& digest) {
+    return sha256(prevChain + digest);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <QByteArray>
+#include <QMap>
+#include <QSet>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+// Tamper-evidence digest of a segment file, built from the bytes handed to
+// the file sink so the file is never read back.
+//
+// digest = SHA-256( SHA-256(block 0) || SHA-256(block 1) || ... )
+// over 1 MiB blocks of the final file (the last one may be short).
+// Blocks are needed because muxers overwrite what they already wrote: MKV
+// patches each cluster's size just behind the write position and the
+// segment header at the very end. A block is hashed once the writer is
+// window() past it; block 0 waits for finish(). fileDigest() computes the
+// same value from disk.
+//
+// The window starts at one typical cluster and grows (up to kMaxWindow,
+// shared by all hashers) to the furthest patch seen behind the write
+// position. A patch into a block already hashed makes it stale: finish()
+// reads that block back from the file and applies the patches seen since,
+// so the digest still covers the final bytes.
+//
+// chain = SHA-256(previous chain || digest), raw bytes, per camera stream.
+class SegmentHasher final {
+public:
+    static constexpr qint64 kBlockSize = 1 << 20;
+    static constexpr qint64 kMinWindow = 4 * kBlockSize;    // > one MKV cluster (one GOP)
+    static constexpr qint64 kMaxWindow = 16 * kBlockSize;   // held in memory per file
+
+    void write(qint64 offset, const char* data, qint64 size);
+    // Digest of everything written, stale blocks re-read from path; empty if
+    // nothing was written or a stale block could not be read. *rehashed:
+    // blocks taken from disk. Resets the hasher.
+    QByteArray finish(const QString& path, int* rehashed = nullptr);
+    void reset();
+    static qint64 window();
+
+    static QByteArray fileDigest(const QString& path);
+    static QByteArray chain(const QByteArray& prevChain, const QByteArray& digest);
+
+private:
+    struct Patch { qint64 offset; QByteArray data; };
+
+    void hashBlock(qint64 index, qint64 length);
+    bool rehashStale(const QString& path);
+
+    QMap<qint64, QByteArray> pending_;  // block index -> bytes so far
+    QVector<QByteArray>      digests_;  // per block; empty = still pending
+    QSet<qint64>             stale_;    // hashed, then patched
+    QVector<Patch>           patches_;  // writes into stale blocks, in order
+    qint64 end_ = 0;                    // end of the furthest write
+};
@@ -0,0 +1,180 @@
+#include "storage_monitor.h"
+#include <QDBusConnection>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRegExp>
+#include <QSocketNotifier>
+#include <QStorageInfo>
+#include <QTimer>
+#include <libudev.h>
+
+static const int kDebounceMs   = 750;     // udev fires several events per plug
+static const int kCapacityMs   = 10000;
+
+StorageMonitor::StorageMonitor(QObject* parent) : QObject(parent) {
+    qRegisterMetaType<StorageState>("StorageState");
+}
+
+StorageMonitor::~StorageMonitor() {
+    if (notifier_) notifier_->setEnabled(false);
+    if (udevMonitor_) udev_monitor_unref(udevMonitor_);
+    if (udev_) udev_unref(udev_);
+}
+
+StorageState StorageMonitor::state() const {
+    QMutexLocker lk(&mutex_);
+    return state_;
+}
+
+void StorageMonitor::start() {
+    debounce_ = new QTimer(this);
+    debounce_->setSingleShot(true);
+    debounce_->setInterval(kDebounceMs);
+    connect(debounce_, &QTimer::timeout, this, &StorageMonitor::rescan);
+
+    capacityTimer_ = new QTimer(this);
+    connect(capacityTimer_, &QTimer::timeout, this, &StorageMonitor::refreshCapacity);
+    capacityTimer_->start(kCapacityMs);
+
+    setupUdev();
+
+    bool okMount = QDBusConnection::systemBus().connect(
+        "com.idonial.automount", "/com/idonial/automount", "com.idonial.automount",
+        "Mounted", this, SLOT(onMounted(QString,QString)));
+    bool okUnmount = QDBusConnection::systemBus().connect(
+        "com.idonial.automount", "/com/idonial/automount", "com.idonial.automount",
+        "Unmounted", this, SLOT(onUnmounted(QString,QString)));
+    qDebug() << "[Storage] automount-core subscriptions:" << okMount << okUnmount;
+
+    rescan();   // initial state, synchronously
+}
+
+void StorageMonitor::setSpoolDir(const QString& dir) {
+    spoolDir_ = dir;
+}
+
+void StorageMonitor::setupUdev() {
+    udev_ = udev_new();
+    if (!udev_) {
+        qWarning() << "[Storage] Cannot create udev";
+        return;
+    }
+    udevMonitor_ = udev_monitor_new_from_netlink(udev_, "udev");
+    if (!udevMonitor_) {
+        qWarning() << "[Storage] Cannot create udev monitor";
+        udev_unref(udev_);
+        udev_ = nullptr;
+        return;
+    }
+    udev_monitor_filter_add_match_subsystem_devtype(udevMonitor_, "block", nullptr);
+    udev_monitor_enable_receiving(udevMonitor_);
+    notifier_ = new QSocketNotifier(udev_monitor_get_fd(udevMonitor_), QSocketNotifier::Read, this);
+    connect(notifier_, &QSocketNotifier::activated, this, &StorageMonitor::onUdevReadable);
+}
+
+void StorageMonitor::onUdevReadable() {
+    // drain everything pending; the rescan decides what changed
+    while (struct udev_device* dev = udev_monitor_receive_device(udevMonitor_)) {
+        const char* action = udev_device_get_action(dev);
+        const char* node   = udev_device_get_devnode(dev);
+        qDebug() << "[Storage] udev:" << (action ? action : "?") << (node ? node : "?");
+        udev_device_unref(dev);
+    }
+    debounce_->start();
+}
+
+void StorageMonitor::onMounted(const QString& device, const QString& path) {
+    qDebug() << "[Storage] mounted:" << device << "→" << path;
+    debounce_->start();
+}
+
+void StorageMonitor::onUnmounted(const QString& device, const QString& path) {
+    qDebug() << "[Storage] unmounted:" << device << "→" << path;
+    debounce_->start();
+}
+
+static bool isKernelRemovable(const QStorageInfo &storage)
+{
+    QString devicePath = QString::fromUtf8(storage.device());
+    QString devFileName = QFileInfo(devicePath).fileName();
+    devFileName.remove(QRegExp("\\d+$"));
+    QString sysRemovablePath = QString("/sys/block/%1/removable").arg(devFileName);
+    QFile removableFile(sysRemovablePath);
+    if (!removableFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QByteArray content = removableFile.readAll().trimmed();
+    return (content == "1");
+}
+
+QString StorageMonitor::scanRemovableMount(QString* device) {
+    const QList<QStorageInfo> storages = QStorageInfo::mountedVolumes();
+    for (const QStorageInfo &storage : storages) {
+        if (storage.isValid() && storage.isReady() && !storage.isReadOnly()) {
+            QString rootPath = storage.rootPath();
+            if ((rootPath.startsWith("/media") || rootPath.startsWith("/run/media"))
+                && isKernelRemovable(storage))
+            {
+                *device = QString::fromUtf8(storage.device());
+                return rootPath;
+            }
+        }
+    }
+    return QString();
+}
+
+void StorageMonitor::rescan() {
+    StorageState next;
+    next.mountRoot = scanRemovableMount(&next.device);
+    if (next.isPresent()) {
+        const QStorageInfo info(next.mountRoot);
+        next.bytesTotal = info.bytesTotal();
+        next.bytesAvailable = info.bytesAvailable();
+    }
+    if (!spoolDir_.isEmpty()) {
+        const QStorageInfo spool(spoolDir_);
+        next.spoolBytesTotal = spool.bytesTotal();
+        next.spoolBytesAvailable = spool.bytesAvailable();
+    }
+
+    bool changed;
+    {
+        QMutexLocker lk(&mutex_);
+        changed = next.mountRoot != state_.mountRoot || next.device != state_.device;
+        state_ = next;
+    }
+    if (changed) {
+        qDebug() << "[Storage] media:" << (next.isPresent() ? next.mountRoot : QString("<none>"));
+        emit mediaChanged(next);
+    }
+    emit capacityChanged(next);
+}
+
+void StorageMonitor::refreshCapacity() {
+    StorageState s = state();
+    if (!spoolDir_.isEmpty()) {
+        const QStorageInfo spool(spoolDir_);
+        s.spoolBytesTotal = spool.bytesTotal();
+        s.spoolBytesAvailable = spool.bytesAvailable();
+    }
+    if (s.isPresent()) {
+        QStorageInfo info(s.mountRoot);
+        if (!info.isValid() || !info.isReady()) {   // yanked without an event yet
+            debounce_->start();
+            return;
+        }
+        s.bytesTotal = info.bytesTotal();
+        s.bytesAvailable = info.bytesAvailable();
+    }
+    {
+        QMutexLocker lk(&mutex_);
+        if (state_.mountRoot != s.mountRoot) return;   // raced with a rescan
+        state_.bytesTotal = s.bytesTotal;
+        state_.bytesAvailable = s.bytesAvailable;
+        state_.spoolBytesTotal = s.spoolBytesTotal;
+        state_.spoolBytesAvailable = s.spoolBytesAvailable;
+    }
+    emit capacityChanged(s);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <QObject>
+#include <QMetaType>
+#include <QMutex>
+#include <QString>
+
+struct udev;
+struct udev_monitor;
+class QSocketNotifier;
+class QTimer;
+
+// Cached view of the removable archive medium.
+struct StorageState {
+    QString mountRoot;           // empty = no removable media
+    QString device;
+    qint64  bytesTotal = 0;
+    qint64  bytesAvailable = 0;
+    qint64  spoolBytesTotal = 0;       // internal spool filesystem (setSpoolDir)
+    qint64  spoolBytesAvailable = 0;
+    bool isPresent() const { return !mountRoot.isEmpty(); }
+};
+Q_DECLARE_METATYPE(StorageState)
+
+/**
+ * StorageMonitor
+ * --------------
+ * Single owner of removable-storage detection. Lives on its own thread
+ * (owner calls moveToThread, then invokes start()).
+ *
+ * udev block events and the automount D-Bus Mounted/Unmounted signals only
+ * arm a debounce timer; one rescan then walks the mount table. Capacity is
+ * refreshed periodically here, for the media and for the internal spool,
+ * so callers read state() (a cached copy) and never touch the filesystem
+ * themselves.
+ */
+class StorageMonitor : public QObject {
+    Q_OBJECT
+public:
+    explicit StorageMonitor(QObject* parent = nullptr);
+    ~StorageMonitor();
+
+    StorageState state() const;  // thread-safe
+
+public slots:
+    void start();
+    void setSpoolDir(const QString& dir);   // before start()
+
+signals:
+    void mediaChanged(const StorageState& state);     // inserted / removed / remounted
+    void capacityChanged(const StorageState& state);
+
+private slots:
+    void onUdevReadable();
+    void onMounted(const QString& device, const QString& path);
+    void onUnmounted(const QString& device, const QString& path);
+    void rescan();
+    void refreshCapacity();
+
+private:
+    static QString scanRemovableMount(QString* device);
+    void setupUdev();
+
+    struct udev*         udev_ = nullptr;
+    struct udev_monitor* udevMonitor_ = nullptr;
+    QSocketNotifier*     notifier_ = nullptr;
+    QTimer*              debounce_ = nullptr;
+    QTimer*              capacityTimer_ = nullptr;
+    QString              spoolDir_;
+
+    mutable QMutex mutex_;
+    StorageState   state_;
+};
@@ -1,6 +1,5 @@
 #include "storagedetailswidget.h"
 #include <QFormLayout>
-#include <QStorageInfo>
 #include <QComboBox>
 #include <QLabel>
 #include <QDebug>
@@ -27,6 +26,18 @@ StorageDetailsWidget::StorageDetailsWidget(ArchiveManager* archiveManager, QWidg
     capacityDetailsLabel->setStyleSheet("font-size: 18px; font-weight: bold; color: white;");
     formLayout->addRow(new QLabel(""), capacityDetailsLabel);
 
+    throughputLabel = new QLabel(this);
+    throughputLabel->setStyleSheet("font-size: 18px; font-weight: bold; color: white;");
+    formLayout->addRow(new QLabel("Recording Rate"), throughputLabel);
+
+    cameraRatesLabel = new QLabel(this);
+    cameraRatesLabel->setStyleSheet("font-size: 14px; color: white;");
+    formLayout->addRow(new QLabel(""), cameraRatesLabel);
+
+    archiveSummaryLabel = new QLabel(this);
+    archiveSummaryLabel->setStyleSheet("font-size: 14px; color: white;");
+    formLayout->addRow(new QLabel("Recorded"), archiveSummaryLabel);
+
     durationCombo = new QComboBox(this);
     durationCombo->addItem("1 min", 60);
     durationCombo->addItem("5 mins", 300);
@@ -40,12 +51,83 @@ StorageDetailsWidget::StorageDetailsWidget(ArchiveManager* archiveManager, QWidg
             this, &StorageDetailsWidget::onDurationChanged);
     formLayout->addRow(new QLabel("Recording Duration"), durationCombo);
 
+    // preallocated pool on the medium, oldest segment overwritten
+    loopCombo = new QComboBox(this);
+    loopCombo->addItem("Off", false);
+    loopCombo->addItem("On", true);
+    loopCombo->setStyleSheet("font-size: 18px; font-weight: bold; color: white; background-color: #4d4d4d;");
+    loopCombo->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Preferred);
+    connect(loopCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &StorageDetailsWidget::onLoopChanged);
+    formLayout->addRow(new QLabel("Loop Recording"), loopCombo);
+
     setLayout(formLayout);
     updateStorageInfo();
 
-    refreshTimer = new QTimer(this);
-    connect(refreshTimer, &QTimer::timeout, this, &StorageDetailsWidget::updateStorageInfo);
-    refreshTimer->start(3000);
+    // StorageMonitor (via ArchiveManager) pushes presence/capacity changes;
+    // this widget only ever reads its cached state.
+    connect(archiveManager, &ArchiveManager::storageChanged,
+            this, &StorageDetailsWidget::updateStorageInfo);
+
+    if (archiveManager) {
+        connect(archiveManager, &ArchiveManager::telemetryUpdated,
+                this, &StorageDetailsWidget::updateTelemetry);
+        connect(archiveManager, &ArchiveManager::archiveSummaryChanged,
+                this, &StorageDetailsWidget::updateArchiveSummary);
+        archiveManager->refreshArchiveSummary();
+    }
+    updateTelemetry();
+    updateArchiveSummary();
+}
+
+void StorageDetailsWidget::updateArchiveSummary() {
+    const ArchiveSummary& cams = archiveManager->archiveSummary();
+    if (cams.isEmpty()) {
+        archiveSummaryLabel->setText("No recordings");
+        return;
+    }
+    QStringList lines;
+    for (const ArchivedCamera& c : cams) {
+        lines << QString("%1: %2 days since %3, %4 h, %5 GB")
+                     .arg(c.name)
+                     .arg(c.days)
+                     .arg(c.firstDay)
+                     .arg(c.coveredMs / 3600000.0, 0, 'f', 1)
+                     .arg(c.bytes / double(1024 * 1024 * 1024), 0, 'f', 1);
+    }
+    archiveSummaryLabel->setText(lines.join('\n'));
+}
+
+void StorageDetailsWidget::updateTelemetry() {
+    const RecordingTelemetry& t = archiveManager->telemetry();
+    if (t.cameras.isEmpty()) {
+        throughputLabel->setText("Not recording");
+        cameraRatesLabel->setText("");
+        return;
+    }
+    QString head = QString("%1 Mbit/s").arg(t.totalBytesPerSec * 8 / 1e6, 0, 'f', 1);
+    if (t.hoursUntilFull >= 0) {
+        head += (t.hoursUntilFull >= 48)
+                ? QString(" | ~%1 days until full").arg(t.hoursUntilFull / 24, 0, 'f', 1)
+                : QString(" | ~%1 h until full").arg(t.hoursUntilFull, 0, 'f', 1);
+    }
+    throughputLabel->setText(head);
+
+    QStringList lines;
+    for (const CameraTelemetry& c : t.cameras) {
+        QString line = QString("Cam %1: %2 Mbit/s, %3 fps")
+                           .arg(c.camIndex + 1)
+                           .arg(c.bytesPerSec * 8 / 1e6, 0, 'f', 2)
+                           .arg(c.framesPerSec, 0, 'f', 1);
+        if (c.p95Ms >= 0)
+            line += QString(", write p50/p95/p99 %1/%2/%3 ms").arg(c.p50Ms).arg(c.p95Ms).arg(c.p99Ms);
+        if (c.quality == 1)      line += ", substream (low disk)";
+        else if (c.quality == 2) line += ", keyframes only (low disk)";
+        if (c.restarts > 0)
+            line += QString(", %1 restarts").arg(c.restarts);
+        lines << line;
+    }
+    cameraRatesLabel->setText(lines.join('\n'));
 }
 
 void StorageDetailsWidget::onDurationChanged(int index) {
@@ -56,17 +138,26 @@ void StorageDetailsWidget::onDurationChanged(int index) {
     }
 }
 
+void StorageDetailsWidget::onLoopChanged(int index) {
+    if (archiveManager)
+        archiveManager->setLoopRecording(loopCombo->itemData(index).toBool());
+}
+
 void StorageDetailsWidget::updateStorageInfo() {
-    QString externalPath = archiveManager->findExternalStoragePath();
+    const StorageState st = archiveManager->storageState();
+    loopCombo->blockSignals(true);
+    loopCombo->setCurrentIndex(archiveManager->loopRecording() ? 1 : 0);
+    loopCombo->setEnabled(!st.mountRoot.isEmpty());
+    loopCombo->blockSignals(false);
+    const QString externalPath = st.mountRoot;
     if (externalPath.isEmpty()) {
         storageDeviceStatusLabel->setText("No Storage Device Connected");
         capacityDetailsLabel->setText("");
         storageProgressBar->setValue(0);
     } else {
         storageDeviceStatusLabel->setText(QString("External Device: %1").arg(externalPath));
-        QStorageInfo storage(externalPath);
-        qint64 totalGB = storage.bytesTotal() / (1024 * 1024 * 1024);
-        qint64 availableGB = storage.bytesAvailable() / (1024 * 1024 * 1024);
+        qint64 totalGB = st.bytesTotal / (1024 * 1024 * 1024);
+        qint64 availableGB = st.bytesAvailable / (1024 * 1024 * 1024);
         qint64 usedGB = totalGB - availableGB;
         capacityDetailsLabel->setText(QString("%1 GB Used | %2 GB Available").arg(usedGB).arg(availableGB));
         int usedPercent = (totalGB > 0) ? (usedGB * 100) / totalGB : 0;
@@ -17,6 +17,8 @@ public:
 
 public slots:
     void updateStorageInfo();
+    void updateTelemetry();
+    void updateArchiveSummary();
 
 signals:
     void segmentDurationChanged(int seconds);
@@ -24,14 +26,18 @@ signals:
 
 private slots:
     void onDurationChanged(int index);
+    void onLoopChanged(int index);
 
 private:
     QLabel* storageDeviceStatusLabel;
     QProgressBar* storageProgressBar;
     QLabel* capacityDetailsLabel;
+    QLabel* throughputLabel;
+    QLabel* cameraRatesLabel;
+    QLabel* archiveSummaryLabel;
     QComboBox* durationCombo;
+    QComboBox* loopCombo;
     ArchiveManager* archiveManager;
-    QTimer* refreshTimer;
     QDateTime lastCleanupTime;
 };
 
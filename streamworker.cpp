@@ -1,6 +1,7 @@
 #include "streamworker.h"
 #include <QDebug>
 #include <QThread>
+#include "sched_policy.h"
 
 StreamWorker::StreamWorker(const std::string& url, int index, QObject* parent)
     : QObject(parent),
@@ -28,6 +29,7 @@ StreamWorker::~StreamWorker() {
 }
 
 void StreamWorker::process() {
+    SchedPolicy::applyToCurrentThread(SchedClass::LiveView);
     QString pipelineDesc = QString(
         "rtspsrc location=\"%1\" latency=200 ! "
         "rtph264depay ! h264parse ! vaapih264dec ! videoconvert ! "
@@ -43,6 +45,8 @@ void StreamWorker::process() {
         return;
     }
 
+    SchedPolicy::applyToStreamingThreads(pipeline, SchedClass::LiveView);
+
     appsink = gst_bin_get_by_name(GST_BIN(pipeline), "mysink");
     if (!appsink) {
         qDebug() << "StreamWorker[" << index << "]: Failed to get appsink.";